@@ -37,10 +37,13 @@
 #include <stdio.h>
 #include <string.h>
 #include <errno.h>
+#include <stdint.h>
+#include <pthread.h>
 #include "alloc.h"
 
 static int init;
 static void alloc_init(void);
+static FILE *open_diag(const char *);
 static void clean(void);
 
 /* This counter records the number of times an allocator
@@ -53,26 +56,120 @@ static FILE *diag_out;
 /* File and line at which to induce pretend memory failure */
 static char *fail_fnm;
 static int fail_line;
-
+
+/*
+   Statistics mode. If stats is true, every allocation has a header giving
+   its size and call site, and counts are kept for each call site in a hash
+   table. Table updates are serialized with stats_mtx.
+ */
+
+static int stats;
+static FILE *stats_out;			/* Where to print the table, or NULL */
+static pthread_mutex_t stats_mtx = PTHREAD_MUTEX_INITIALIZER;
+
+/* Header in front of each allocation in statistics mode */
+#define HDR_SZ 16
+struct hdr {
+    size_t sz;				/* Bytes requested */
+    unsigned site;			/* Index in sites */
+};
+
+/* Counts for one call site */
+struct site {
+    char *fnm;				/* Source file, or NULL if unused */
+    int ln;				/* Line in fnm */
+    unsigned long n_alloc;		/* Allocations and reallocations */
+    unsigned long n_free;		/* Calls to free */
+    unsigned long long bytes;		/* Total bytes requested */
+    size_t live;			/* Bytes now allocated */
+    size_t peak;			/* Largest value of live */
+};
+
+/*
+   Call sites. The table has a fixed size. Site 0 collects calls from sites
+   that do not fit.
+ */
+
+#define N_SITE 1024
+static struct site sites[N_SITE];
+static unsigned n_site;
+static size_t live_all, peak_all;	/* Bytes allocated now, and at most,
+					   over all sites */
+
+/*
+   Optional event log, written to log_out at exit. It is a ring that keeps
+   the last LOG_SZ events.
+ */
+
+enum mem_event_kind {
+    MEM_EV_ALLOC = 1, MEM_EV_REALLOC, MEM_EV_FREE
+};
+struct mem_event {
+    uint64_t seq;			/* Event number */
+    uint64_t addr;			/* Address given to caller */
+    uint64_t sz;			/* Bytes requested, 0 for free */
+    uint32_t site;			/* Index in sites */
+    uint32_t kind;			/* enum mem_event_kind */
+};
+#define LOG_SZ (1 << 16)
+static struct mem_event *mem_log;
+static uint64_t n_event;
+static FILE *log_out;
+
+static int fail_at(char *, int);
+static unsigned site_idx(char *, int);
+static void site_add(unsigned, size_t);
+static void log_event(enum mem_event_kind, void *, size_t, unsigned);
+static void *stats_alloc(size_t, int, char *, int);
+static void *stats_realloc(void *, size_t, char *, int);
+static void stats_free(void *, char *, int);
+static int site_cmp(const void *, const void *);
+static void print_site(const struct site *);
+static void stats_print(void);
+static void log_write(void);
+
 /* Initialize this interface, when process starts */
 static void alloc_init(void)
 {
     char *s;
-    int od;
 
     if (init) {
 	return;
     }
     s = getenv("MEM_DEBUG");
     if (s) {
-	if (sscanf(s, "%d", &od) == 1) {
-	    diag_out = fdopen(od, "w");
-	} else {
-	    diag_out = fopen(s, "w");
-	}
+	diag_out = open_diag(s);
 	if ( !diag_out ) {
 	    perror("MEM_DEBUG set but unable to open diagnostic memory file");
 	}
+    }
+    s = getenv("MEM_STATS");
+    if (s) {
+	stats_out = open_diag(s);
+	if ( !stats_out ) {
+	    perror("MEM_STATS set but unable to open memory statistics file");
+	}
+    }
+    s = getenv("MEM_LOG");
+    if (s) {
+	log_out = fopen(s, "wb");
+	mem_log = calloc(LOG_SZ, sizeof(struct mem_event));
+	if ( !log_out || !mem_log ) {
+	    perror("MEM_LOG set but unable to set up memory event log");
+	    if (log_out) {
+		fclose(log_out);
+		log_out = NULL;
+	    }
+	    free(mem_log);
+	    mem_log = NULL;
+	}
+    }
+    stats = stats_out || mem_log;
+    if (stats) {
+	sites[0].fnm = "(other)";
+	n_site = 1;
+    }
+    if (diag_out || stats) {
 	atexit(clean);
     }
     s = getenv("MEM_FAIL");
@@ -81,14 +178,39 @@ static void alloc_init(void)
 	if (sscanf(s, "%[^:]:%d", fail_fnm, &fail_line) != 2) {
 	    fprintf(stderr, "Could not get failure spec from %s\n", s);
 	    free(fail_fnm);
+	    fail_fnm = NULL;
 	}
     }
     init = 1;
 }
-
+
+/*
+   Open a diagnostic stream named by environment variable value s, which is
+   a file descriptor or a file name.
+ */
+
+static FILE *open_diag(const char *s)
+{
+    int od;
+
+    if (sscanf(s, "%d", &od) == 1) {
+	return fdopen(od, "w");
+    } else {
+	return fopen(s, "w");
+    }
+}
+
 /* Clean up when process exits */
 void clean()
 {
+    if (stats_out) {
+	stats_print();
+	fclose(stats_out);
+    }
+    if (log_out) {
+	log_write();
+	fclose(log_out);
+    }
     if (diag_out) {
 	fclose(diag_out);
     }
@@ -96,7 +218,7 @@ void clean()
 	free(fail_fnm);
     }
 }
-
+
 /* See alloc (3) */
 void *Tkx_Malloc(size_t sz, char *fnm, int ln)
 {
@@ -105,16 +227,16 @@ void *Tkx_Malloc(size_t sz, char *fnm, int ln)
     if ( !init ) {
 	alloc_init();
     }
-    m = malloc(sz);
-    if (fail_fnm && (ln == fail_line) && strcmp(fail_fnm, fnm) == 0) {
+    if ( fail_at(fnm, ln) ) {
 	return NULL;
     }
+    m = stats ? stats_alloc(sz, 0, fnm, ln) : malloc(sz);
     if (m && diag_out) {
 	fprintf(diag_out, "%p (%09x) allocated at %s:%d\n", m, ++c, fnm, ln);
     }
     return m;
 }
-
+
 /* See alloc (3) */
 void *Tkx_Calloc(size_t n, size_t sz, char *fnm, int ln)
 {
@@ -123,16 +245,21 @@ void *Tkx_Calloc(size_t n, size_t sz, char *fnm, int ln)
     if ( !init ) {
 	alloc_init();
     }
-    if (fail_fnm && (ln == fail_line) && strcmp(fail_fnm, fnm) == 0) {
+    if ( fail_at(fnm, ln) ) {
 	return NULL;
     }
-    m = calloc(n, sz);
+    if (stats) {
+	m = (sz == 0 || n <= SIZE_MAX / sz)
+	    ? stats_alloc(n * sz, 1, fnm, ln) : NULL;
+    } else {
+	m = calloc(n, sz);
+    }
     if (m && diag_out) {
 	fprintf(diag_out, "%p (%09x) allocated at %s:%d\n", m, ++c, fnm, ln);
     }
     return m;
 }
-
+
 /* See alloc (3) */
 void *Tkx_ReAlloc(void *m, size_t sz, char *fnm, int ln)
 {
@@ -141,10 +268,10 @@ void *Tkx_ReAlloc(void *m, size_t sz, char *fnm, int ln)
     if ( !init ) {
 	alloc_init();
     }
-    if (fail_fnm && (ln == fail_line) && strcmp(fail_fnm, fnm) == 0) {
+    if ( fail_at(fnm, ln) ) {
 	return NULL;
     }
-    m2 = realloc(m, sz);
+    m2 = stats ? stats_realloc(m, sz, fnm, ln) : realloc(m, sz);
     if (m2 && diag_out) {
 	if (m2 != m) {
 	    if (m) {
@@ -160,7 +287,7 @@ void *Tkx_ReAlloc(void *m, size_t sz, char *fnm, int ln)
     }
     return m2;
 }
-
+
 /* See alloc (3) */
 void Tkx_Free(void *m, char *fnm, int ln)
 {
@@ -170,5 +297,400 @@ void Tkx_Free(void *m, char *fnm, int ln)
     if (diag_out) {
 	fprintf(diag_out, "%p (%09x) freed at %s:%d\n", m, ++c, fnm, ln);
     }
-    free(m);
+    if (stats) {
+	stats_free(m, fnm, ln);
+    } else {
+	free(m);
+    }
+}
+
+/* Return true if allocation at file fnm, line ln should pretend to fail */
+static int fail_at(char *fnm, int ln)
+{
+    return fail_fnm && ln == fail_line && strcmp(fail_fnm, fnm) == 0;
+}
+
+/*
+   Return the index in sites for file fnm, line ln, adding it if necessary.
+   Caller must hold stats_mtx. Lines are hashed alone because the same file
+   name can come from different string literals.
+ */
+
+static unsigned site_idx(char *fnm, int ln)
+{
+    unsigned h, k;
+    struct site *st;
+
+    h = ((unsigned)ln * 2654435761U) % (N_SITE - 1);
+    for (k = 0; k < N_SITE - 1; k++) {
+	unsigned i = 1 + (h + k) % (N_SITE - 1);
+
+	st = sites + i;
+	if ( !st->fnm ) {
+	    if ( n_site >= N_SITE * 3 / 4 ) {
+		return 0;
+	    }
+	    st->fnm = fnm;
+	    st->ln = ln;
+	    n_site++;
+	    return i;
+	}
+	if ( st->ln == ln && (st->fnm == fnm || strcmp(st->fnm, fnm) == 0) ) {
+	    return i;
+	}
+    }
+    return 0;
+}
+
+/* Record an allocation of sz bytes at site i. Caller must hold stats_mtx. */
+static void site_add(unsigned i, size_t sz)
+{
+    struct site *st = sites + i;
+
+    st->n_alloc++;
+    st->bytes += sz;
+    st->live += sz;
+    if ( st->live > st->peak ) {
+	st->peak = st->live;
+    }
+    live_all += sz;
+    if ( live_all > peak_all ) {
+	peak_all = live_all;
+    }
+}
+
+/* Add an event to the event log. Caller must hold stats_mtx. */
+static void log_event(enum mem_event_kind kind, void *m, size_t sz,
+	unsigned site)
+{
+    struct mem_event *ev;
+
+    if ( !mem_log ) {
+	return;
+    }
+    ev = mem_log + n_event % LOG_SZ;
+    ev->seq = n_event++;
+    ev->addr = (uintptr_t)m;
+    ev->sz = sz;
+    ev->site = site;
+    ev->kind = kind;
+}
+
+/* Allocate sz bytes with a header, cleared if zero is true, and count it */
+static void *stats_alloc(size_t sz, int zero, char *fnm, int ln)
+{
+    struct hdr *h;
+    void *m;
+
+    if ( sz > SIZE_MAX - HDR_SZ ) {
+	return NULL;
+    }
+    h = zero ? calloc(1, sz + HDR_SZ) : malloc(sz + HDR_SZ);
+    if ( !h ) {
+	return NULL;
+    }
+    m = (char *)h + HDR_SZ;
+    h->sz = sz;
+    pthread_mutex_lock(&stats_mtx);
+    h->site = site_idx(fnm, ln);
+    site_add(h->site, sz);
+    log_event(MEM_EV_ALLOC, m, sz, h->site);
+    pthread_mutex_unlock(&stats_mtx);
+    return m;
+}
+
+/*
+   Reallocate m, which came from stats_alloc or stats_realloc, to sz bytes.
+   The allocation is charged to the site of the reallocation.
+ */
+
+static void *stats_realloc(void *m, size_t sz, char *fnm, int ln)
+{
+    struct hdr *h;
+    size_t sz0;
+    unsigned site0;
+
+    if ( !m ) {
+	return stats_alloc(sz, 0, fnm, ln);
+    }
+    if ( sz > SIZE_MAX - HDR_SZ ) {
+	return NULL;
+    }
+    h = (struct hdr *)((char *)m - HDR_SZ);
+    sz0 = h->sz;
+    site0 = h->site;
+    if ( !(h = realloc(h, sz + HDR_SZ)) ) {
+	return NULL;
+    }
+    m = (char *)h + HDR_SZ;
+    h->sz = sz;
+    pthread_mutex_lock(&stats_mtx);
+    sites[site0].live -= sz0;
+    live_all -= sz0;
+    h->site = site_idx(fnm, ln);
+    site_add(h->site, sz);
+    log_event(MEM_EV_REALLOC, m, sz, h->site);
+    pthread_mutex_unlock(&stats_mtx);
+    return m;
+}
+
+/* Free m, which came from stats_alloc or stats_realloc, and count it */
+static void stats_free(void *m, char *fnm, int ln)
+{
+    struct hdr *h;
+
+    if ( !m ) {
+	return;
+    }
+    h = (struct hdr *)((char *)m - HDR_SZ);
+    pthread_mutex_lock(&stats_mtx);
+    sites[h->site].live -= h->sz;
+    live_all -= h->sz;
+    sites[site_idx(fnm, ln)].n_free++;
+    log_event(MEM_EV_FREE, m, 0, h->site);
+    pthread_mutex_unlock(&stats_mtx);
+    free(h);
+}
+
+/* Order sites by decreasing peak, bytes, and frees, then by name */
+static int site_cmp(const void *a, const void *b)
+{
+    const struct site *s1 = a, *s2 = b;
+
+    if ( s1->peak != s2->peak ) {
+	return (s1->peak > s2->peak) ? -1 : 1;
+    }
+    if ( s1->bytes != s2->bytes ) {
+	return (s1->bytes > s2->bytes) ? -1 : 1;
+    }
+    if ( s1->n_free != s2->n_free ) {
+	return (s1->n_free > s2->n_free) ? -1 : 1;
+    }
+    if ( strcmp(s1->fnm, s2->fnm) != 0 ) {
+	return strcmp(s1->fnm, s2->fnm);
+    }
+    return s1->ln - s2->ln;
+}
+
+/* Print a line for one call site to stats_out */
+static void print_site(const struct site *st)
+{
+    char nm[64];
+
+    if ( st->ln > 0 ) {
+	snprintf(nm, sizeof(nm), "%s:%d", st->fnm, st->ln);
+    } else {
+	snprintf(nm, sizeof(nm), "%s", st->fnm);
+    }
+    fprintf(stats_out, "%-28s %10lu %10lu %14llu %12lu %12lu\n", nm,
+	    st->n_alloc, st->n_free, st->bytes, (unsigned long)st->live,
+	    (unsigned long)st->peak);
+}
+
+/* Print the call site table to stats_out */
+static void stats_print(void)
+{
+    struct site tbl[N_SITE], tot;
+    unsigned i, n;
+
+    pthread_mutex_lock(&stats_mtx);
+    memset(&tot, 0, sizeof(tot));
+    tot.fnm = "total";
+    for (i = n = 0; i < N_SITE; i++) {
+	if ( sites[i].fnm && (sites[i].n_alloc > 0 || sites[i].n_free > 0) ) {
+	    tbl[n++] = sites[i];
+	    tot.n_alloc += sites[i].n_alloc;
+	    tot.n_free += sites[i].n_free;
+	    tot.bytes += sites[i].bytes;
+	}
+    }
+    tot.live = live_all;
+    tot.peak = peak_all;
+    pthread_mutex_unlock(&stats_mtx);
+    qsort(tbl, n, sizeof(struct site), site_cmp);
+    fprintf(stats_out, "%-28s %10s %10s %14s %12s %12s\n", "site",
+	    "allocs", "frees", "bytes", "live", "peak");
+    for (i = 0; i < n; i++) {
+	print_site(tbl + i);
+    }
+    print_site(&tot);
+}
+
+/*
+   Write the event log. See alloc (3) for the format. Values are in host
+   byte order.
+ */
+
+static void log_write(void)
+{
+    uint32_t n_sites, n_kept, u;
+    uint64_t k;
+    unsigned i;
+
+    pthread_mutex_lock(&stats_mtx);
+    n_sites = N_SITE;
+    n_kept = (n_event < LOG_SZ) ? (uint32_t)n_event : LOG_SZ;
+    fwrite("TKXMLOG1", 1, 8, log_out);
+    fwrite(&n_sites, sizeof(n_sites), 1, log_out);
+    fwrite(&n_kept, sizeof(n_kept), 1, log_out);
+    fwrite(&n_event, sizeof(n_event), 1, log_out);
+    for (i = 0; i < N_SITE; i++) {
+	const char *fnm = sites[i].fnm ? sites[i].fnm : "";
+
+	u = (uint32_t)sites[i].ln;
+	fwrite(&u, sizeof(u), 1, log_out);
+	u = (uint32_t)strlen(fnm);
+	fwrite(&u, sizeof(u), 1, log_out);
+	fwrite(fnm, 1, u, log_out);
+    }
+    for (k = n_event - n_kept; k < n_event; k++) {
+	fwrite(mem_log + k % LOG_SZ, sizeof(struct mem_event), 1, log_out);
+    }
+    pthread_mutex_unlock(&stats_mtx);
+    free(mem_log);
+    mem_log = NULL;
+}
+
+/*
+   Arena blocks. Data follow the header. Alignment of data is handled when
+   allocating, so the header size does not matter.
+ */
+
+struct arena_blk {
+    struct arena_blk *next;		/* Next older block */
+    size_t sz;				/* Bytes of data */
+    size_t len;				/* Bytes of data in use, including
+					   alignment padding */
+};
+
+struct Tkx_Arena {
+    struct arena_blk *blk;		/* Newest block, where allocations go */
+    size_t blk_sz;			/* Size for new blocks */
+    size_t used;			/* Bytes given out since reset */
+    size_t high;			/* Largest value of used */
+    unsigned n_blk;			/* Number of blocks */
+};
+
+/* Default alignment for Tkx_ArenaAlloc */
+#define ARENA_ALIGN 16
+
+static struct arena_blk *arena_blk(size_t, char *, int);
+
+/* See alloc (3) */
+struct Tkx_Arena *Tkx_ArenaCreate(size_t sz, char *fnm, int ln)
+{
+    struct Tkx_Arena *a;
+
+    if ( !(a = Tkx_Malloc(sizeof(struct Tkx_Arena), fnm, ln)) ) {
+	return NULL;
+    }
+    a->blk_sz = (sz > 0) ? sz : 4096;
+    a->used = a->high = 0;
+    a->n_blk = 0;
+    if ( !(a->blk = arena_blk(a->blk_sz, fnm, ln)) ) {
+	Tkx_Free(a, fnm, ln);
+	return NULL;
+    }
+    a->n_blk = 1;
+    return a;
+}
+
+/* See alloc (3) */
+void *Tkx_ArenaAlloc(struct Tkx_Arena *a, size_t sz, size_t align, char *fnm,
+	int ln)
+{
+    struct arena_blk *b = a->blk;
+    uintptr_t d, p;			/* Start of data, allocation */
+
+    if ( fail_at(fnm, ln) ) {
+	return NULL;
+    }
+    align = (align > 0) ? align : ARENA_ALIGN;
+    if ( b ) {
+	d = (uintptr_t)(b + 1);
+	p = (d + b->len + align - 1) & ~(uintptr_t)(align - 1);
+    }
+    if ( !b || p + sz > d + b->sz ) {
+	size_t n = (sz + align > a->blk_sz) ? sz + align : a->blk_sz;
+
+	if ( !(b = arena_blk(n, fnm, ln)) ) {
+	    return NULL;
+	}
+	b->next = a->blk;
+	a->blk = b;
+	a->n_blk++;
+	d = (uintptr_t)(b + 1);
+	p = (d + align - 1) & ~(uintptr_t)(align - 1);
+    }
+    b->len = p + sz - d;
+    a->used += sz;
+    a->high = (a->used > a->high) ? a->used : a->high;
+    return (void *)p;
+}
+
+/*
+   See alloc (3). If the arena needed more than one block since the last
+   reset, the blocks are replaced with one block big enough for all of them,
+   so that a repeated pattern of allocations soon needs no more calls to
+   malloc.
+ */
+
+void Tkx_ArenaReset(struct Tkx_Arena *a, char *fnm, int ln)
+{
+    struct arena_blk *b, *n;
+    size_t sz;
+
+    if ( a->n_blk > 1 ) {
+	for (sz = 0, b = a->blk; b; b = n) {
+	    n = b->next;
+	    sz += b->sz;
+	    Tkx_Free(b, fnm, ln);
+	}
+	a->blk_sz = sz;
+
+	/* If this fails, Tkx_ArenaAlloc will try again */
+	a->blk = arena_blk(sz, fnm, ln);
+	a->n_blk = a->blk ? 1 : 0;
+	if (diag_out) {
+	    fprintf(diag_out, "%p (%09x) arena grown at %s:%d to %lu bytes, "
+		    "%lu bytes used\n", (void *)a, ++c, fnm, ln,
+		    (unsigned long)sz, (unsigned long)a->high);
+	}
+    } else if ( a->blk ) {
+	a->blk->len = 0;
+    }
+    a->used = 0;
+}
+
+/* See alloc (3) */
+void Tkx_ArenaDestroy(struct Tkx_Arena *a, char *fnm, int ln)
+{
+    struct arena_blk *b, *n;
+
+    if ( !a ) {
+	return;
+    }
+    if (diag_out) {
+	fprintf(diag_out, "%p (%09x) arena destroyed at %s:%d, %lu bytes "
+		"used\n", (void *)a, ++c, fnm, ln, (unsigned long)a->high);
+    }
+    for (b = a->blk; b; b = n) {
+	n = b->next;
+	Tkx_Free(b, fnm, ln);
+    }
+    Tkx_Free(a, fnm, ln);
+}
+
+/* Allocate an arena block with sz bytes of data */
+static struct arena_blk *arena_blk(size_t sz, char *fnm, int ln)
+{
+    struct arena_blk *b;
+
+    if ( !(b = Tkx_Malloc(sizeof(struct arena_blk) + sz, fnm, ln)) ) {
+	return NULL;
+    }
+    b->next = NULL;
+    b->sz = sz;
+    b->len = 0;
+    return b;
 }
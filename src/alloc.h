@@ -41,10 +41,25 @@
 #define CALLOC(n,s) Tkx_Calloc((n), (s), __FILE__, __LINE__)
 #define REALLOC(x,s) Tkx_ReAlloc((x), (s), __FILE__, __LINE__)
 #define FREE(x) Tkx_Free((x), __FILE__, __LINE__)
+#define ARENA_CREATE(s) Tkx_ArenaCreate((s), __FILE__, __LINE__)
+#define ARENA_ALLOC(a,s,al) Tkx_ArenaAlloc((a), (s), (al), __FILE__, __LINE__)
+#define ARENA_RESET(a) Tkx_ArenaReset((a), __FILE__, __LINE__)
+#define ARENA_DESTROY(a) Tkx_ArenaDestroy((a), __FILE__, __LINE__)
+
+/*
+   Region allocator for scratch memory. Allocations come from large blocks
+   and are released all at once. Clients should not refer to members.
+ */
+
+struct Tkx_Arena;
 
 void *Tkx_Malloc(size_t, char *, int);
 void *Tkx_Calloc(size_t, size_t, char *, int);
 void *Tkx_ReAlloc(void *, size_t, char *, int);
 void Tkx_Free(void *, char *, int);
+struct Tkx_Arena *Tkx_ArenaCreate(size_t, char *, int);
+void *Tkx_ArenaAlloc(struct Tkx_Arena *, size_t, size_t, char *, int);
+void Tkx_ArenaReset(struct Tkx_Arena *, char *, int);
+void Tkx_ArenaDestroy(struct Tkx_Arena *, char *, int);
 
 #endif
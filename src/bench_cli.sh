@@ -0,0 +1,151 @@
+#!/bin/sh
+#
+#	bench_cli.sh --
+#		Time geog subcommands on synthetic inputs, and compare
+#		throughput with a stored baseline.
+#
+# Usage:
+#	bench_cli.sh [-n points] [-j threads] [-b baseline] [-t percent] [-w]
+#
+# Inputs come from geog_gen, with n points (default 1000000) for points,
+# tracks, steps, and heights. Polygons for contain_pts have 10000
+# vertices, since they go on the command line. Polygons for join_regions
+# have 100000 vertices. For each run, prints the name, input bytes, wall
+# time in seconds, input megabytes per second, and peak resident set size
+# in kilobytes.
+#
+# With -w, results are written to the baseline file (default
+# bench_cli.baseline). Otherwise, if the baseline file exists, the script
+# exits with status 1 if the throughput of any run is more than percent
+# (default 10) below the baseline.
+#
+# geog and geog_gen must be in the same directory as this script.
+#
+# Copyright (c) 2014, Gordon D. Carrie. All rights reserved.
+# 
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions
+# are met:
+# 
+#     * Redistributions of source code must retain the above copyright
+#     notice, this list of conditions and the following disclaimer.
+#     * Redistributions in binary form must reproduce the above copyright
+#     notice, this list of conditions and the following disclaimer in the
+#     documentation and/or other materials provided with the distribution.
+# 
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+# "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+# LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+# A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+# HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+# SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+# TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+# PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+# LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+# NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+# SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+#
+# Please send feedback to dev0@trekix.net
+
+dir=`dirname "$0"`
+geog="$dir/geog"
+gen="$dir/geog_gen"
+n=1000000
+thr=1
+baseline=bench_cli.baseline
+pct=10
+write=0
+while [ $# -gt 0 ]
+do
+    case "$1" in
+	-n) n="$2"; shift 2 ;;
+	-j) thr="$2"; shift 2 ;;
+	-b) baseline="$2"; shift 2 ;;
+	-t) pct="$2"; shift 2 ;;
+	-w) write=1; shift ;;
+	*)
+	    echo "Usage: $0 [-n points] [-j threads] [-b baseline] \
+[-t percent] [-w]" 1>&2
+	    exit 1
+	    ;;
+    esac
+done
+if [ ! -x "$geog" -o ! -x "$gen" ]
+then
+    echo "$0: need $geog and $gen. Run make geog geog_gen." 1>&2
+    exit 1
+fi
+
+tmp="${TMPDIR:-/tmp}/bench_cli.$$"
+mkdir "$tmp" || exit 1
+trap 'rm -rf "$tmp"' 0
+trap 'exit 1' 1 2 15
+
+# Make inputs
+"$gen" points $n > "$tmp/points"
+"$gen" heights $n > "$tmp/heights"
+"$gen" steps $n > "$tmp/steps"
+"$gen" track $n > "$tmp/track"
+"$gen" polygon polar 10000 > "$tmp/polar"
+"$gen" polygon antimeridian 10000 > "$tmp/anti"
+{
+    printf 'polar '
+    "$gen" polygon polar 100000 | tr '\n' ' '
+    printf '\nantimeridian '
+    "$gen" polygon antimeridian 100000 | tr '\n' ' '
+    printf '\n'
+} > "$tmp/regions"
+
+# Run subcommand with input file, append name and measurements to results
+bench()
+{
+    name=$1
+    input=$2
+    shift 2
+    if r=`"$gen" run "$tmp/$input" "$@"`
+    then
+	echo "$name $r" | tee -a "$tmp/results"
+    else
+	echo "$0: $name failed" 1>&2
+	exit 1
+    fi
+}
+
+echo "# name bytes seconds MB/s max_rss_KB"
+j="-j $thr"
+bench lonlat_to_xy points \
+	"$geog" lonlat_to_xy $j "LambertConfConic -97.0 38.0 33.0 45.0"
+bench contain_pts_polar points "$geog" contain_pts $j `cat "$tmp/polar"`
+bench contain_pts_antimeridian points \
+	"$geog" contain_pts $j `cat "$tmp/anti"`
+bench join_regions points "$geog" join_regions $j "$tmp/regions"
+bench sum_dist track "$geog" sum_dist
+bench step steps "$geog" step $j
+bench vproj heights "$geog" vproj $j -97.0 38.0 45.0 6371000.0
+
+if [ $write -eq 1 ]
+then
+    cp "$tmp/results" "$baseline"
+    echo "Wrote baseline to $baseline"
+    exit 0
+fi
+if [ ! -f "$baseline" ]
+then
+    echo "No baseline in $baseline. Use -w to make one."
+    exit 0
+fi
+
+# Compare MB/s, field 4, with baseline
+awk -v pct="$pct" '
+    FNR == NR { base[$1] = $4; next }
+    ($1 in base) && $4 < base[$1] * (1.0 - pct / 100.0) {
+	printf "%s: %.2f MB/s, baseline %.2f MB/s, down %.1f%%\n", \
+		$1, $4, base[$1], 100.0 * (1.0 - $4 / base[$1])
+	slow = 1
+    }
+    END {
+	if ( slow ) {
+	    exit 1
+	}
+	printf "Throughput within %s%% of baseline\n", pct
+    }' "$baseline" "$tmp/results"
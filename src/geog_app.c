@@ -33,14 +33,24 @@
    .	$Revision: 1.56 $ $Date: 2014/10/08 09:14:03 $
  */
 
+#include "unix_defs.h"
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <ctype.h>
 #include <float.h>
 #include <math.h>
+#include <stdarg.h>
+#include <time.h>
+#include <pthread.h>
 #include "alloc.h"
 #include "geog_lib.h"
 #include "geog_proj.h"
+#include "geog_io.h"
+#include "geog_par.h"
+#include "geog_index.h"
+#include "geog_raster.h"
+#include "geog_serve.h"
 
 /* Application name and subcommand name */
 char *argv0, *argv1;
@@ -49,7 +59,7 @@ char *argv0, *argv1;
 #define LEN 1024
 
 /* Number of subcommands */
-#define NCMD 15
+#define NCMD 25
 
 /* Callback functions.  There should be one for each subcommand. */
 typedef int (callback)(int , char **);
@@ -60,6 +70,8 @@ callback lonr_cb;
 callback latn_cb;
 callback dist_cb;
 callback sum_dist_cb;
+callback densify_cb;
+callback track_segments_cb;
 callback az_cb;
 callback step_cb;
 callback beam_ht_cb;
@@ -68,27 +80,238 @@ callback contain_pts_cb;
 callback vproj_cb;
 callback lonlat_to_xy_cb;
 callback xy_to_lonlat_cb;
+callback grid_lonlat_cb;
+callback join_regions_cb;
+callback nearest_cb;
+callback warp_cb;
+callback dist_matrix_cb;
+callback within_cb;
+callback serve_cb;
+callback batch_cb;
+
+/* Arrays of subcommand names and associated callbacks */
+static char *argv1v[NCMD] = {"-v", "dms", "rearth", "lonr", "latn", "dist",
+    "sum_dist", "az", "step", "beam_ht", "contain_pt", "contain_pts",
+    "vproj", "lonlat_to_xy", "xy_to_lonlat", "join_regions",
+    "nearest", "grid_lonlat", "warp", "densify", "dist_matrix",
+    "within", "track_segments", "serve", "batch"};
+static callback *cb1v[NCMD] = {version_cb, dms_cb, rearth_cb, lonr_cb,
+    latn_cb, dist_cb, sum_dist_cb, az_cb, step_cb, beam_ht_cb, contain_pt_cb,
+    contain_pts_cb, vproj_cb, lonlat_to_xy_cb, xy_to_lonlat_cb,
+    join_regions_cb, nearest_cb, grid_lonlat_cb, warp_cb, densify_cb,
+    dist_matrix_cb, within_cb, track_segments_cb, serve_cb, batch_cb};
+
+/*
+   Input and output for a request to geog serve or geog batch. If req_out
+   is not NULL, subcommands write results to it instead of standard output,
+   and streaming subcommands without -i read req_in instead of standard
+   input.
+ */
+
+static struct GeogIn *req_in;
+static struct GeogOut *req_out;
+static int out_printf(const char *, ...);
+static int out_open(struct GeogOut *);
+static int out_flush(struct GeogOut *);
+static void out_close(struct GeogOut *);
+static GeogServeFn run_req;
+
+/*
+   Projections and polygons prepared for earlier requests, found by their
+   specifier strings. The caches are only used while serving.
+ */
+
+#define N_CACHE 32
+struct proj_cache {
+    char *spec;				/* Projection specifier, or NULL */
+    struct GeogProj proj;
+    unsigned long used;			/* Value of cache_clock at last use */
+};
+struct poly_cache {
+    char *spec;				/* Vertices from command line, or NULL */
+    struct GeogPreparedPolygon poly;
+    unsigned long used;			/* Value of cache_clock at last use */
+};
+static int serving;			/* If true, geog serve is running */
+static struct proj_cache proj_cache[N_CACHE];
+static struct poly_cache poly_cache[N_CACHE];
+static unsigned long cache_clock;
+static int get_proj(char *, struct GeogProj *);
+static char *join_args(char **, char **);
+static struct poly_cache *find_poly(const char *);
+static void keep_poly(char *, struct GeogPreparedPolygon *);
+
+/* Options for subcommands that read standard input */
+struct stream_opts {
+    enum GeogIOFmt fmt;		/* Format of input and output */
+    char *in_fnm;		/* Input file, or NULL for standard input */
+    int n_thr;			/* Number of threads */
+};
+#define STREAM_USAGE "[-b|--binary=f64|f32] [-i file] [-j threads]"
+static int get_stream_opts(int *, char **, struct stream_opts *);
+
+/* Apply a transformation to input from standard input or a file */
+static int run_stream(GeogParFn *, void *, struct stream_opts *, size_t);
+
+/*
+   Run statistics, gathered if the --stats option or GEOG_STATS environment
+   variable is given. Transformations that work in batches time the parse,
+   compute, and write phases of each batch, and add their counts with
+   stats_add. Phase times are summed over threads.
+ */
+
+struct run_stats {
+    size_t n_rec;			/* Records processed */
+    size_t n_rej;			/* Records that could not be
+					   transformed */
+    double t_parse, t_compute, t_write;	/* Seconds in each phase */
+};
+static int stats;			/* If true, gather statistics */
+static int stats_phases;		/* If true, run_stats has phase times */
+static struct run_stats run_stats;
+static size_t stats_in, stats_out;	/* Bytes read and written */
+static pthread_mutex_t stats_mtx = PTHREAD_MUTEX_INITIALIZER;
+static double stats_clock(void);
+static void stats_lap(double *, double *);
+static void stats_add(const struct run_stats *);
+static void stats_bytes(size_t, size_t);
+static void stats_print(double);
+
+/* Transformations for streaming subcommands, and their client data */
+struct proj_arg {
+    struct GeogProj proj;
+    enum GeogIOFmt fmt;
+};
+struct densify_arg {
+    double max_step;			/* Longest segment, radians */
+    enum GeogIOFmt fmt;
+};
+struct track_arg {
+    int time;				/* If true, input has times */
+    enum GeogIOFmt fmt;
+};
+struct dist_matrix_arg {
+    struct GeogTrigPt *cols;		/* Points for matrix columns */
+    size_t n_cols;			/* Number of columns */
+    int az;				/* If true, write azimuths */
+    enum GeogIOFmt fmt;
+};
+struct warp_arg {
+    struct GeogRaster src;		/* Input raster */
+    struct GeogRaster dst;		/* Output raster, without data */
+    enum GeogResample rs;		/* Resampling method */
+    double tol;				/* If positive, interpolation tolerance
+					   in meters */
+    double *errs;			/* Largest interpolation error for
+					   each block */
+};
+struct grid_arg {
+    struct GeogProj proj;		/* Projection */
+    enum GeogIOFmt fmt;			/* Output format */
+    double x0, dx;			/* Map x of first column, increment */
+    size_t nx;				/* Number of columns */
+    double y0, dy;			/* Map y of first row, increment */
+    double tol;				/* If positive, interpolation tolerance
+					   in meters */
+    size_t blk;				/* Number of rows per block */
+    double *errs;			/* Largest interpolation error for
+					   each block */
+};
+struct vproj_arg {
+    double rlon, rlat;		/* Reference point */
+    double azg;			/* Azimuth of projection plane */
+    double a0;			/* Earth radius */
+    enum GeogIOFmt fmt;
+};
+struct contain_pts_arg {
+    struct GeogPreparedPolygon poly;	/* Polygon */
+    enum GeogIOFmt fmt;
+};
+struct join_arg {
+    char **ids;				/* Region ids */
+    struct GeogPreparedPolygon *polys;	/* Prepared region polygons */
+    size_t n_rgn;			/* Number of regions */
+    struct GeogBox *boxes;		/* Bounding boxes, up to 2 per region */
+    size_t *box_ids;			/* Region index for each box */
+    size_t n_box;			/* Number of boxes */
+    struct GeogRTree rt;		/* Index of region bounding boxes */
+    enum GeogIOFmt fmt;
+};
+struct join_query {
+    const struct join_arg *jn_arg;
+    struct GeogPt pt;			/* Point to look up */
+    size_t rgn;				/* Region containing pt, so far */
+};
+struct nearest_arg {
+    struct GeogKnnIndex kx;		/* Index of sites */
+    char *ids;				/* Site ids, nul separated */
+    size_t *id_offs;			/* Offset in ids of each site id */
+    size_t k;				/* Number of neighbors to find */
+    enum GeogIOFmt fmt;
+};
+struct within_arg {
+    struct GeogRadiusIndex rx;		/* Index of sites */
+    char *ids;				/* Site ids, nul separated */
+    size_t *id_offs;			/* Offset in ids of each site id */
+    double r;				/* Radius, radians */
+    enum GeogIOFmt fmt;
+};
+struct within_hit {
+    double dist;			/* Distance to site, radians */
+    size_t id;				/* Index of site */
+};
+struct within_hits {
+    struct within_hit *hit;		/* Sites found */
+    size_t n, sz;			/* Number of sites, allocation at hit */
+    struct Tkx_Arena *scratch;		/* Arena that provides hit */
+    int err;				/* If true, allocation failed */
+};
+static int read_regions(const char *, struct join_arg *);
+static void free_regions(struct join_arg *);
+static int read_sites(const char *, char **, size_t **, struct GeogPt **,
+	size_t *);
+static int read_pts(const char *, struct GeogPt **, size_t *);
+static GeogRTreeFn join_regions_test;
+static GeogParFn sum_dist_fn;
+static GeogParFn densify_fn;
+static GeogParFn track_segments_fn;
+static GeogParFn step_fn;
+static GeogParFn contain_pts_fn;
+static GeogParFn vproj_fn;
+static GeogParFn lonlat_to_xy_fn;
+static GeogParFn xy_to_lonlat_fn;
+static GeogParRangeFn grid_lonlat_fn;
+static GeogParRangeFn warp_fn;
+static GeogParFn join_regions_fn;
+static GeogParFn nearest_fn;
+static GeogParFn dist_matrix_fn;
+static GeogRadiusFn within_add;
+static int within_cmp(const void *, const void *);
+static GeogParFn within_fn;
 
 int main(int argc, char *argv[])
 {
     int i;		/* Index for subcommand in argv[1] */
     int rslt;		/* Return code */
-
-    /* Arrays of subcommand names and associated callbacks */
-    char *argv1v[NCMD] = {"-v", "dms", "rearth", "lonr", "latn", "dist",
-	"sum_dist", "az", "step", "beam_ht", "contain_pt", "contain_pts",
-	"vproj", "lonlat_to_xy", "xy_to_lonlat"};
-    callback *cb1v[NCMD] = {version_cb, dms_cb, rearth_cb, lonr_cb, latn_cb,
-	dist_cb, sum_dist_cb, az_cb, step_cb, beam_ht_cb, contain_pt_cb,
-	contain_pts_cb, vproj_cb, lonlat_to_xy_cb, xy_to_lonlat_cb};
+    char *s;		/* Value of GEOG_STATS */
+    double t0;		/* Start time, if gathering statistics */
 
     argv0 = argv[0];
+    s = getenv("GEOG_STATS");
+    stats = s && *s && strcmp(s, "0") != 0;
+    if ( argc > 1 && strcmp(argv[1], "--stats") == 0 ) {
+	stats = 1;
+	argv[1] = argv0;
+	argv++;
+	argc--;
+    }
     if (argc < 2) {
-	fprintf(stderr, "Usage: %s subcommand [subcommand_options ...]\n",
-		argv0);
+	fprintf(stderr, "Usage: %s [--stats] subcommand "
+		"[subcommand_options ...]\n", argv0);
 	exit(1);
     }
     argv1 = argv[1];
+    t0 = stats_clock();
 
     /* Search argv1v for argv1.  When match is found, evaluate the associated
      * callback from cb1v. */
@@ -112,12 +335,15 @@ int main(int argc, char *argv[])
 	fprintf(stderr, "\n");
 	rslt = 0;
     }
+    if ( stats ) {
+	stats_print(stats_clock() - t0);
+    }
     return !rslt;
 }
 
 int version_cb(int argc, char *argv[])
 {
-    printf("%s %s\n", argv0, GEOG_VERSION);
+    out_printf("%s %s\n", argv0, GEOG_VERSION);
     return 1;
 }
 
@@ -138,14 +364,14 @@ int dms_cb(int argc, char *argv[])
 	return 0;
     }
     GeogDMS(d, &deg, &min, &sec, "%f");
-    printf("%.0lf %.0lf %lf\n", deg, min, sec);
+    out_printf("%.0lf %.0lf %lf\n", deg, min, sec);
     return 1;
 }
 
 int rearth_cb(int argc, char *argv[])
 {
     if (argc == 2) {
-	printf("%f\n", GeogREarth(NULL));
+	out_printf("%f\n", GeogREarth(NULL));
     } else {
 	fprintf(stderr, "Usage: %s %s\n", argv0, argv1);
 	return 0;
@@ -173,7 +399,7 @@ int lonr_cb(int argc, char *argv[])
 		"%s.\n", r_s);
 	return 0;
     }
-    printf("%lf\n", GeogLonR(l * RAD_DEG, r * RAD_DEG) * DEG_RAD);
+    out_printf("%lf\n", GeogLonR(l * RAD_DEG, r * RAD_DEG) * DEG_RAD);
     return 1;
 }
 
@@ -191,7 +417,7 @@ int latn_cb(int argc, char *argv[])
 	fprintf(stderr, "Expected float value for latitude, got %s\n", l_s);
 	return 0;
     }
-    printf("%f\n", GeogLatN(l * RAD_DEG) * DEG_RAD);
+    out_printf("%f\n", GeogLatN(l * RAD_DEG) * DEG_RAD);
     return 1;
 }
 
@@ -226,7 +452,7 @@ int dist_cb(int argc, char *argv[])
 	fprintf(stderr, "Expected float value for lat2, got %s\n", lat2_s);
 	return 0;
     }
-    printf("%f\n", GeogDist(lon1 * RAD_DEG, lat1 * RAD_DEG,
+    out_printf("%f\n", GeogDist(lon1 * RAD_DEG, lat1 * RAD_DEG,
 		lon2 * RAD_DEG, lat2 * RAD_DEG) * DEG_RAD);
     return 1;
 }
@@ -238,24 +464,231 @@ int dist_cb(int argc, char *argv[])
 
 int sum_dist_cb(int argc, char *argv[])
 {
-    double lon0, lon, lat0, lat;	/* Longitude, latitude from input */
-    double tot;				/* Total distance */
+    struct stream_opts opts;
 
+    if ( !get_stream_opts(&argc, argv, &opts) ) {
+	return 0;
+    }
     if (argc != 2) {
-	fprintf(stderr, "Usage: %s %s\n", argv0, argv1);
+	fprintf(stderr, "Usage: %s %s " STREAM_USAGE "\n", argv0, argv1);
 	return 0;
     }
-    if (scanf(" %lf %lf", &lon0, &lat0) != 2) {
+
+    /* Track length depends on every point, so this runs on one thread */
+    opts.n_thr = 1;
+    return run_stream(sum_dist_fn, &opts.fmt, &opts, 2);
+}
+
+static int sum_dist_fn(struct GeogIn *in, struct GeogOut *out, void *arg)
+{
+    enum GeogIOFmt fmt = *(enum GeogIOFmt *)arg;
+    double lon[LEN + 1], lat[LEN + 1];	/* Longitude, latitude from input.
+					   Element 0 is the last point of
+					   the previous batch */
+    double d[LEN];			/* Segment lengths */
+    double tot;				/* Total distance */
+    double rec[2];			/* Input record */
+    size_t n, i;			/* Number of segments in batch, index */
+
+    if ( !GeogInRec(in, fmt, rec, 2) ) {
 	fprintf(stderr, "No input.\n");
 	return 0;
     }
-    for (tot = 0.0; scanf(" %lf %lf", &lon, &lat) == 2 ; ) {
-	tot += GeogDist(lon0 * RAD_DEG, lat0 * RAD_DEG,
-		lon * RAD_DEG, lat * RAD_DEG);
-	lat0 = lat;
-	lon0 = lon;
+    lon[0] = rec[0] * RAD_DEG;
+    lat[0] = rec[1] * RAD_DEG;
+    tot = 0.0;
+    do {
+	for (n = 0; n < LEN && GeogInRec(in, fmt, rec, 2); n++) {
+	    lon[n + 1] = rec[0] * RAD_DEG;
+	    lat[n + 1] = rec[1] * RAD_DEG;
+	}
+	GeogDistN(lon, lat, lon + 1, lat + 1, d, n);
+	for (i = 0; i < n; i++) {
+	    tot += d[i];
+	}
+	lon[0] = lon[n];
+	lat[0] = lat[n];
+    } while ( n == LEN );
+    tot *= DEG_RAD;
+    if ( fmt == GeogIOText ) {
+	GeogOutFix(out, tot, 6);
+	GeogOutMem(out, "\n", 1);
+    } else {
+	GeogOutRec(out, fmt, &tot, 1);
+    }
+    return 1;
+}
+
+/*
+   Read a track given as longitude latitude pairs from standard input. Write
+   it to standard output with points inserted so that no segment is longer
+   than the distance given on the command line.
+ */
+
+int densify_cb(int argc, char *argv[])
+{
+    struct stream_opts opts;
+    struct densify_arg dn_arg;
+
+    if ( !get_stream_opts(&argc, argv, &opts) ) {
+	return 0;
+    }
+    if ( argc != 3 ) {
+	fprintf(stderr, "Usage: %s %s " STREAM_USAGE " max_step\n",
+		argv0, argv1);
+	return 0;
+    }
+    if ( sscanf(argv[2], "%lf", &dn_arg.max_step) != 1
+	    || !(dn_arg.max_step > 0.0) ) {
+	fprintf(stderr, "%s %s: expected positive float value for max_step, "
+		"got %s\n", argv0, argv1, argv[2]);
+	return 0;
+    }
+    dn_arg.max_step *= RAD_DEG;
+    dn_arg.fmt = opts.fmt;
+
+    /* Segments span batches, so this runs on one thread */
+    opts.n_thr = 1;
+    return run_stream(densify_fn, &dn_arg, &opts, 2);
+}
+
+static int densify_fn(struct GeogIn *in, struct GeogOut *out, void *arg)
+{
+    struct densify_arg *dn_arg = arg;
+    enum GeogIOFmt fmt = dn_arg->fmt;
+    struct GeogPt pts[LEN + 1];		/* Points from input. Element 0 is the
+					   last point of the previous batch */
+    struct GeogPt *dpts = NULL;		/* Densified track */
+    size_t n_dpts = 0;			/* Allocation at dpts */
+    size_t n, n_d, i;			/* Number of new points, number of
+					   densified points, index */
+    double rec[2];
+
+    if ( !GeogInRec(in, fmt, rec, 2) ) {
+	return 1;
+    }
+    pts[0].lon = rec[0] * RAD_DEG;
+    pts[0].lat = rec[1] * RAD_DEG;
+    do {
+	for (n = 0; n < LEN && GeogInRec(in, fmt, rec, 2); n++) {
+	    pts[n + 1].lon = rec[0] * RAD_DEG;
+	    pts[n + 1].lat = rec[1] * RAD_DEG;
+	}
+	n_d = GeogDensify(pts, n + 1, dn_arg->max_step, dpts, n_dpts);
+	if ( n_d > n_dpts ) {
+	    struct GeogPt *t;
+
+	    if ( !(t = REALLOC(dpts, n_d * sizeof(struct GeogPt))) ) {
+		fprintf(stderr, "Could not allocate densified track.\n");
+		FREE(dpts);
+		return 0;
+	    }
+	    dpts = t;
+	    n_dpts = n_d;
+	    GeogDensify(pts, n + 1, dn_arg->max_step, dpts, n_dpts);
+	}
+
+	/* Last point starts the next batch, unless input is done */
+	if ( n == LEN ) {
+	    n_d--;
+	}
+	for (i = 0; i < n_d; i++) {
+	    rec[0] = dpts[i].lon * DEG_RAD;
+	    rec[1] = dpts[i].lat * DEG_RAD;
+	    if ( fmt == GeogIOText ) {
+		GeogOutFix(out, rec[0], 6);
+		GeogOutMem(out, " ", 1);
+		GeogOutFix(out, rec[1], 6);
+		GeogOutMem(out, "\n", 1);
+	    } else {
+		GeogOutRec(out, fmt, rec, 2);
+	    }
+	}
+	pts[0] = pts[n];
+    } while ( n == LEN );
+    FREE(dpts);
+    return 1;
+}
+
+/*
+   Read a track given as longitude latitude pairs, or longitude latitude
+   time triples with -t, from standard input. For each segment, write its
+   length and initial azimuth in degrees, and with -t its speed in degrees
+   per time unit.
+ */
+
+int track_segments_cb(int argc, char *argv[])
+{
+    struct stream_opts opts;
+    struct track_arg tr_arg;
+
+    if ( !get_stream_opts(&argc, argv, &opts) ) {
+	return 0;
+    }
+    tr_arg.time = 0;
+    if ( argc == 3 && strcmp(argv[2], "-t") == 0 ) {
+	tr_arg.time = 1;
+    } else if ( argc != 2 ) {
+	fprintf(stderr, "Usage: %s %s " STREAM_USAGE " [-t]\n", argv0, argv1);
+	return 0;
+    }
+    tr_arg.fmt = opts.fmt;
+
+    /* Segments span batches, so this runs on one thread */
+    opts.n_thr = 1;
+    return run_stream(track_segments_fn, &tr_arg, &opts,
+	    tr_arg.time ? 3 : 2);
+}
+
+static int track_segments_fn(struct GeogIn *in, struct GeogOut *out,
+	void *arg)
+{
+    struct track_arg *tr_arg = arg;
+    enum GeogIOFmt fmt = tr_arg->fmt;
+    size_t n_val = tr_arg->time ? 3 : 2;	/* Values per input record */
+    struct GeogPt pts[LEN + 1];		/* Points from input. Element 0 is the
+					   last point of the previous batch */
+    double t[LEN + 1];			/* Times of pts */
+    double d[LEN], az[LEN], spd[LEN];	/* Segment lengths, azimuths,
+					   speeds */
+    double rec[3];
+    size_t n, i;			/* Number of segments in batch, index */
+
+    if ( !GeogInRec(in, fmt, rec, n_val) ) {
+	return 1;
     }
-    printf("%lf\n", tot * DEG_RAD);
+    pts[0].lon = rec[0] * RAD_DEG;
+    pts[0].lat = rec[1] * RAD_DEG;
+    t[0] = rec[2];
+    do {
+	for (n = 0; n < LEN && GeogInRec(in, fmt, rec, n_val); n++) {
+	    pts[n + 1].lon = rec[0] * RAD_DEG;
+	    pts[n + 1].lat = rec[1] * RAD_DEG;
+	    t[n + 1] = rec[2];
+	}
+	GeogTrackSegments(pts, tr_arg->time ? t : NULL, n + 1, d, az, spd);
+	for (i = 0; i < n; i++) {
+	    rec[0] = d[i] * DEG_RAD;
+	    rec[1] = az[i] * DEG_RAD;
+	    rec[2] = spd[i] * DEG_RAD;
+	    if ( fmt == GeogIOText ) {
+		GeogOutFix(out, rec[0], 6);
+		GeogOutMem(out, " ", 1);
+		GeogOutFix(out, rec[1], 6);
+		if ( tr_arg->time && isnan(rec[2]) ) {
+		    GeogOutMem(out, " ****", 5);
+		} else if ( tr_arg->time ) {
+		    GeogOutMem(out, " ", 1);
+		    GeogOutFix(out, rec[2], 6);
+		}
+		GeogOutMem(out, "\n", 1);
+	    } else {
+		GeogOutRec(out, fmt, rec, n_val);
+	    }
+	}
+	pts[0] = pts[n];
+	t[0] = t[n];
+    } while ( n == LEN );
     return 1;
 }
 
@@ -290,7 +723,7 @@ int az_cb(int argc, char *argv[])
 	fprintf(stderr, "Expected float value for lat2, got %s\n", lat2_s);
 	return 0;
     }
-    printf("%f\n", GeogAz(lon1 * RAD_DEG, lat1 * RAD_DEG,
+    out_printf("%f\n", GeogAz(lon1 * RAD_DEG, lat1 * RAD_DEG,
 		lon2 * RAD_DEG,  lat2 * RAD_DEG) * DEG_RAD);
     return 1;
 }
@@ -298,13 +731,13 @@ int az_cb(int argc, char *argv[])
 int step_cb(int argc, char *argv[])
 {
     double lon1, lat1, dirn, dist, lon2, lat2;
+    struct stream_opts opts;
 
+    if ( !get_stream_opts(&argc, argv, &opts) ) {
+	return 0;
+    }
     if (argc == 2) {
-	while (scanf("%lf %lf %lf %lf", &lon1, &lat1, &dirn, &dist) == 4) {
-	    GeogStep(lon1 * RAD_DEG, lat1 * RAD_DEG,
-		    dirn * RAD_DEG, dist * RAD_DEG, &lon2, &lat2);
-	    printf("%f %f\n", lon2 * DEG_RAD, lat2 * DEG_RAD);
-	}
+	return run_stream(step_fn, &opts.fmt, &opts, 4);
     } else if (argc == 6) {
 	char *lon1_s, *lat1_s, *dirn_s, *dist_s;
 
@@ -332,15 +765,54 @@ int step_cb(int argc, char *argv[])
 	}
 	GeogStep(lon1 * RAD_DEG, lat1 * RAD_DEG,
 		dirn * RAD_DEG, dist * RAD_DEG, &lon2, &lat2);
-	printf("%f %f\n", lon2 * DEG_RAD, lat2 * DEG_RAD);
+	out_printf("%f %f\n", lon2 * DEG_RAD, lat2 * DEG_RAD);
     } else {
-	fprintf(stderr, "Usage: %s %s [lon lat direction distance]\n",
-		argv0, argv1);
+	fprintf(stderr, "Usage: %s %s " STREAM_USAGE
+		" [lon lat direction distance]\n", argv0, argv1);
 	return 0;
     }
     return 1;
 }
 
+static int step_fn(struct GeogIn *in, struct GeogOut *out, void *arg)
+{
+    enum GeogIOFmt fmt = *(enum GeogIOFmt *)arg;
+    double lon1v[LEN], lat1v[LEN], dirnv[LEN], distv[LEN];
+    double rec[4];
+    size_t n, i;
+    struct run_stats st = {0};
+    double t;
+
+    do {
+	t = stats_clock();
+	for (n = 0; n < LEN && GeogInRec(in, fmt, rec, 4); n++) {
+	    lon1v[n] = rec[0] * RAD_DEG;
+	    lat1v[n] = rec[1] * RAD_DEG;
+	    dirnv[n] = rec[2] * RAD_DEG;
+	    distv[n] = rec[3] * RAD_DEG;
+	}
+	stats_lap(&t, &st.t_parse);
+	GeogStepN(lon1v, lat1v, dirnv, distv, lon1v, lat1v, n);
+	stats_lap(&t, &st.t_compute);
+	for (i = 0; i < n; i++) {
+	    rec[0] = lon1v[i] * DEG_RAD;
+	    rec[1] = lat1v[i] * DEG_RAD;
+	    if ( fmt == GeogIOText ) {
+		GeogOutFix(out, rec[0], 6);
+		GeogOutMem(out, " ", 1);
+		GeogOutFix(out, rec[1], 6);
+		GeogOutMem(out, "\n", 1);
+	    } else {
+		GeogOutRec(out, fmt, rec, 2);
+	    }
+	}
+	stats_lap(&t, &st.t_write);
+	st.n_rec += n;
+    } while ( n == LEN );
+    stats_add(&st);
+    return 1;
+}
+
 int beam_ht_cb(int argc, char *argv[])
 {
     char *dist_s, *tilt_s, *a0_s;
@@ -367,7 +839,7 @@ int beam_ht_cb(int argc, char *argv[])
 		a0_s);
 	return 0;
     }
-    printf("%lf\n", GeogBeamHt(d, tilt * RAD_DEG, a0));
+    out_printf("%lf\n", GeogBeamHt(d, tilt * RAD_DEG, a0));
     return 1;
 }
 
@@ -405,34 +877,53 @@ int contain_pt_cb(int argc, char *argv[])
 	if ( sscanf(*lon_sp, "%lf", &pts_p->lon) != 1 ) {
 	    fprintf(stderr, "Expected float value for longitude, got %s\n",
 		    *lon_sp);
+	    FREE(pts);
 	    return 0;
 	}
 	pts_p->lon *= RAD_DEG;
 	if ( sscanf(*lat_sp, "%lf", &pts_p->lat) != 1 ) {
 	    fprintf(stderr, "Expected float value for latitude, got %s\n",
 		    *lat_sp);
+	    FREE(pts);
 	    return 0;
 	}
 	pts_p->lat *= RAD_DEG;
     }
-    printf("%s\n", GeogContainPt(pt, pts, n_pts) ? "in" : "out");
+    out_printf("%s\n", GeogContainPt(pt, pts, n_pts) ? "in" : "out");
+    FREE(pts);
     return 1;
 }
 
 int contain_pts_cb(int argc, char *argv[])
 {
     char **lon_sp, **lat_sp;
-    struct GeogPt pt, *pts, *pts_p;
+    struct GeogPt *pts, *pts_p;
     size_t n_pts;
-    char buf[LEN];
+    struct stream_opts opts;
+    struct contain_pts_arg cp_arg;
+    char *spec = NULL;			/* Vertices, if serving */
+    struct poly_cache *pc;		/* Polygon from earlier request */
+    int rslt;
 
+    if ( !get_stream_opts(&argc, argv, &opts) ) {
+	return 0;
+    }
     if ( argc < 8 || argc % 2 != 0 ) {
-	fprintf(stderr, "Usage: %s %s lon1 lat1 lon2 lat2 ...\n", argv0, argv1);
+	fprintf(stderr, "Usage: %s %s " STREAM_USAGE
+		" lon1 lat1 lon2 lat2 ...\n", argv0, argv1);
 	return 0;
     }
+    if ( serving && (spec = join_args(argv + 2, argv + argc))
+	    && (pc = find_poly(spec)) ) {
+	FREE(spec);
+	cp_arg.poly = pc->poly;
+	cp_arg.fmt = opts.fmt;
+	return run_stream(contain_pts_fn, &cp_arg, &opts, 2);
+    }
     n_pts = (argc - 2) / 2;
     if ( !(pts = CALLOC(n_pts, sizeof(struct GeogPt))) ) {
 	fprintf(stderr, "Could not allocate memory for polygon.\n");
+	FREE(spec);
 	return 0;
     }
     for (lon_sp = argv + 2, lat_sp = argv + 3, pts_p = pts;
@@ -440,22 +931,64 @@ int contain_pts_cb(int argc, char *argv[])
 	if ( sscanf(*lon_sp, "%lf", &pts_p->lon) != 1 ) {
 	    fprintf(stderr, "Expected float value for longitude, got %s\n",
 		    *lon_sp);
+	    FREE(pts);
+	    FREE(spec);
 	    return 0;
 	}
 	pts_p->lon *= RAD_DEG;
 	if ( sscanf(*lat_sp, "%lf", &pts_p->lat) != 1 ) {
 	    fprintf(stderr, "Expected float value for latitude, got %s\n",
 		    *lat_sp);
+	    FREE(pts);
+	    FREE(spec);
 	    return 0;
 	}
 	pts_p->lat *= RAD_DEG;
     }
-    while ( fgets(buf, LEN, stdin) ) {
-	if ( sscanf(buf, " %lf %lf ", &pt.lon , &pt.lat) == 2 ) {
+    if ( !GeogPreparedPolygonInit(&cp_arg.poly, pts, n_pts) ) {
+	fprintf(stderr, "Could not allocate memory for polygon.\n");
+	FREE(pts);
+	FREE(spec);
+	return 0;
+    }
+    FREE(pts);
+    cp_arg.fmt = opts.fmt;
+    rslt = run_stream(contain_pts_fn, &cp_arg, &opts, 2);
+    if ( spec ) {
+	keep_poly(spec, &cp_arg.poly);
+    } else {
+	GeogPreparedPolygonFree(&cp_arg.poly);
+    }
+    return rslt;
+}
+
+static int contain_pts_fn(struct GeogIn *in, struct GeogOut *out, void *arg)
+{
+    struct contain_pts_arg *cp_arg = arg;
+    enum GeogIOFmt fmt = cp_arg->fmt;
+    struct GeogPt pt;
+    const char *ln, *l;			/* Input line, point into ln */
+    size_t n;				/* Length of ln */
+    double rec[2];			/* Binary input record */
+
+    if ( fmt != GeogIOText ) {
+	while ( GeogInRec(in, fmt, rec, 2) ) {
+	    pt.lon = rec[0] * RAD_DEG;
+	    pt.lat = rec[1] * RAD_DEG;
+	    if ( GeogContainPtPrepared(pt, &cp_arg->poly) ) {
+		GeogOutRec(out, fmt, rec, 2);
+	    }
+	}
+	return 1;
+    }
+    while ( GeogInLine(in, &ln, &n) ) {
+	l = ln;
+	if ( GeogIOParseDbl(&l, ln + n, &pt.lon)
+		&& GeogIOParseDbl(&l, ln + n, &pt.lat) ) {
 	    pt.lon *= RAD_DEG;
 	    pt.lat *= RAD_DEG;
-	    if ( GeogContainPt(pt, pts, n_pts) ) {
-		fputs(buf, stdout);
+	    if ( GeogContainPtPrepared(pt, &cp_arg->poly) ) {
+		GeogOutMem(out, ln, n);
 	    }
 	}
     }
@@ -467,20 +1000,21 @@ int vproj_cb(int argc, char *argv[])
     char *rlon_s, *rlat_s, *azg_s, *a0_s;
     double rlon, rlat;
     double azg;			/* Azimuth of proj plane from (rlon rlat) */
-    double lon, lat;
-    double az;
     double a0;			/* Earth radius */
-    double d;			/* Distance along ground from (rlat rlon) to
-				   an input point */
-    double x, y, z;
+    struct stream_opts opts;
+    struct vproj_arg vp_arg;
 
+    if ( !get_stream_opts(&argc, argv, &opts) ) {
+	return 0;
+    }
     if ( argc == 6 ) {
 	rlon_s = argv[2];
 	rlat_s = argv[3];
 	azg_s = argv[4];
 	a0_s = argv[5];
     } else {
-	fprintf(stderr, "Usage: %s %s lon lat earth_radius\n", argv0, argv1);
+	fprintf(stderr, "Usage: %s %s " STREAM_USAGE " lon lat az earth_radius\n",
+		argv0, argv1);
 	return 0;
     }
     if ( sscanf(rlat_s, "%lf", &rlat) != 1 ) {
@@ -502,18 +1036,67 @@ int vproj_cb(int argc, char *argv[])
 		a0_s);
 	return 0;
     }
-    rlat *= RAD_DEG;
-    rlon *= RAD_DEG;
-    azg *= RAD_DEG;
-    while (scanf(" %lf %lf %lf", &lon, &lat, &z) == 3) {
-	lon *= RAD_DEG;
-	lat *= RAD_DEG;
-	d = a0 * GeogDist(rlon, rlat, lon, lat);
-	az = GeogAz(rlon, rlat, lon, lat) - azg;
-	x = d * cos(az);
-	y = -d * sin(az);		/* Right handed Cartesian axes */
-	printf("%.1lf %.1lf %.1lf\n", x, y, z);
+    vp_arg.rlat = rlat * RAD_DEG;
+    vp_arg.rlon = rlon * RAD_DEG;
+    vp_arg.azg = azg * RAD_DEG;
+    vp_arg.a0 = a0;
+    vp_arg.fmt = opts.fmt;
+    return run_stream(vproj_fn, &vp_arg, &opts, 3);
+}
+
+static int vproj_fn(struct GeogIn *in, struct GeogOut *out, void *arg)
+{
+    struct vproj_arg *vp_arg = arg;
+    enum GeogIOFmt fmt = vp_arg->fmt;
+    double rlonv[LEN], rlatv[LEN];	/* rlon, rlat for each input point */
+    double lon[LEN], lat[LEN], z[LEN];	/* Input points */
+    double az[LEN];
+    double d[LEN];		/* Distance along ground from (rlat rlon) to
+				   an input point */
+    double x, y;
+    double rec[3];
+    size_t n, i;
+    struct run_stats st = {0};
+    double t;
+
+    for (i = 0; i < LEN; i++) {
+	rlonv[i] = vp_arg->rlon;
+	rlatv[i] = vp_arg->rlat;
     }
+    do {
+	t = stats_clock();
+	for (n = 0; n < LEN && GeogInRec(in, fmt, rec, 3); n++) {
+	    lon[n] = rec[0] * RAD_DEG;
+	    lat[n] = rec[1] * RAD_DEG;
+	    z[n] = rec[2];
+	}
+	stats_lap(&t, &st.t_parse);
+	GeogDistN(rlonv, rlatv, lon, lat, d, n);
+	GeogAzN(rlonv, rlatv, lon, lat, az, n);
+	stats_lap(&t, &st.t_compute);
+	for (i = 0; i < n; i++) {
+	    double dist = vp_arg->a0 * d[i], dirn = az[i] - vp_arg->azg;
+
+	    x = dist * cos(dirn);
+	    y = -dist * sin(dirn);	/* Right handed Cartesian axes */
+	    if ( fmt == GeogIOText ) {
+		GeogOutFix(out, x, 1);
+		GeogOutMem(out, " ", 1);
+		GeogOutFix(out, y, 1);
+		GeogOutMem(out, " ", 1);
+		GeogOutFix(out, z[i], 1);
+		GeogOutMem(out, "\n", 1);
+	    } else {
+		rec[0] = x;
+		rec[1] = y;
+		rec[2] = z[i];
+		GeogOutRec(out, fmt, rec, 3);
+	    }
+	}
+	stats_lap(&t, &st.t_write);
+	st.n_rec += n;
+    } while ( n == LEN );
+    stats_add(&st);
     return 1;
 }
 
@@ -527,13 +1110,16 @@ int lonlat_to_xy_cb(int argc, char *argv[])
     char **arg;				/* Argument from command line */
     size_t len;				/* Length of command line */
     char *ln;				/* Projection specifier string */
-    struct GeogProj proj;		/* Projection */
-    double lon, lat;			/* Input geographic coordinates */
-    double x, y;			/* Output map coordinates */
+    struct proj_arg pj_arg;		/* Projection and format */
     char *l, *a;			/* Point into ln, arg */
+    struct stream_opts opts;
 
+    if ( !get_stream_opts(&argc, argv, &opts) ) {
+	return 0;
+    }
     if ( argc < 3 ) {
-	fprintf(stderr, "Usage: %s %s projection\n", argv0, argv1);
+	fprintf(stderr, "Usage: %s %s " STREAM_USAGE " projection\n",
+		argv0, argv1);
 	return 0;
     }
     for (arg = argv + 2, len = 0; *arg; arg++) {
@@ -550,22 +1136,57 @@ int lonlat_to_xy_cb(int argc, char *argv[])
 	}
 	*l++ = ' ';
     }
-    if ( !GeogProjSetFmStr(ln, &proj) ) {
+    if ( !get_proj(ln, &pj_arg.proj) ) {
 	fprintf(stderr, "%s %s: failed to set projection %s\n",
 		argv0, argv1, ln);
+	FREE(ln);
 	return 0;
     }
     FREE(ln);
-    while ( scanf(" %lf %lf", &lon, &lat) == 2 ) {
-	lon *= RAD_DEG;
-	lat *= RAD_DEG;
-	if ( GeogProjLonLatToXY(lon, lat, &x, &y, &proj) ) {
-	    printf("%lf %lf ", x, y);
-	} else {
-	    printf("**** **** ");
+    pj_arg.fmt = opts.fmt;
+    return run_stream(lonlat_to_xy_fn, &pj_arg, &opts, 2);
+}
+
+static int lonlat_to_xy_fn(struct GeogIn *in, struct GeogOut *out, void *arg)
+{
+    struct proj_arg *pj_arg = arg;
+    enum GeogIOFmt fmt = pj_arg->fmt;
+    double lon[LEN], lat[LEN];		/* Input geographic coordinates */
+    double x[LEN], y[LEN];		/* Output map coordinates */
+    unsigned char ok[LEN];		/* If true, point could be projected */
+    size_t n, i;			/* Number of points in batch, index */
+    double rec[2];			/* Input or output record */
+    struct run_stats st = {0};
+    double t;
+
+    do {
+	t = stats_clock();
+	for (n = 0; n < LEN && GeogInRec(in, fmt, rec, 2); n++) {
+	    lon[n] = rec[0] * RAD_DEG;
+	    lat[n] = rec[1] * RAD_DEG;
 	}
-	printf("\n");
-    }
+	stats_lap(&t, &st.t_parse);
+	GeogProjLonLatToXYN(lon, lat, x, y, ok, n, &pj_arg->proj);
+	stats_lap(&t, &st.t_compute);
+	for (i = 0; i < n; i++) {
+	    st.n_rej += !ok[i];
+	    if ( fmt != GeogIOText ) {
+		rec[0] = ok[i] ? x[i] : NAN;
+		rec[1] = ok[i] ? y[i] : NAN;
+		GeogOutRec(out, fmt, rec, 2);
+	    } else if ( ok[i] ) {
+		GeogOutFix(out, x[i], 6);
+		GeogOutMem(out, " ", 1);
+		GeogOutFix(out, y[i], 6);
+		GeogOutMem(out, " \n", 2);
+	    } else {
+		GeogOutStr(out, "**** **** \n");
+	    }
+	}
+	stats_lap(&t, &st.t_write);
+	st.n_rec += n;
+    } while ( n == LEN );
+    stats_add(&st);
     return 1;
 }
 
@@ -579,13 +1200,16 @@ int xy_to_lonlat_cb(int argc, char *argv[])
     char **arg;				/* Argument from command line */
     size_t len;				/* Length of command line */
     char *ln;				/* Projection specifier string */
-    struct GeogProj proj;		/* Projection */
-    double x, y;			/* Input map coordinates */
-    double lon, lat;			/* Output geographic coordinates */
+    struct proj_arg pj_arg;		/* Projection and format */
     char *l, *a;			/* Point into ln, arg */
+    struct stream_opts opts;
 
+    if ( !get_stream_opts(&argc, argv, &opts) ) {
+	return 0;
+    }
     if ( argc < 3 ) {
-	fprintf(stderr, "Usage: %s %s projection\n", argv0, argv1);
+	fprintf(stderr, "Usage: %s %s " STREAM_USAGE " projection\n",
+		argv0, argv1);
 	return 0;
     }
     for (arg = argv + 2, len = 0; *arg; arg++) {
@@ -602,19 +1226,1665 @@ int xy_to_lonlat_cb(int argc, char *argv[])
 	}
 	*l++ = ' ';
     }
-    if ( !GeogProjSetFmStr(ln, &proj) ) {
+    if ( !get_proj(ln, &pj_arg.proj) ) {
+	fprintf(stderr, "%s %s: failed to set projection %s\n",
+		argv0, argv1, ln);
+	FREE(ln);
+	return 0;
+    }
+    FREE(ln);
+    pj_arg.fmt = opts.fmt;
+    return run_stream(xy_to_lonlat_fn, &pj_arg, &opts, 2);
+}
+
+static int xy_to_lonlat_fn(struct GeogIn *in, struct GeogOut *out, void *arg)
+{
+    struct proj_arg *pj_arg = arg;
+    enum GeogIOFmt fmt = pj_arg->fmt;
+    double x[LEN], y[LEN];		/* Input map coordinates */
+    double lon[LEN], lat[LEN];		/* Output geographic coordinates */
+    unsigned char ok[LEN];		/* If true, point could be converted */
+    size_t n, i;			/* Number of points in batch, index */
+    double rec[2];			/* Input or output record */
+    struct run_stats st = {0};
+    double t;
+
+    do {
+	t = stats_clock();
+	for (n = 0; n < LEN && GeogInRec(in, fmt, rec, 2); n++) {
+	    x[n] = rec[0];
+	    y[n] = rec[1];
+	}
+	stats_lap(&t, &st.t_parse);
+	GeogProjXYToLonLatN(x, y, lon, lat, ok, n, &pj_arg->proj);
+	stats_lap(&t, &st.t_compute);
+	for (i = 0; i < n; i++) {
+	    st.n_rej += !ok[i];
+	    if ( fmt != GeogIOText ) {
+		rec[0] = ok[i] ? lon[i] * DEG_RAD : NAN;
+		rec[1] = ok[i] ? lat[i] * DEG_RAD : NAN;
+		GeogOutRec(out, fmt, rec, 2);
+	    } else if ( ok[i] ) {
+		GeogOutFix(out, lon[i] * DEG_RAD, 6);
+		GeogOutMem(out, " ", 1);
+		GeogOutFix(out, lat[i] * DEG_RAD, 6);
+		GeogOutMem(out, " \n", 2);
+	    } else {
+		GeogOutStr(out, "**** **** \n");
+	    }
+	}
+	stats_lap(&t, &st.t_write);
+	st.n_rec += n;
+    } while ( n == LEN );
+    stats_add(&st);
+    return 1;
+}
+
+/*
+   Read projection specifier and grid from command line. Write longitude
+   latitude pairs for each grid point to standard output, row by row.
+ */
+
+/* Approximate number of grid points converted at a time */
+#define GRID_PTS (1 << 20)
+
+int grid_lonlat_cb(int argc, char *argv[])
+{
+    char **arg;				/* Argument from command line */
+    size_t len;				/* Length of command line */
+    char *ln;				/* Projection specifier string */
+    struct grid_arg gr_arg;		/* Projection, grid, and format */
+    char *l, *a;			/* Point into ln, arg */
+    struct stream_opts opts;
+    unsigned long nx, ny;		/* Number of columns, rows */
+    size_t n_blk, b;			/* Number of blocks, block index */
+    size_t n_out;			/* Output bytes before run */
+    double err;				/* Largest interpolation error */
+    struct GeogOut out;
+    int rslt;
+
+    if ( !get_stream_opts(&argc, argv, &opts) ) {
+	return 0;
+    }
+    gr_arg.tol = 0.0;
+    if ( argc > 3 && strcmp(argv[2], "-t") == 0 ) {
+	if ( sscanf(argv[3], "%lf", &gr_arg.tol) != 1 || gr_arg.tol <= 0.0 ) {
+	    fprintf(stderr, "%s %s: -t requires a positive tolerance in "
+		    "meters.\n", argv0, argv1);
+	    return 0;
+	}
+	memmove(argv + 2, argv + 4, (argc - 4 + 1) * sizeof(char *));
+	argc -= 2;
+    }
+    if ( argc < 9 || opts.in_fnm ) {
+	fprintf(stderr, "Usage: %s %s [-b|--binary=f64|f32] [-j threads] "
+		"[-t tolerance] projection x0 dx nx y0 dy ny\n", argv0, argv1);
+	return 0;
+    }
+    if ( sscanf(argv[argc - 6], "%lf", &gr_arg.x0) != 1
+	    || sscanf(argv[argc - 5], "%lf", &gr_arg.dx) != 1
+	    || sscanf(argv[argc - 4], "%lu", &nx) != 1
+	    || sscanf(argv[argc - 3], "%lf", &gr_arg.y0) != 1
+	    || sscanf(argv[argc - 2], "%lf", &gr_arg.dy) != 1
+	    || sscanf(argv[argc - 1], "%lu", &ny) != 1 ) {
+	fprintf(stderr, "%s %s: expected grid as x0 dx nx y0 dy ny, got "
+		"%s %s %s %s %s %s\n", argv0, argv1, argv[argc - 6],
+		argv[argc - 5], argv[argc - 4], argv[argc - 3], argv[argc - 2],
+		argv[argc - 1]);
+	return 0;
+    }
+    gr_arg.nx = nx;
+    for (arg = argv + 2, len = 0; arg < argv + argc - 6; arg++) {
+	len += strlen(*arg) + 1;
+    }
+    if ( !(ln = CALLOC(len + 1, 1)) ) {
+	fprintf(stderr, "%s %s: failed to allocate internal projection "
+		"specifier.\n", argv0, argv1);
+	return 0;
+    }
+    for (l = ln, arg = argv + 2; arg < argv + argc - 6; arg++) {
+	for (a = *arg; *a; a++, l++) {
+	    *l = *a;
+	}
+	*l++ = ' ';
+    }
+    if ( !GeogProjSetFmStr(ln, &gr_arg.proj) ) {
 	fprintf(stderr, "%s %s: failed to set projection %s\n",
 		argv0, argv1, ln);
+	FREE(ln);
 	return 0;
     }
     FREE(ln);
-    while ( scanf(" %lf %lf", &x, &y) == 2 ) {
-	if ( GeogProjXYToLonLat(x, y, &lon, &lat, &proj) ) {
-	    printf("%lf %lf ", lon * DEG_RAD, lat * DEG_RAD);
+    gr_arg.fmt = opts.fmt;
+    if ( nx == 0 || ny == 0 ) {
+	return 1;
+    }
+    if ( !out_open(&out) ) {
+	fprintf(stderr, "%s %s: could not allocate output buffer.\n",
+		argv0, argv1);
+	return 0;
+    }
+    gr_arg.blk = (nx < GRID_PTS) ? GRID_PTS / nx : 1;
+    n_blk = (ny + gr_arg.blk - 1) / gr_arg.blk;
+    if ( !(gr_arg.errs = CALLOC(n_blk, sizeof(double))) ) {
+	fprintf(stderr, "%s %s: could not allocate grid.\n", argv0, argv1);
+	out_close(&out);
+	return 0;
+    }
+    n_out = out.n_wr + out.len;
+    rslt = GeogParRange(ny, gr_arg.blk, opts.n_thr, grid_lonlat_fn, &gr_arg,
+	    &out);
+    if ( !out_flush(&out) ) {
+	fprintf(stderr, "%s %s: could not write output.\n", argv0, argv1);
+	rslt = 0;
+    }
+    stats_bytes(0, out.n_wr + out.len - n_out);
+    if ( rslt && gr_arg.tol > 0.0 ) {
+	for (b = 0, err = 0.0; b < n_blk; b++) {
+	    if ( gr_arg.errs[b] > err ) {
+		err = gr_arg.errs[b];
+	    }
+	}
+	fprintf(stderr, "%s %s: largest interpolation error %.3f m\n",
+		argv0, argv1, err);
+    }
+    FREE(gr_arg.errs);
+    out_close(&out);
+    return rslt;
+}
+
+static int grid_lonlat_fn(size_t j0, size_t j1, struct GeogOut *out,
+	void *arg)
+{
+    struct grid_arg *gr_arg = arg;
+    struct Tkx_Arena *scratch = GeogParScratch();
+    enum GeogIOFmt fmt = gr_arg->fmt;
+    size_t nx = gr_arg->nx;
+    size_t blk = gr_arg->blk;		/* Number of rows per batch */
+    double *lon, *lat;			/* Geographic coordinates for batch */
+    size_t j, j_e, k, n;		/* Row, end of batch, point index */
+    double rec[2];			/* Output record */
+    double err, *blk_err;		/* Interpolation error for a batch,
+					   for the block */
+
+    blk_err = gr_arg->errs + j0 / blk;
+    if ( blk > j1 - j0 ) {
+	blk = j1 - j0;
+    }
+    lon = ARENA_ALLOC(scratch, blk * nx * sizeof(double), 0);
+    lat = ARENA_ALLOC(scratch, blk * nx * sizeof(double), 0);
+    if ( !lon || !lat ) {
+	fprintf(stderr, "%s %s: could not allocate grid.\n", argv0, argv1);
+	return 0;
+    }
+    for (j = j0; j < j1; j = j_e) {
+	j_e = (j1 - j < blk) ? j1 : j + blk;
+	if ( gr_arg->tol > 0.0 ) {
+	    GeogProjGridToLonLatApprox(gr_arg->x0, gr_arg->dx, nx, gr_arg->y0,
+		    gr_arg->dy, j, j_e, gr_arg->tol, lon, lat, &err,
+		    &gr_arg->proj);
+	    if ( err > *blk_err ) {
+		*blk_err = err;
+	    }
 	} else {
-	    printf("**** **** ");
+	    GeogProjGridToLonLat(gr_arg->x0, gr_arg->dx, nx, gr_arg->y0,
+		    gr_arg->dy, j, j_e, lon, lat, &gr_arg->proj);
+	}
+	for (k = 0, n = (j_e - j) * nx; k < n; k++) {
+	    if ( fmt != GeogIOText ) {
+		rec[0] = lon[k] * DEG_RAD;
+		rec[1] = lat[k] * DEG_RAD;
+		GeogOutRec(out, fmt, rec, 2);
+	    } else if ( !isnan(lon[k]) ) {
+		GeogOutFix(out, lon[k] * DEG_RAD, 6);
+		GeogOutMem(out, " ", 1);
+		GeogOutFix(out, lat[k] * DEG_RAD, 6);
+		GeogOutMem(out, " \n", 2);
+	    } else {
+		GeogOutStr(out, "**** **** \n");
+	    }
 	}
-	printf("\n");
     }
-    return 1;
+    return !out->err;
+}
+
+/*
+   Read a raster file. Write it resampled into the projection and extent given
+   on the command line to standard output.
+ */
+
+/* Number of output rows given to a thread at a time */
+#define WARP_ROWS 64
+
+int warp_cb(int argc, char *argv[])
+{
+    char **arg;				/* Argument from command line */
+    size_t len;				/* Length of command line */
+    char *ln;				/* Projection specifier string */
+    char *l, *a;			/* Point into ln, arg */
+    struct warp_arg wp_arg;
+    struct stream_opts opts;
+    char *rst_fnm;			/* Input raster file */
+    double x_min, y_min, x_max, y_max;	/* Output extent */
+    unsigned long nx, ny;		/* Output size */
+    size_t n_blk, b;			/* Number of blocks, block index */
+    size_t n_out;			/* Output bytes before run */
+    double err;				/* Largest interpolation error */
+    struct GeogOut out;
+    int rslt;
+
+    if ( !get_stream_opts(&argc, argv, &opts) ) {
+	return 0;
+    }
+    wp_arg.rs = GeogNearest;
+    wp_arg.tol = 0.0;
+    while ( argc > 3 && argv[2][0] == '-' ) {
+	if ( strcmp(argv[2], "-r") == 0 && strcmp(argv[3], "nearest") == 0 ) {
+	    wp_arg.rs = GeogNearest;
+	} else if ( strcmp(argv[2], "-r") == 0
+		&& strcmp(argv[3], "bilinear") == 0 ) {
+	    wp_arg.rs = GeogBilinear;
+	} else if ( strcmp(argv[2], "-t") == 0
+		&& sscanf(argv[3], "%lf", &wp_arg.tol) == 1
+		&& wp_arg.tol > 0.0 ) {
+	    ;
+	} else {
+	    fprintf(stderr, "%s %s: invalid option %s %s\n",
+		    argv0, argv1, argv[2], argv[3]);
+	    return 0;
+	}
+	memmove(argv + 2, argv + 4, (argc - 4 + 1) * sizeof(char *));
+	argc -= 2;
+    }
+    if ( argc < 10 || opts.in_fnm ) {
+	fprintf(stderr, "Usage: %s %s [--binary=f64|f32] [-j threads] "
+		"[-r nearest|bilinear] [-t tolerance] raster projection "
+		"x_min y_min x_max y_max nx ny\n", argv0, argv1);
+	return 0;
+    }
+    rst_fnm = argv[2];
+    if ( sscanf(argv[argc - 6], "%lf", &x_min) != 1
+	    || sscanf(argv[argc - 5], "%lf", &y_min) != 1
+	    || sscanf(argv[argc - 4], "%lf", &x_max) != 1
+	    || sscanf(argv[argc - 3], "%lf", &y_max) != 1
+	    || sscanf(argv[argc - 2], "%lu", &nx) != 1
+	    || sscanf(argv[argc - 1], "%lu", &ny) != 1 ) {
+	fprintf(stderr, "%s %s: expected output extent and size as x_min "
+		"y_min x_max y_max nx ny, got %s %s %s %s %s %s\n",
+		argv0, argv1, argv[argc - 6], argv[argc - 5], argv[argc - 4],
+		argv[argc - 3], argv[argc - 2], argv[argc - 1]);
+	return 0;
+    }
+    if ( !GeogRasterOpen(&wp_arg.src, rst_fnm) ) {
+	fprintf(stderr, "%s %s: could not read raster %s\n",
+		argv0, argv1, rst_fnm);
+	return 0;
+    }
+    for (arg = argv + 3, len = 0; arg < argv + argc - 6; arg++) {
+	len += strlen(*arg) + 1;
+    }
+    if ( !(ln = CALLOC(len + 1, 1)) ) {
+	fprintf(stderr, "%s %s: failed to allocate internal projection "
+		"specifier.\n", argv0, argv1);
+	GeogRasterFree(&wp_arg.src);
+	return 0;
+    }
+    for (l = ln, arg = argv + 3; arg < argv + argc - 6; arg++) {
+	for (a = *arg; *a; a++, l++) {
+	    *l = *a;
+	}
+	*l++ = ' ';
+    }
+    if ( l > ln ) {
+	*--l = '\0';
+    }
+    if ( !GeogRasterSet(&wp_arg.dst, ln, x_min, y_min, x_max, y_max, nx, ny,
+		(opts.fmt == GeogIOText) ? wp_arg.src.fmt : opts.fmt) ) {
+	fprintf(stderr, "%s %s: invalid output raster.\n", argv0, argv1);
+	FREE(ln);
+	GeogRasterFree(&wp_arg.src);
+	return 0;
+    }
+    FREE(ln);
+    n_blk = (ny + WARP_ROWS - 1) / WARP_ROWS;
+    if ( !(wp_arg.errs = CALLOC(n_blk, sizeof(double))) ) {
+	fprintf(stderr, "%s %s: could not allocate raster.\n", argv0, argv1);
+	GeogRasterFree(&wp_arg.src);
+	return 0;
+    }
+    if ( !out_open(&out) ) {
+	fprintf(stderr, "%s %s: could not allocate output buffer.\n",
+		argv0, argv1);
+	FREE(wp_arg.errs);
+	GeogRasterFree(&wp_arg.src);
+	return 0;
+    }
+    n_out = out.n_wr + out.len;
+    rslt = GeogRasterOutHdr(&out, &wp_arg.dst)
+	&& GeogParRange(ny, WARP_ROWS, opts.n_thr, warp_fn, &wp_arg, &out);
+    if ( !out_flush(&out) ) {
+	fprintf(stderr, "%s %s: could not write output.\n", argv0, argv1);
+	rslt = 0;
+    }
+    stats_bytes(0, out.n_wr + out.len - n_out);
+    if ( rslt && wp_arg.tol > 0.0 ) {
+	for (b = 0, err = 0.0; b < n_blk; b++) {
+	    if ( wp_arg.errs[b] > err ) {
+		err = wp_arg.errs[b];
+	    }
+	}
+	fprintf(stderr, "%s %s: largest interpolation error %.3f m\n",
+		argv0, argv1, err);
+    }
+    out_close(&out);
+    FREE(wp_arg.errs);
+    GeogRasterFree(&wp_arg.src);
+    return rslt;
+}
+
+static int warp_fn(size_t j0, size_t j1, struct GeogOut *out, void *arg)
+{
+    struct warp_arg *wp_arg = arg;
+    struct Tkx_Arena *scratch = GeogParScratch();
+    size_t nx = wp_arg->dst.nx;
+    double *v;				/* Values for WARP_ROWS rows */
+    size_t j, j_e;			/* Row, end of batch */
+    double err;				/* Interpolation error for batch */
+    double *blk_err = wp_arg->errs + j0 / WARP_ROWS;
+
+    if ( !(v = ARENA_ALLOC(scratch, WARP_ROWS * nx * sizeof(double), 0)) ) {
+	fprintf(stderr, "%s %s: could not allocate raster rows.\n",
+		argv0, argv1);
+	return 0;
+    }
+    for (j = j0; j < j1; j = j_e) {
+	j_e = (j1 - j < WARP_ROWS) ? j1 : j + WARP_ROWS;
+	GeogRasterWarp(&wp_arg->src, &wp_arg->dst, 0, nx, j, j_e, wp_arg->rs,
+		wp_arg->tol, v, &err);
+	if ( err > *blk_err ) {
+	    *blk_err = err;
+	}
+	GeogOutRec(out, wp_arg->dst.fmt, v, (j_e - j) * nx);
+    }
+    return !out->err;
+}
+
+/*
+   Read polygons from a file. Read longitude latitude pairs from standard
+   input. Write each point with the id of the first polygon that contains it.
+ */
+
+int join_regions_cb(int argc, char *argv[])
+{
+    struct stream_opts opts;
+    struct join_arg jn_arg;
+    int rslt;
+
+    if ( !get_stream_opts(&argc, argv, &opts) ) {
+	return 0;
+    }
+    if ( argc != 3 ) {
+	fprintf(stderr, "Usage: %s %s " STREAM_USAGE " polyfile\n",
+		argv0, argv1);
+	return 0;
+    }
+    if ( !read_regions(argv[2], &jn_arg) ) {
+	return 0;
+    }
+    if ( !GeogRTreeInit(&jn_arg.rt, jn_arg.boxes, jn_arg.box_ids,
+		jn_arg.n_box) ) {
+	fprintf(stderr, "Could not allocate memory for region index.\n");
+	free_regions(&jn_arg);
+	return 0;
+    }
+    jn_arg.fmt = opts.fmt;
+    rslt = run_stream(join_regions_fn, &jn_arg, &opts, 2);
+    GeogRTreeFree(&jn_arg.rt);
+    free_regions(&jn_arg);
+    return rslt;
+}
+
+/*
+   Read regions for join_regions from file fnm. Each non-blank line that
+   does not start with '#' has an id followed by longitude latitude pairs,
+   in degrees, for at least three points. Also compute bounding boxes for
+   the regions. Print a message and return false on failure.
+ */
+
+static int read_regions(const char *fnm, struct join_arg *jn_arg)
+{
+    struct GeogIn in;
+    const char *ln, *l, *e;		/* Input line, point into ln, end */
+    size_t n;				/* Length of ln */
+    size_t ln_num;			/* Line number */
+    size_t sz = 0;			/* Allocation at jn_arg members */
+    struct GeogPt *pts = NULL;		/* Points from current line */
+    size_t n_pts, pts_sz = 0;
+    const char *id;			/* Region id in ln */
+    size_t id_len;
+    size_t r;
+    int nb;				/* Number of boxes for region */
+    double lon, lat;
+    void *t;
+
+    jn_arg->ids = NULL;
+    jn_arg->polys = NULL;
+    jn_arg->n_rgn = 0;
+    jn_arg->boxes = NULL;
+    jn_arg->box_ids = NULL;
+    jn_arg->n_box = 0;
+    if ( !GeogInMapFile(&in, fnm) ) {
+	return 0;
+    }
+    for (ln_num = 1; GeogInLine(&in, &ln, &n); ln_num++) {
+	for (l = ln, e = ln + n; l < e && isspace((unsigned char)*l); l++) {
+	}
+	if ( l == e || *l == '#' ) {
+	    continue;
+	}
+	for (id = l; l < e && !isspace((unsigned char)*l); l++) {
+	}
+	id_len = l - id;
+	for (n_pts = 0;
+		GeogIOParseDbl(&l, e, &lon) && GeogIOParseDbl(&l, e, &lat);
+		n_pts++) {
+	    if ( n_pts == pts_sz ) {
+		pts_sz = 2 * pts_sz + 64;
+		if ( !(t = REALLOC(pts, pts_sz * sizeof(struct GeogPt))) ) {
+		    fprintf(stderr, "Could not allocate memory for polygon.\n");
+		    goto error;
+		}
+		pts = t;
+	    }
+	    pts[n_pts].lon = lon * RAD_DEG;
+	    pts[n_pts].lat = lat * RAD_DEG;
+	}
+	for ( ; l < e && isspace((unsigned char)*l); l++) {
+	}
+	if ( l != e || n_pts < 3 ) {
+	    fprintf(stderr, "%s line %lu: expected region id followed by "
+		    "at least three longitude latitude pairs.\n",
+		    fnm, (unsigned long)ln_num);
+	    goto error;
+	}
+	if ( jn_arg->n_rgn == sz ) {
+	    sz = 2 * sz + 64;
+	    if ( !(t = REALLOC(jn_arg->ids, sz * sizeof(char *))) ) {
+		goto alloc_error;
+	    }
+	    jn_arg->ids = t;
+	    t = REALLOC(jn_arg->polys, sz * sizeof(struct GeogPreparedPolygon));
+	    if ( !t ) {
+		goto alloc_error;
+	    }
+	    jn_arg->polys = t;
+	    if ( !(t = REALLOC(jn_arg->boxes, 2 * sz * sizeof(struct GeogBox))) ) {
+		goto alloc_error;
+	    }
+	    jn_arg->boxes = t;
+	    if ( !(t = REALLOC(jn_arg->box_ids, 2 * sz * sizeof(size_t))) ) {
+		goto alloc_error;
+	    }
+	    jn_arg->box_ids = t;
+	}
+	r = jn_arg->n_rgn;
+	if ( !(jn_arg->ids[r] = MALLOC(id_len + 1)) ) {
+	    goto alloc_error;
+	}
+	memcpy(jn_arg->ids[r], id, id_len);
+	jn_arg->ids[r][id_len] = '\0';
+	if ( !GeogPreparedPolygonInit(jn_arg->polys + r, pts, n_pts) ) {
+	    FREE(jn_arg->ids[r]);
+	    goto alloc_error;
+	}
+	jn_arg->n_rgn++;
+	for (nb = GeogPolygonBox(pts, n_pts, jn_arg->boxes + jn_arg->n_box);
+		nb > 0; nb--) {
+	    jn_arg->box_ids[jn_arg->n_box++] = r;
+	}
+    }
+    if ( jn_arg->n_rgn == 0 ) {
+	fprintf(stderr, "No regions in %s.\n", fnm);
+	goto error;
+    }
+    FREE(pts);
+    GeogInFree(&in);
+    return 1;
+
+alloc_error:
+    fprintf(stderr, "Could not allocate memory for regions.\n");
+error:
+    FREE(pts);
+    GeogInFree(&in);
+    free_regions(jn_arg);
+    return 0;
+}
+
+/* Free memory allocated by read_regions */
+static void free_regions(struct join_arg *jn_arg)
+{
+    size_t r;
+
+    for (r = 0; r < jn_arg->n_rgn; r++) {
+	FREE(jn_arg->ids[r]);
+	GeogPreparedPolygonFree(jn_arg->polys + r);
+    }
+    FREE(jn_arg->ids);
+    FREE(jn_arg->polys);
+    FREE(jn_arg->boxes);
+    FREE(jn_arg->box_ids);
+    jn_arg->n_rgn = 0;
+}
+
+/*
+   Callback for GeogRTreeQuery in join_regions_fn. Record region r if it
+   contains the query point and comes before any region found so far.
+ */
+
+static void join_regions_test(size_t r, void *arg)
+{
+    struct join_query *q = arg;
+
+    if ( r < q->rgn && GeogContainPtPrepared(q->pt, q->jn_arg->polys + r) ) {
+	q->rgn = r;
+    }
+}
+
+static int join_regions_fn(struct GeogIn *in, struct GeogOut *out, void *arg)
+{
+    struct join_arg *jn_arg = arg;
+    enum GeogIOFmt fmt = jn_arg->fmt;
+    struct join_query q;
+    const char *ln, *l;			/* Input line, point into ln */
+    size_t n;				/* Length of ln */
+    double rec[3];			/* Binary input and output record */
+
+    q.jn_arg = jn_arg;
+    if ( fmt != GeogIOText ) {
+	while ( GeogInRec(in, fmt, rec, 2) ) {
+	    q.pt.lon = rec[0] * RAD_DEG;
+	    q.pt.lat = rec[1] * RAD_DEG;
+	    q.rgn = jn_arg->n_rgn;
+	    GeogRTreeQuery(&jn_arg->rt, q.pt, join_regions_test, &q);
+	    rec[2] = (q.rgn < jn_arg->n_rgn) ? (double)q.rgn : -1.0;
+	    GeogOutRec(out, fmt, rec, 3);
+	}
+	return 1;
+    }
+    while ( GeogInLine(in, &ln, &n) ) {
+	l = ln;
+	if ( GeogIOParseDbl(&l, ln + n, &q.pt.lon)
+		&& GeogIOParseDbl(&l, ln + n, &q.pt.lat) ) {
+	    q.pt.lon *= RAD_DEG;
+	    q.pt.lat *= RAD_DEG;
+	    q.rgn = jn_arg->n_rgn;
+	    GeogRTreeQuery(&jn_arg->rt, q.pt, join_regions_test, &q);
+	    if ( n > 0 && ln[n - 1] == '\n' ) {
+		n--;
+	    }
+	    GeogOutMem(out, ln, n);
+	    GeogOutMem(out, " ", 1);
+	    GeogOutStr(out, (q.rgn < jn_arg->n_rgn) ? jn_arg->ids[q.rgn] : "-");
+	    GeogOutMem(out, "\n", 1);
+	}
+    }
+    return 1;
+}
+
+/*
+   Read sites from a file. Read longitude latitude pairs from standard input.
+   Write each point with the ids and distances of the nearest sites.
+ */
+
+int nearest_cb(int argc, char *argv[])
+{
+    struct stream_opts opts;
+    struct nearest_arg nr_arg;
+    char *sites_fnm = NULL;		/* Sites file */
+    char **a;
+    struct GeogPt *pts;			/* Site locations */
+    size_t n_pts;
+    int k = 1;				/* Number of neighbors */
+    int rslt;
+
+    if ( !get_stream_opts(&argc, argv, &opts) ) {
+	return 0;
+    }
+    for (a = argv + 2; *a; a++) {
+	if ( strcmp(*a, "-k") == 0 ) {
+	    if ( !*++a || sscanf(*a, "%d", &k) != 1 || k < 1 ) {
+		fprintf(stderr, "%s %s: -k requires a positive number of "
+			"sites.\n", argv0, argv1);
+		return 0;
+	    }
+	} else if ( !sites_fnm ) {
+	    sites_fnm = *a;
+	} else {
+	    sites_fnm = NULL;
+	    break;
+	}
+    }
+    if ( !sites_fnm ) {
+	fprintf(stderr, "Usage: %s %s " STREAM_USAGE " sitesfile [-k K]\n",
+		argv0, argv1);
+	return 0;
+    }
+    if ( !read_sites(sites_fnm, &nr_arg.ids, &nr_arg.id_offs, &pts,
+		&n_pts) ) {
+	return 0;
+    }
+    if ( !GeogKnnInit(&nr_arg.kx, pts, n_pts) ) {
+	fprintf(stderr, "Could not allocate memory for site index.\n");
+	FREE(pts);
+	FREE(nr_arg.ids);
+	FREE(nr_arg.id_offs);
+	return 0;
+    }
+    FREE(pts);
+    nr_arg.k = k;
+    nr_arg.fmt = opts.fmt;
+    rslt = run_stream(nearest_fn, &nr_arg, &opts, 2);
+    GeogKnnFree(&nr_arg.kx);
+    FREE(nr_arg.ids);
+    FREE(nr_arg.id_offs);
+    return rslt;
+}
+
+/*
+   Read sites for nearest or within from file fnm. Each non-blank line that
+   does not start with '#' has an id followed by longitude and latitude in
+   degrees. Put an allocated string of nul separated ids at *ids, and an
+   allocated array with the offset in *ids of each id at *id_offs. Put an
+   allocated array of site locations at *pts and the number of sites at
+   *n_pts. Print a message and return false on failure.
+ */
+
+static int read_sites(const char *fnm, char **ids, size_t **id_offs,
+	struct GeogPt **pts, size_t *n_pts)
+{
+    struct GeogIn in;
+    const char *ln, *l, *e;		/* Input line, point into ln, end */
+    size_t n;				/* Length of ln */
+    size_t ln_num;			/* Line number */
+    const char *id;			/* Site id in ln */
+    size_t id_len;
+    size_t n_ids, ids_sz = 0;		/* Length, allocation at *ids */
+    size_t pts_sz = 0;			/* Allocation at *pts */
+    struct GeogPt pt;
+    void *t;
+
+    *ids = NULL;
+    *id_offs = NULL;
+    *pts = NULL;
+    *n_pts = 0;
+    if ( !GeogInMapFile(&in, fnm) ) {
+	return 0;
+    }
+    for (ln_num = 1, n_ids = 0; GeogInLine(&in, &ln, &n); ln_num++) {
+	for (l = ln, e = ln + n; l < e && isspace((unsigned char)*l); l++) {
+	}
+	if ( l == e || *l == '#' ) {
+	    continue;
+	}
+	for (id = l; l < e && !isspace((unsigned char)*l); l++) {
+	}
+	id_len = l - id;
+	if ( !GeogIOParseDbl(&l, e, &pt.lon)
+		|| !GeogIOParseDbl(&l, e, &pt.lat) ) {
+	    fprintf(stderr, "%s line %lu: expected site id, longitude, and "
+		    "latitude.\n", fnm, (unsigned long)ln_num);
+	    goto error;
+	}
+	if ( *n_pts == pts_sz ) {
+	    pts_sz = 2 * pts_sz + 1024;
+	    if ( !(t = REALLOC(*pts, pts_sz * sizeof(struct GeogPt))) ) {
+		goto alloc_error;
+	    }
+	    *pts = t;
+	    if ( !(t = REALLOC(*id_offs, pts_sz * sizeof(size_t))) ) {
+		goto alloc_error;
+	    }
+	    *id_offs = t;
+	}
+	if ( n_ids + id_len + 1 > ids_sz ) {
+	    ids_sz = 2 * ids_sz + id_len + 4096;
+	    if ( !(t = REALLOC(*ids, ids_sz)) ) {
+		goto alloc_error;
+	    }
+	    *ids = t;
+	}
+	memcpy(*ids + n_ids, id, id_len);
+	(*ids)[n_ids + id_len] = '\0';
+	(*id_offs)[*n_pts] = n_ids;
+	n_ids += id_len + 1;
+	pt.lon *= RAD_DEG;
+	pt.lat *= RAD_DEG;
+	(*pts)[(*n_pts)++] = pt;
+    }
+    if ( *n_pts == 0 ) {
+	fprintf(stderr, "No sites in %s.\n", fnm);
+	goto error;
+    }
+    GeogInFree(&in);
+    return 1;
+
+alloc_error:
+    fprintf(stderr, "Could not allocate memory for sites.\n");
+error:
+    GeogInFree(&in);
+    FREE(*pts);
+    FREE(*ids);
+    FREE(*id_offs);
+    *pts = NULL;
+    return 0;
+}
+
+static int nearest_fn(struct GeogIn *in, struct GeogOut *out, void *arg)
+{
+    struct nearest_arg *nr_arg = arg;
+    struct Tkx_Arena *scratch = GeogParScratch();
+    enum GeogIOFmt fmt = nr_arg->fmt;
+    size_t k = nr_arg->k;
+    size_t *id;				/* Neighbor indexes */
+    double *dist;			/* Neighbor distances */
+    double *rec;			/* Binary input and output record */
+    struct GeogPt pt;
+    const char *ln, *l;			/* Input line, point into ln */
+    size_t n;				/* Length of ln */
+    size_t m, i;			/* Number of neighbors found, index */
+
+    id = ARENA_ALLOC(scratch, k * sizeof(size_t), 0);
+    dist = ARENA_ALLOC(scratch, k * sizeof(double), 0);
+    rec = ARENA_ALLOC(scratch, (2 + 2 * k) * sizeof(double), 0);
+    if ( !id || !dist || !rec ) {
+	fprintf(stderr, "Could not allocate memory for neighbors.\n");
+	return 0;
+    }
+    if ( fmt != GeogIOText ) {
+	while ( GeogInRec(in, fmt, rec, 2) ) {
+	    pt.lon = rec[0] * RAD_DEG;
+	    pt.lat = rec[1] * RAD_DEG;
+	    m = GeogKnnQuery(&nr_arg->kx, pt, k, id, dist);
+	    for (i = 0; i < k; i++) {
+		rec[2 + 2 * i] = (i < m) ? (double)id[i] : -1.0;
+		rec[3 + 2 * i] = (i < m) ? dist[i] * DEG_RAD : NAN;
+	    }
+	    GeogOutRec(out, fmt, rec, 2 + 2 * k);
+	}
+    } else {
+	while ( GeogInLine(in, &ln, &n) ) {
+	    l = ln;
+	    if ( GeogIOParseDbl(&l, ln + n, &pt.lon)
+		    && GeogIOParseDbl(&l, ln + n, &pt.lat) ) {
+		pt.lon *= RAD_DEG;
+		pt.lat *= RAD_DEG;
+		m = GeogKnnQuery(&nr_arg->kx, pt, k, id, dist);
+		if ( n > 0 && ln[n - 1] == '\n' ) {
+		    n--;
+		}
+		GeogOutMem(out, ln, n);
+		for (i = 0; i < m; i++) {
+		    GeogOutMem(out, " ", 1);
+		    GeogOutStr(out, nr_arg->ids + nr_arg->id_offs[id[i]]);
+		    GeogOutMem(out, " ", 1);
+		    GeogOutFix(out, dist[i] * DEG_RAD, 6);
+		}
+		GeogOutMem(out, "\n", 1);
+	    }
+	}
+    }
+    return 1;
+}
+
+/*
+   Read points from a file given on the command line. Read longitude
+   latitude pairs from standard input. For each input point, write a row
+   with the distance to each point from the file, and optionally the
+   azimuth.
+ */
+
+/* Approximate number of matrix elements computed at a time */
+#define DM_ELEM (1 << 21)
+
+/* Largest number of rows computed at a time */
+#define DM_ROWS 64
+
+int dist_matrix_cb(int argc, char *argv[])
+{
+    struct stream_opts opts;
+    struct dist_matrix_arg dm_arg;
+    struct GeogPt *pts;			/* Points from file */
+    int rslt;
+
+    if ( !get_stream_opts(&argc, argv, &opts) ) {
+	return 0;
+    }
+    dm_arg.az = 0;
+    if ( argc > 2 && strcmp(argv[2], "-a") == 0 ) {
+	dm_arg.az = 1;
+	memmove(argv + 2, argv + 3, (argc - 3 + 1) * sizeof(char *));
+	argc--;
+    }
+    if ( argc != 3 ) {
+	fprintf(stderr, "Usage: %s %s " STREAM_USAGE " [-a] pointsfile\n",
+		argv0, argv1);
+	return 0;
+    }
+    if ( !read_pts(argv[2], &pts, &dm_arg.n_cols) ) {
+	return 0;
+    }
+    if ( dm_arg.n_cols == 0 ) {
+	fprintf(stderr, "%s %s: no points in %s\n", argv0, argv1, argv[2]);
+	FREE(pts);
+	return 0;
+    }
+    if ( !(dm_arg.cols = CALLOC(dm_arg.n_cols, sizeof(struct GeogTrigPt))) ) {
+	fprintf(stderr, "%s %s: could not allocate points.\n", argv0, argv1);
+	FREE(pts);
+	return 0;
+    }
+    GeogTrigPtInit(pts, dm_arg.cols, dm_arg.n_cols);
+    FREE(pts);
+    dm_arg.fmt = opts.fmt;
+    rslt = run_stream(dist_matrix_fn, &dm_arg, &opts, 2);
+    FREE(dm_arg.cols);
+    return rslt;
+}
+
+static int dist_matrix_fn(struct GeogIn *in, struct GeogOut *out, void *arg)
+{
+    struct dist_matrix_arg *dm_arg = arg;
+    struct Tkx_Arena *scratch = GeogParScratch();
+    enum GeogIOFmt fmt = dm_arg->fmt;
+    size_t m = dm_arg->n_cols;
+    size_t max_rows;			/* Number of rows per batch */
+    struct GeogPt pts[DM_ROWS];		/* Points from input */
+    struct GeogTrigPt rows[DM_ROWS];
+    double *dist = NULL, *az = NULL;	/* Distances, azimuths for batch */
+    double rec[2];
+    size_t n, i, j;
+    int rslt = 1;
+
+    max_rows = DM_ELEM / m;
+    if ( max_rows < 1 ) {
+	max_rows = 1;
+    } else if ( max_rows > DM_ROWS ) {
+	max_rows = DM_ROWS;
+    }
+    if ( !(dist = ARENA_ALLOC(scratch, max_rows * m * sizeof(double), 0))
+	    || (dm_arg->az && !(az = ARENA_ALLOC(scratch,
+			    max_rows * m * sizeof(double), 0))) ) {
+	fprintf(stderr, "Could not allocate distance matrix rows.\n");
+	return 0;
+    }
+    do {
+	for (n = 0; n < max_rows && GeogInRec(in, fmt, rec, 2); n++) {
+	    pts[n].lon = rec[0] * RAD_DEG;
+	    pts[n].lat = rec[1] * RAD_DEG;
+	}
+	GeogTrigPtInit(pts, rows, n);
+	GeogDistMatrix(rows, n, dm_arg->cols, m, dist, az);
+	for (i = 0; i < n * m; i++) {
+	    dist[i] *= DEG_RAD;
+	    if ( az ) {
+		az[i] *= DEG_RAD;
+	    }
+	}
+	for (i = 0; i < n; i++) {
+	    if ( fmt == GeogIOText ) {
+		for (j = 0; j < m; j++) {
+		    if ( j > 0 ) {
+			GeogOutMem(out, " ", 1);
+		    }
+		    GeogOutFix(out, dist[i * m + j], 6);
+		    if ( az ) {
+			GeogOutMem(out, " ", 1);
+			GeogOutFix(out, az[i * m + j], 6);
+		    }
+		}
+		GeogOutMem(out, "\n", 1);
+	    } else if ( az ) {
+		for (j = 0; j < m; j++) {
+		    rec[0] = dist[i * m + j];
+		    rec[1] = az[i * m + j];
+		    GeogOutRec(out, fmt, rec, 2);
+		}
+	    } else {
+		GeogOutRec(out, fmt, dist + i * m, m);
+	    }
+	}
+	if ( out->err ) {
+	    rslt = 0;
+	    break;
+	}
+    } while ( n == max_rows );
+    return rslt;
+}
+
+/*
+   Read longitude latitude pairs, in degrees, from file fnm. Store them in
+   radians in a newly allocated array at *pts, and the number of points at
+   *n_pts. Print a message and return false on failure.
+ */
+
+static int read_pts(const char *fnm, struct GeogPt **pts, size_t *n_pts)
+{
+    struct GeogIn in;
+    size_t pts_sz = 0;			/* Allocation at *pts */
+    double lon, lat;
+    void *t;
+
+    *pts = NULL;
+    *n_pts = 0;
+    if ( !GeogInMapFile(&in, fnm) ) {
+	fprintf(stderr, "%s %s: could not read %s\n", argv0, argv1, fnm);
+	return 0;
+    }
+    while ( GeogInDbl(&in, &lon) ) {
+	if ( !GeogInDbl(&in, &lat) ) {
+	    fprintf(stderr, "%s %s: %s has a longitude without latitude.\n",
+		    argv0, argv1, fnm);
+	    FREE(*pts);
+	    GeogInFree(&in);
+	    return 0;
+	}
+	if ( *n_pts == pts_sz ) {
+	    pts_sz = pts_sz ? 2 * pts_sz : LEN;
+	    if ( !(t = REALLOC(*pts, pts_sz * sizeof(struct GeogPt))) ) {
+		fprintf(stderr, "%s %s: could not allocate points.\n",
+			argv0, argv1);
+		FREE(*pts);
+		GeogInFree(&in);
+		return 0;
+	    }
+	    *pts = t;
+	}
+	(*pts)[*n_pts].lon = lon * RAD_DEG;
+	(*pts)[*n_pts].lat = lat * RAD_DEG;
+	(*n_pts)++;
+    }
+    GeogInFree(&in);
+    return 1;
+}
+
+/*
+   Read sites from a file and a radius from the command line. Read longitude
+   latitude pairs from standard input. Write each point with the ids and
+   distances of the sites within the radius, nearest first.
+ */
+
+int within_cb(int argc, char *argv[])
+{
+    struct stream_opts opts;
+    struct within_arg wn_arg;
+    char *r_s;				/* Radius from command line */
+    double r;				/* Radius, degrees */
+    struct GeogPt *pts;			/* Site locations */
+    size_t n_pts;
+    int rslt;
+
+    if ( !get_stream_opts(&argc, argv, &opts) ) {
+	return 0;
+    }
+    if ( argc != 4 ) {
+	fprintf(stderr, "Usage: %s %s " STREAM_USAGE " sitesfile radius\n",
+		argv0, argv1);
+	return 0;
+    }
+    r_s = argv[3];
+    if ( sscanf(r_s, "%lf", &r) != 1 || !(r >= 0.0) ) {
+	fprintf(stderr, "%s %s: expected non-negative float value for "
+		"radius, got %s\n", argv0, argv1, r_s);
+	return 0;
+    }
+    if ( !read_sites(argv[2], &wn_arg.ids, &wn_arg.id_offs, &pts,
+		&n_pts) ) {
+	return 0;
+    }
+    wn_arg.r = r * RAD_DEG;
+    if ( !GeogRadiusInit(&wn_arg.rx, pts, n_pts, wn_arg.r) ) {
+	fprintf(stderr, "Could not allocate memory for site index.\n");
+	FREE(pts);
+	FREE(wn_arg.ids);
+	FREE(wn_arg.id_offs);
+	return 0;
+    }
+    FREE(pts);
+    wn_arg.fmt = opts.fmt;
+    rslt = run_stream(within_fn, &wn_arg, &opts, 2);
+    GeogRadiusFree(&wn_arg.rx);
+    FREE(wn_arg.ids);
+    FREE(wn_arg.id_offs);
+    return rslt;
+}
+
+/* Add a site found by GeogRadiusQuery to a within_hits structure */
+static void within_add(size_t id, double dist, void *arg)
+{
+    struct within_hits *hits = arg;
+    void *t;
+
+    if ( hits->n == hits->sz ) {
+	size_t sz = 2 * hits->sz + 64;
+
+	if ( !(t = ARENA_ALLOC(hits->scratch,
+			sz * sizeof(struct within_hit), 0)) ) {
+	    hits->err = 1;
+	    return;
+	}
+	if ( hits->n > 0 ) {
+	    memcpy(t, hits->hit, hits->n * sizeof(struct within_hit));
+	}
+	hits->hit = t;
+	hits->sz = sz;
+    }
+    hits->hit[hits->n].dist = dist;
+    hits->hit[hits->n].id = id;
+    hits->n++;
+}
+
+/* Compare sites found by within by distance, then id, for qsort */
+static int within_cmp(const void *a, const void *b)
+{
+    const struct within_hit *h1 = a, *h2 = b;
+
+    if ( h1->dist != h2->dist ) {
+	return (h1->dist < h2->dist) ? -1 : 1;
+    }
+    return (h1->id < h2->id) ? -1 : (h1->id > h2->id) ? 1 : 0;
+}
+
+static int within_fn(struct GeogIn *in, struct GeogOut *out, void *arg)
+{
+    struct within_arg *wn_arg = arg;
+    enum GeogIOFmt fmt = wn_arg->fmt;
+    struct within_hits hits;		/* Sites found for current point */
+    double rec[4];			/* Binary input and output record */
+    struct GeogPt pt;
+    const char *ln, *l;			/* Input line, point into ln */
+    size_t n;				/* Length of ln */
+    size_t i;
+
+    hits.hit = NULL;
+    hits.n = hits.sz = 0;
+    hits.scratch = GeogParScratch();
+    hits.err = 0;
+    while ( !hits.err ) {
+	if ( fmt != GeogIOText ) {
+	    if ( !GeogInRec(in, fmt, rec, 2) ) {
+		break;
+	    }
+	    pt.lon = rec[0] * RAD_DEG;
+	    pt.lat = rec[1] * RAD_DEG;
+	} else {
+	    if ( !GeogInLine(in, &ln, &n) ) {
+		break;
+	    }
+	    l = ln;
+	    if ( !GeogIOParseDbl(&l, ln + n, &pt.lon)
+		    || !GeogIOParseDbl(&l, ln + n, &pt.lat) ) {
+		continue;
+	    }
+	    pt.lon *= RAD_DEG;
+	    pt.lat *= RAD_DEG;
+	}
+	hits.n = 0;
+	GeogRadiusQuery(&wn_arg->rx, pt, wn_arg->r, within_add, &hits);
+	qsort(hits.hit, hits.n, sizeof(struct within_hit), within_cmp);
+	if ( fmt != GeogIOText ) {
+	    for (i = 0; i < hits.n; i++) {
+		rec[2] = (double)hits.hit[i].id;
+		rec[3] = hits.hit[i].dist * DEG_RAD;
+		GeogOutRec(out, fmt, rec, 4);
+	    }
+	} else {
+	    if ( n > 0 && ln[n - 1] == '\n' ) {
+		n--;
+	    }
+	    GeogOutMem(out, ln, n);
+	    for (i = 0; i < hits.n; i++) {
+		GeogOutMem(out, " ", 1);
+		GeogOutStr(out, wn_arg->ids + wn_arg->id_offs[hits.hit[i].id]);
+		GeogOutMem(out, " ", 1);
+		GeogOutFix(out, hits.hit[i].dist * DEG_RAD, 6);
+	    }
+	    GeogOutMem(out, "\n", 1);
+	}
+    }
+    if ( hits.err ) {
+	fprintf(stderr, "Could not allocate memory for sites within "
+		"radius.\n");
+	return 0;
+    }
+    return 1;
+}
+
+/*
+   Remove options for streaming subcommands from the start of argv[2] ...
+   and store them in opts. argv remains null terminated, and *argc is
+   adjusted. Print a message and return false if an option is invalid.
+ */
+
+static int get_stream_opts(int *argc, char *argv[], struct stream_opts *opts)
+{
+    char **a;
+    int n;				/* Number of option words */
+
+    opts->fmt = GeogIOText;
+    opts->in_fnm = NULL;
+    opts->n_thr = 1;
+    for (a = argv + 2, n = 0; *a; a++, n++) {
+	if ( strcmp(*a, "-b") == 0 ) {
+	    opts->fmt = GeogIOF64;
+	} else if ( strncmp(*a, "--binary=", 9) == 0 ) {
+	    if ( !GeogIOFmtFmStr(*a + 9, &opts->fmt) ) {
+		fprintf(stderr, "%s %s: unknown format %s. Must be f64, f32, "
+			"or text.\n", argv0, argv1, *a + 9);
+		return 0;
+	    }
+	} else if ( strcmp(*a, "-i") == 0 ) {
+	    if ( !*++a ) {
+		fprintf(stderr, "%s %s: -i requires a file name.\n",
+			argv0, argv1);
+		return 0;
+	    }
+	    opts->in_fnm = *a;
+	    n++;
+	} else if ( strcmp(*a, "-j") == 0 ) {
+	    if ( !*++a || sscanf(*a, "%d", &opts->n_thr) != 1
+		    || opts->n_thr < 1 ) {
+		fprintf(stderr, "%s %s: -j requires a positive number of "
+			"threads.\n", argv0, argv1);
+		return 0;
+	    }
+	    n++;
+	} else {
+	    break;
+	}
+    }
+    if ( n > 0 ) {
+	memmove(argv + 2, argv + 2 + n, (*argc - 2 - n + 1) * sizeof(char *));
+	*argc -= n;
+    }
+    return 1;
+}
+
+/*
+   Apply fn with client data arg to the input indicated by opts, sending
+   results to standard output. n_val is the number of values in an input
+   record. Print a message and return false on failure.
+ */
+
+static int run_stream(GeogParFn *fn, void *arg, struct stream_opts *opts,
+	size_t n_val)
+{
+    struct GeogIn in;
+    struct GeogOut out;
+    size_t rec_sz;			/* Size of binary input record */
+    size_t n_in, n_out;			/* Bytes read, output bytes before
+					   run */
+    int rslt;
+
+    if ( opts->in_fnm ) {
+	if ( !GeogInMapFile(&in, opts->in_fnm) ) {
+	    fprintf(stderr, "%s %s: could not read %s.\n",
+		    argv0, argv1, opts->in_fnm);
+	    return 0;
+	}
+    } else if ( req_in ) {
+	in = *req_in;
+    } else if ( !GeogInInit(&in, STDIN_FILENO) ) {
+	fprintf(stderr, "%s %s: could not allocate input buffer.\n",
+		argv0, argv1);
+	return 0;
+    }
+    if ( !out_open(&out) ) {
+	fprintf(stderr, "%s %s: could not allocate output buffer.\n",
+		argv0, argv1);
+	GeogInFree(&in);
+	return 0;
+    }
+    rec_sz = (opts->fmt == GeogIOF64) ? 8 * n_val
+	: (opts->fmt == GeogIOF32) ? 4 * n_val : 0;
+    n_in = (in.fd != -1) ? in.n_rd : (size_t)(in.e - in.p);
+    n_out = out.n_wr + out.len;
+    rslt = GeogParRun(&in, rec_sz, opts->n_thr, fn, arg, &out);
+    if ( !out_flush(&out) ) {
+	fprintf(stderr, "%s %s: could not write output.\n", argv0, argv1);
+	rslt = 0;
+    }
+    if ( in.fd != -1 ) {
+	n_in = in.n_rd - n_in;
+    }
+    stats_bytes(n_in, out.n_wr + out.len - n_out);
+    GeogInFree(&in);
+    out_close(&out);
+    return rslt;
+}
+
+/*
+   Return monotonic time in seconds if gathering statistics, otherwise 0.0.
+ */
+
+static double stats_clock(void)
+{
+    struct timespec ts;
+
+    if ( !stats || clock_gettime(CLOCK_MONOTONIC, &ts) != 0 ) {
+	return 0.0;
+    }
+    return ts.tv_sec + 1.0e-9 * ts.tv_nsec;
+}
+
+/*
+   If gathering statistics, add time elapsed since *t to *acc, and set *t to
+   the current time. Phases are timed once per batch of records, so the
+   clock is read a few times for every LEN records.
+ */
+
+static void stats_lap(double *t, double *acc)
+{
+    double t1;
+
+    if ( stats ) {
+	t1 = stats_clock();
+	*acc += t1 - *t;
+	*t = t1;
+    }
+}
+
+/* Add counts from one call of a transformation to run_stats */
+static void stats_add(const struct run_stats *st)
+{
+    if ( !stats ) {
+	return;
+    }
+    pthread_mutex_lock(&stats_mtx);
+    run_stats.n_rec += st->n_rec;
+    run_stats.n_rej += st->n_rej;
+    run_stats.t_parse += st->t_parse;
+    run_stats.t_compute += st->t_compute;
+    run_stats.t_write += st->t_write;
+    stats_phases = 1;
+    pthread_mutex_unlock(&stats_mtx);
+}
+
+/*
+   Add n_in bytes read and n_out bytes written by one subcommand to the
+   totals. Output bytes count what was written to the descriptor or buffered
+   in memory, so runs that share an output, as in geog batch and geog serve,
+   are each counted once.
+ */
+
+static void stats_bytes(size_t n_in, size_t n_out)
+{
+    if ( !stats ) {
+	return;
+    }
+    pthread_mutex_lock(&stats_mtx);
+    stats_in += n_in;
+    stats_out += n_out;
+    pthread_mutex_unlock(&stats_mtx);
+}
+
+/*
+   Print statistics for a run that took wall seconds to standard error.
+ */
+
+static void stats_print(double wall)
+{
+    double t = run_stats.t_parse + run_stats.t_compute + run_stats.t_write;
+    double w = (wall > 0.0) ? wall : 1.0e-9;
+
+    fprintf(stderr, "%s %s: wall %.6f s", argv0, argv1, wall);
+    fprintf(stderr, ", bytes in %lu (%.1f MB/s), bytes out %lu (%.1f MB/s)\n",
+	    (unsigned long)stats_in, stats_in / w * 1.0e-6,
+	    (unsigned long)stats_out, stats_out / w * 1.0e-6);
+    if ( !stats_phases ) {
+	return;
+    }
+    if ( t <= 0.0 ) {
+	t = 1.0e-9;
+    }
+    fprintf(stderr, "%s %s: records %lu, rejected %lu, %.0f records/s\n",
+	    argv0, argv1, (unsigned long)run_stats.n_rec,
+	    (unsigned long)run_stats.n_rej, run_stats.n_rec / w);
+    fprintf(stderr, "%s %s: parse %.6f s (%.1f%%), compute %.6f s (%.1f%%), "
+	    "write %.6f s (%.1f%%)\n", argv0, argv1,
+	    run_stats.t_parse, 100.0 * run_stats.t_parse / t,
+	    run_stats.t_compute, 100.0 * run_stats.t_compute / t,
+	    run_stats.t_write, 100.0 * run_stats.t_write / t);
+}
+
+/*
+   Print results of a subcommand like printf, to standard output, or to
+   req_out while serving a request.
+ */
+
+static int out_printf(const char *fmt, ...)
+{
+    va_list ap, ap2;
+    char buf[256], *b;
+    int n;
+
+    va_start(ap, fmt);
+    if ( !req_out ) {
+	n = vprintf(fmt, ap);
+	va_end(ap);
+	return n;
+    }
+    va_copy(ap2, ap);
+    n = vsnprintf(buf, sizeof(buf), fmt, ap);
+    if ( n >= 0 && (size_t)n < sizeof(buf) ) {
+	GeogOutMem(req_out, buf, n);
+    } else if ( n >= 0 && (b = MALLOC(n + 1)) ) {
+	vsnprintf(b, n + 1, fmt, ap2);
+	GeogOutMem(req_out, b, n);
+	FREE(b);
+    } else {
+	req_out->err = 1;
+    }
+    va_end(ap2);
+    va_end(ap);
+    return n;
+}
+
+/*
+   Initialize out for results of a subcommand. It writes to standard output,
+   or takes over req_out while serving a request. Return false on failure.
+ */
+
+static int out_open(struct GeogOut *out)
+{
+    if ( req_out ) {
+	*out = *req_out;
+	return 1;
+    }
+    return GeogOutInit(out, STDOUT_FILENO);
+}
+
+/* Flush out, if it writes to standard output. Return false on failure. */
+static int out_flush(struct GeogOut *out)
+{
+    return req_out ? !out->err : GeogOutFlush(out);
+}
+
+/* Release out, or give it back to req_out */
+static void out_close(struct GeogOut *out)
+{
+    if ( req_out ) {
+	*req_out = *out;
+    } else {
+	GeogOutFree(out);
+    }
+}
+
+/*
+   Answer requests on a Unix domain socket. See geog (1) for the protocol.
+ */
+
+int serve_cb(int argc, char *argv[])
+{
+    int rslt;
+    int i;
+
+    if ( argc != 3 ) {
+	fprintf(stderr, "Usage: %s %s socket\n", argv0, argv1);
+	return 0;
+    }
+    serving = 1;
+    rslt = GeogServe(argv[2], argv0, run_req, NULL);
+    serving = 0;
+    for (i = 0; i < N_CACHE; i++) {
+	FREE(proj_cache[i].spec);
+	if ( poly_cache[i].spec ) {
+	    FREE(poly_cache[i].spec);
+	    GeogPreparedPolygonFree(&poly_cache[i].poly);
+	}
+    }
+    return rslt;
+}
+
+/*
+   Read subcommands with their arguments from standard input, one per line,
+   and run them in order. Output goes to standard output.
+ */
+
+int batch_cb(int argc, char *argv[])
+{
+    struct GeogIn in;			/* Standard input */
+    struct GeogIn data;			/* Empty input for subcommands */
+    struct GeogOut out;			/* Standard output */
+    const char *ln;			/* Input line */
+    size_t n;				/* Length of ln */
+    char *buf = NULL;			/* Copy of ln, split into words */
+    size_t buf_sz = 0;			/* Allocation at buf */
+    char **av = NULL;			/* Words from buf */
+    size_t av_sz = 0;			/* Allocation at av */
+    size_t ac;				/* Number of words */
+    char *w;
+    int n_fail = 0;			/* Number of requests that failed */
+    int rslt = 1;
+
+    if ( argc != 2 ) {
+	fprintf(stderr, "Usage: %s %s\n", argv0, argv1);
+	return 0;
+    }
+    if ( !GeogInInit(&in, STDIN_FILENO) ) {
+	fprintf(stderr, "%s %s: could not allocate input buffer.\n",
+		argv0, argv1);
+	return 0;
+    }
+    if ( !GeogOutInit(&out, STDOUT_FILENO) ) {
+	fprintf(stderr, "%s %s: could not allocate output buffer.\n",
+		argv0, argv1);
+	GeogInFree(&in);
+	return 0;
+    }
+    while ( rslt && GeogInLine(&in, &ln, &n) ) {
+	if ( n + 1 > buf_sz ) {
+	    char *t;
+
+	    if ( !(t = REALLOC(buf, 2 * n + 1)) ) {
+		fprintf(stderr, "%s %s: could not allocate line.\n",
+			argv0, argv1);
+		rslt = 0;
+		break;
+	    }
+	    buf = t;
+	    buf_sz = 2 * n + 1;
+	}
+	memcpy(buf, ln, n);
+	buf[n] = '\0';
+
+	/* Split line into words. Blank lines and comments produce nothing */
+	for (ac = 1, w = buf; ; ac++) {
+	    while ( isspace((unsigned char)*w) ) {
+		w++;
+	    }
+	    if ( !*w || *w == '#' ) {
+		break;
+	    }
+	    if ( ac + 2 > av_sz ) {
+		char **t;
+
+		if ( !(t = REALLOC(av, (2 * av_sz + 16) * sizeof(char *))) ) {
+		    fprintf(stderr, "%s %s: could not allocate words.\n",
+			    argv0, argv1);
+		    rslt = 0;
+		    break;
+		}
+		av = t;
+		av_sz = 2 * av_sz + 16;
+	    }
+	    av[ac] = w;
+	    while ( *w && !isspace((unsigned char)*w) ) {
+		w++;
+	    }
+	    if ( *w ) {
+		*w++ = '\0';
+	    }
+	}
+	if ( !rslt || ac == 1 ) {
+	    continue;
+	}
+	av[0] = argv0;
+	av[ac] = NULL;
+	GeogInInitMem(&data, "", 0);
+	if ( !run_req((int)ac, av, &data, &out, NULL) ) {
+	    GeogOutStr(&out, "****\n");
+	    n_fail++;
+	}
+	if ( out.err ) {
+	    fprintf(stderr, "%s %s: could not write output.\n", argv0, argv1);
+	    rslt = 0;
+	}
+    }
+    if ( !GeogOutFlush(&out) ) {
+	fprintf(stderr, "%s %s: could not write output.\n", argv0, argv1);
+	rslt = 0;
+    }
+    FREE(av);
+    FREE(buf);
+    GeogInFree(&in);
+    GeogOutFree(&out);
+    if ( n_fail > 0 ) {
+	fprintf(stderr, "%s %s: %d requests failed.\n", argv0, argv1, n_fail);
+	rslt = 0;
+    }
+    return rslt;
+}
+
+/*
+   Run one request for geog serve or geog batch. argv[1] names a
+   subcommand, which is run with argv, reading input from in and writing
+   output to out.
+ */
+
+static int run_req(int argc, char **argv, struct GeogIn *in,
+	struct GeogOut *out, void *arg)
+{
+    char *cmd = argv1;			/* serve or batch */
+    int i;
+    int rslt;
+
+    if ( argc < 2 ) {
+	return 0;
+    }
+    for (i = 0; i < NCMD && strcmp(argv1v[i], argv[1]) != 0; i++) {
+    }
+    if ( i == NCMD || cb1v[i] == serve_cb || cb1v[i] == batch_cb ) {
+	fprintf(stderr, "%s %s: cannot run subcommand %s\n",
+		argv0, cmd, argv[1]);
+	return 0;
+    }
+    argv1 = argv[1];
+    req_in = in;
+    req_out = out;
+    rslt = (cb1v[i])(argc, argv);
+    req_in = NULL;
+    req_out = NULL;
+    if ( !rslt ) {
+	fprintf(stderr, "%s %s failed.\n", argv0, argv1);
+    }
+    argv1 = cmd;
+    return rslt;
+}
+
+/*
+   Set *proj from specifier spec. While serving, reuse a projection set from
+   the same specifier for an earlier request. Return false if spec is
+   invalid.
+ */
+
+static int get_proj(char *spec, struct GeogProj *proj)
+{
+    struct proj_cache *pc, *lru;
+
+    if ( !serving ) {
+	return GeogProjSetFmStr(spec, proj);
+    }
+    for (pc = lru = proj_cache; pc < proj_cache + N_CACHE; pc++) {
+	if ( pc->spec && strcmp(pc->spec, spec) == 0 ) {
+	    pc->used = ++cache_clock;
+	    *proj = pc->proj;
+	    return 1;
+	}
+	if ( !pc->spec || (lru->spec && pc->used < lru->used) ) {
+	    lru = pc;
+	}
+    }
+    if ( !GeogProjSetFmStr(spec, proj) ) {
+	return 0;
+    }
+    FREE(lru->spec);
+    if ( (lru->spec = MALLOC(strlen(spec) + 1)) ) {
+	strcpy(lru->spec, spec);
+	lru->proj = *proj;
+	lru->used = ++cache_clock;
+    }
+    return 1;
+}
+
+/*
+   Return a new string with the words from a up to e separated by spaces,
+   or NULL if allocation fails.
+ */
+
+static char *join_args(char **a, char **e)
+{
+    char **w;
+    size_t len;
+    char *s, *p;
+
+    for (w = a, len = 1; w < e; w++) {
+	len += strlen(*w) + 1;
+    }
+    if ( !(s = MALLOC(len)) ) {
+	return NULL;
+    }
+    for (w = a, p = s; w < e; w++) {
+	strcpy(p, *w);
+	p += strlen(*w);
+	*p++ = ' ';
+    }
+    *p = '\0';
+    return s;
+}
+
+/* Return the cached polygon with vertices spec, or NULL */
+static struct poly_cache *find_poly(const char *spec)
+{
+    struct poly_cache *pc;
+
+    for (pc = poly_cache; pc < poly_cache + N_CACHE; pc++) {
+	if ( pc->spec && strcmp(pc->spec, spec) == 0 ) {
+	    pc->used = ++cache_clock;
+	    return pc;
+	}
+    }
+    return NULL;
+}
+
+/*
+   Add prepared polygon poly with vertices spec to the cache, replacing the
+   least recently used entry. The cache takes ownership of spec and poly.
+ */
+
+static void keep_poly(char *spec, struct GeogPreparedPolygon *poly)
+{
+    struct poly_cache *pc, *lru;
+
+    for (pc = lru = poly_cache; pc < poly_cache + N_CACHE; pc++) {
+	if ( !pc->spec || (lru->spec && pc->used < lru->used) ) {
+	    lru = pc;
+	}
+    }
+    if ( lru->spec ) {
+	FREE(lru->spec);
+	GeogPreparedPolygonFree(&lru->poly);
+    }
+    lru->spec = spec;
+    lru->poly = *poly;
+    lru->used = ++cache_clock;
 }
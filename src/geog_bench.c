@@ -0,0 +1,682 @@
+/*
+   -	geog_bench.c --
+   -		This file defines a program that times the geog library
+   -		functions and reports the results as JSON.
+   -
+   .	Copyright (c) 2014, Gordon D. Carrie. All rights reserved.
+   .
+   .	Redistribution and use in source and binary forms, with or without
+   .	modification, are permitted provided that the following conditions
+   .	are met:
+   .
+   .	    * Redistributions of source code must retain the above copyright
+   .	    notice, this list of conditions and the following disclaimer.
+   .
+   .	    * Redistributions in binary form must reproduce the above copyright
+   .	    notice, this list of conditions and the following disclaimer in the
+   .	    documentation and/or other materials provided with the distribution.
+   .
+   .	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   .	"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   .	LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   .	A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+   .	HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+   .	SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+   .	TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   .	PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   .	LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   .	NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   .	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+   .
+   .	Please send feedback to dev0@trekix.net
+   .
+   .	$Revision: $ $Date: $
+ */
+
+#include "unix_defs.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <math.h>
+#include "geog_lib.h"
+#include "geog_proj.h"
+#include "geog_proj_inline.h"
+
+/*
+   Usage: geog_bench [-n points] [-r repetitions] [-s seed]
+
+   Each benchmark applies a function to an array of inputs made by a
+   pseudorandom generator with a fixed seed, so runs on the same machine are
+   comparable. The array is processed once to warm caches, then timed
+   repetitions times. Output is a JSON object with the parameters of the run
+   and, for each benchmark, the mean, minimum, and variance of the time per
+   call in nanoseconds, and the mean number of points processed per second.
+
+   Each projection is timed three ways: one point per call through
+   GeogProjLonLatToXY or GeogProjXYToLonLat ("fwd", "inv"), whole arrays
+   through GeogProjLonLatToXYN or GeogProjXYToLonLatN ("fwd_n", "inv_n"), and
+   the kernels from geog_proj_inline.h called from a loop here, with the
+   projection type chosen once per array ("fwd_inline", "inv_inline").
+
+   The "accuracy" list gives the largest difference between GeogDistN,
+   GeogAzN, and GeogStepN, which may use vector approximations, and the
+   scalar functions, which use libm. It is measured on the benchmark inputs
+   and on the same starting points with segments 1e-6 times as long. For
+   GeogDistN it is the distance error, for GeogAzN the azimuth error times
+   the sine of the distance, which is the displacement it causes at the
+   far point, and for GeogStepN the distance between the two results. Each
+   is given in radians and in meters on a sphere with radius GeogREarth.
+ */
+
+/* Defaults */
+#define N_PTS 65536
+#define N_REP 10
+#define SEED 20140101
+
+/* Polygon sizes for GeogContainPt */
+static size_t poly_sz[] = {4, 16, 64, 256, 1024, 4096};
+#define N_POLY (sizeof(poly_sz) / sizeof(poly_sz[0]))
+
+/* Projections, as given to GeogProjSetFmStr. One for each ProjType. */
+static char *proj_str[] = {
+    "CylEqDist -97.0 38.0",
+    "CylEqArea -97.0",
+    "Mercator -97.0",
+    "LambertConfConic -97.0 38.0 33.0 45.0",
+    "LambertEqArea -97.0 38.0",
+    "Orthographic -97.0 38.0",
+    "Stereographic -97.0 38.0"
+};
+#define N_PROJ (sizeof(proj_str) / sizeof(proj_str[0]))
+
+/* Inputs for benchmarks. Longitudes and latitudes are in radians. */
+struct inputs {
+    size_t n;				/* Number of inputs */
+    double *lon1, *lat1;		/* Points anywhere on the globe */
+    double *lon2, *lat2;
+    double *dist, *az;			/* Step lengths and directions */
+    double *lon_r, *lat_r;		/* Points in a region around the
+					   projection origins */
+    double *x, *y;			/* Map coordinates of lon_r, lat_r */
+    double *u, *v;			/* Results of batch conversions */
+    unsigned char *ok;			/* Flags from batch conversions */
+    const struct GeogPt *poly;		/* Polygon for GeogContainPt */
+    size_t n_poly;			/* Number of points at poly */
+    size_t n_test;			/* Number of points to test with
+					   GeogContainPt */
+    struct GeogProj *proj;		/* Projection */
+};
+
+/* Function to time. It processes in->n inputs and returns a value that
+   depends on every result, so that the calls cannot be optimized away. */
+typedef double (kernel)(const struct inputs *);
+
+static uint64_t rand_st;		/* Generator state */
+static volatile double sink;		/* Receives kernel results */
+
+static double rand_u(void);
+static double now(void);
+static void bench(const char *, kernel *, const struct inputs *, size_t,
+	int);
+static kernel dist_k;
+static kernel az_k;
+static kernel step_k;
+static kernel lonr_k;
+static kernel dist_n_k;
+static kernel az_n_k;
+static kernel step_n_k;
+static void accuracy(const struct inputs *);
+static kernel contain_k;
+static kernel fwd_k;
+static kernel inv_k;
+static kernel fwd_n_k;
+static kernel inv_n_k;
+static kernel fwd_inline_k;
+static kernel inv_inline_k;
+
+int main(int argc, char *argv[])
+{
+    char *argv0 = argv[0];
+    size_t n = N_PTS;			/* Number of inputs */
+    int n_rep = N_REP;			/* Number of timed repetitions */
+    unsigned long seed = SEED;
+    struct inputs in;
+    struct GeogPt *poly;		/* Polygon vertices */
+    struct GeogProj proj;
+    double lon_c = -97.0 * RAD_DEG, lat_c = 38.0 * RAD_DEG;
+    char name[128];
+    size_t i, p;
+
+    for (i = 1; i < (size_t)argc; i++) {
+	if ( i + 1 < (size_t)argc && strcmp(argv[i], "-n") == 0 ) {
+	    n = strtoul(argv[++i], NULL, 10);
+	} else if ( i + 1 < (size_t)argc && strcmp(argv[i], "-r") == 0 ) {
+	    n_rep = atoi(argv[++i]);
+	} else if ( i + 1 < (size_t)argc && strcmp(argv[i], "-s") == 0 ) {
+	    seed = strtoul(argv[++i], NULL, 10);
+	} else {
+	    n = 0;
+	    break;
+	}
+    }
+    if ( n == 0 || n_rep < 2 ) {
+	fprintf(stderr, "Usage: %s [-n points] [-r repetitions] [-s seed]\n"
+		"points must be positive, repetitions at least 2.\n", argv0);
+	return EXIT_FAILURE;
+    }
+    rand_st = seed ? seed : SEED;
+
+    /*
+       Make inputs. Points on the globe are uniform in area.
+     */
+
+    in.n = n;
+    in.lon1 = malloc(n * sizeof(double));
+    in.lat1 = malloc(n * sizeof(double));
+    in.lon2 = malloc(n * sizeof(double));
+    in.lat2 = malloc(n * sizeof(double));
+    in.dist = malloc(n * sizeof(double));
+    in.az = malloc(n * sizeof(double));
+    in.lon_r = malloc(n * sizeof(double));
+    in.lat_r = malloc(n * sizeof(double));
+    in.x = malloc(n * sizeof(double));
+    in.y = malloc(n * sizeof(double));
+    in.u = malloc(n * sizeof(double));
+    in.v = malloc(n * sizeof(double));
+    in.ok = malloc(n);
+    poly = malloc(poly_sz[N_POLY - 1] * sizeof(struct GeogPt));
+    if ( !in.lon1 || !in.lat1 || !in.lon2 || !in.lat2 || !in.dist || !in.az
+	    || !in.lon_r || !in.lat_r || !in.x || !in.y || !in.u || !in.v
+	    || !in.ok || !poly ) {
+	fprintf(stderr, "%s: could not allocate inputs.\n", argv0);
+	return EXIT_FAILURE;
+    }
+    for (i = 0; i < n; i++) {
+	in.lon1[i] = M_PI * (2.0 * rand_u() - 1.0);
+	in.lat1[i] = asin(2.0 * rand_u() - 1.0);
+	in.lon2[i] = M_PI * (2.0 * rand_u() - 1.0);
+	in.lat2[i] = asin(2.0 * rand_u() - 1.0);
+	in.dist[i] = M_PI_4 * rand_u();
+	in.az[i] = M_PI * (2.0 * rand_u() - 1.0);
+	in.lon_r[i] = lon_c + 30.0 * RAD_DEG * (2.0 * rand_u() - 1.0);
+	in.lat_r[i] = lat_c + 20.0 * RAD_DEG * (2.0 * rand_u() - 1.0);
+    }
+
+    printf("{\n  \"points\": %lu,\n  \"repetitions\": %d,\n"
+	    "  \"seed\": %lu,\n  \"results\": [", (unsigned long)n, n_rep,
+	    (unsigned long)(seed ? seed : SEED));
+    bench("GeogDist", dist_k, &in, n, n_rep);
+    bench("GeogAz", az_k, &in, n, n_rep);
+    bench("GeogStep", step_k, &in, n, n_rep);
+    bench("GeogDistN", dist_n_k, &in, n, n_rep);
+    bench("GeogAzN", az_n_k, &in, n, n_rep);
+    bench("GeogStepN", step_n_k, &in, n, n_rep);
+
+    /* GeogLonR gets longitudes over several turns */
+    for (i = 0; i < n; i++) {
+	in.lon2[i] *= 4.0;
+    }
+    bench("GeogLonR", lonr_k, &in, n, n_rep);
+    for (i = 0; i < n; i++) {
+	in.lon2[i] /= 4.0;
+    }
+
+    /*
+       Polygons are irregular rings about 10 degrees across, around
+       lon_c, lat_c. Test points are in a box that surrounds them. Large
+       polygons test fewer points, so that each benchmark takes about as
+       long as for a 64 sided polygon.
+     */
+
+    for (p = 0; p < N_POLY; p++) {
+	size_t n_poly = poly_sz[p];
+
+	for (i = 0; i < n_poly; i++) {
+	    double a = 2.0 * M_PI * i / n_poly;
+	    double r = 10.0 * RAD_DEG * (0.7 + 0.6 * rand_u());
+
+	    poly[i].lon = lon_c + r * cos(a) / cos(lat_c);
+	    poly[i].lat = lat_c + r * sin(a);
+	}
+	in.poly = poly;
+	in.n_poly = n_poly;
+	in.n_test = (n_poly > 64) ? n * 64 / n_poly : n;
+	in.n_test = (in.n_test < 1) ? 1 : in.n_test;
+	snprintf(name, sizeof(name), "GeogContainPt/%lu",
+		(unsigned long)n_poly);
+	bench(name, contain_k, &in, in.n_test, n_rep);
+    }
+
+    /*
+       Each projection converts points in a region around its origin.
+       Inverse conversions start from the forward results. The projections
+       are not rotated, so the inline loops omit GeogProjRotFwd and
+       GeogProjRotInv, as GeogProjLonLatToXYN and GeogProjXYToLonLatN do.
+     */
+
+    for (p = 0; p < N_PROJ; p++) {
+	char *t;
+
+	if ( !GeogProjSetFmStr(proj_str[p], &proj) ) {
+	    fprintf(stderr, "%s: could not set projection %s\n", argv0,
+		    proj_str[p]);
+	    return EXIT_FAILURE;
+	}
+	in.proj = &proj;
+	for (i = 0; i < n; i++) {
+	    GeogProjLonLatToXY(in.lon_r[i], in.lat_r[i], in.x + i, in.y + i,
+		    &proj);
+	}
+	snprintf(name, sizeof(name), "%s", proj_str[p]);
+	if ( (t = strchr(name, ' ')) ) {
+	    *t = '\0';
+	}
+	strcat(name, "/fwd");
+	bench(name, fwd_k, &in, n, n_rep);
+	strcat(name, "_n");
+	bench(name, fwd_n_k, &in, n, n_rep);
+	*strrchr(name, '/') = '\0';
+	strcat(name, "/fwd_inline");
+	bench(name, fwd_inline_k, &in, n, n_rep);
+	*strrchr(name, '/') = '\0';
+	strcat(name, "/inv");
+	bench(name, inv_k, &in, n, n_rep);
+	strcat(name, "_n");
+	bench(name, inv_n_k, &in, n, n_rep);
+	*strrchr(name, '/') = '\0';
+	strcat(name, "/inv_inline");
+	bench(name, inv_inline_k, &in, n, n_rep);
+    }
+    printf("\n  ],\n");
+    accuracy(&in);
+    printf("}\n");
+
+    free(in.lon1);
+    free(in.lat1);
+    free(in.lon2);
+    free(in.lat2);
+    free(in.dist);
+    free(in.az);
+    free(in.lon_r);
+    free(in.lat_r);
+    free(in.x);
+    free(in.y);
+    free(in.u);
+    free(in.v);
+    free(in.ok);
+    free(poly);
+    return EXIT_SUCCESS;
+}
+
+/*
+   Run kernel fn, which makes n_call calls to the function being timed, on
+   in once untimed, then n_rep times timed. Print the results as a JSON
+   object.
+ */
+
+static void bench(const char *name, kernel *fn, const struct inputs *in,
+	size_t n_call, int n_rep)
+{
+    static int n_bench;			/* Number of results printed */
+    double ns;				/* Time per call, one repetition */
+    double sum = 0.0, sum2 = 0.0;	/* Sums of ns and ns squared */
+    double min = HUGE_VAL;
+    double mean, var;
+    int r;
+
+    sink = fn(in);
+    for (r = 0; r < n_rep; r++) {
+	double t0 = now();
+
+	sink = fn(in);
+	ns = (now() - t0) * 1.0e9 / n_call;
+	sum += ns;
+	sum2 += ns * ns;
+	min = (ns < min) ? ns : min;
+    }
+    mean = sum / n_rep;
+    var = (sum2 - sum * mean) / (n_rep - 1);
+    var = (var < 0.0) ? 0.0 : var;
+    printf("%s\n    {\"name\": \"%s\", \"calls\": %lu, \"ns_per_op\": %.3f, "
+	    "\"ns_per_op_min\": %.3f, \"ns_per_op_var\": %.3f, "
+	    "\"points_per_s\": %.0f}", n_bench++ ? "," : "", name,
+	    (unsigned long)n_call, mean, min, var, 1.0e9 / mean);
+    fflush(stdout);
+}
+
+static double dist_k(const struct inputs *in)
+{
+    double s = 0.0;
+    size_t i;
+
+    for (i = 0; i < in->n; i++) {
+	s += GeogDist(in->lon1[i], in->lat1[i], in->lon2[i], in->lat2[i]);
+    }
+    return s;
+}
+
+static double az_k(const struct inputs *in)
+{
+    double s = 0.0;
+    size_t i;
+
+    for (i = 0; i < in->n; i++) {
+	s += GeogAz(in->lon1[i], in->lat1[i], in->lon2[i], in->lat2[i]);
+    }
+    return s;
+}
+
+static double step_k(const struct inputs *in)
+{
+    double s = 0.0, lon, lat;
+    size_t i;
+
+    for (i = 0; i < in->n; i++) {
+	GeogStep(in->lon1[i], in->lat1[i], in->az[i], in->dist[i], &lon, &lat);
+	s += lon + lat;
+    }
+    return s;
+}
+
+static double lonr_k(const struct inputs *in)
+{
+    double s = 0.0;
+    size_t i;
+
+    for (i = 0; i < in->n; i++) {
+	s += GeogLonR(in->lon2[i], in->lon1[i]);
+    }
+    return s;
+}
+
+static double dist_n_k(const struct inputs *in)
+{
+    double s = 0.0;
+    size_t i;
+
+    GeogDistN(in->lon1, in->lat1, in->lon2, in->lat2, in->u, in->n);
+    for (i = 0; i < in->n; i++) {
+	s += in->u[i];
+    }
+    return s;
+}
+
+static double az_n_k(const struct inputs *in)
+{
+    double s = 0.0;
+    size_t i;
+
+    GeogAzN(in->lon1, in->lat1, in->lon2, in->lat2, in->u, in->n);
+    for (i = 0; i < in->n; i++) {
+	s += in->u[i];
+    }
+    return s;
+}
+
+static double step_n_k(const struct inputs *in)
+{
+    double s = 0.0;
+    size_t i;
+
+    GeogStepN(in->lon1, in->lat1, in->az, in->dist, in->u, in->v, in->n);
+    for (i = 0; i < in->n; i++) {
+	s += in->u[i] + in->v[i];
+    }
+    return s;
+}
+
+static double contain_k(const struct inputs *in)
+{
+    double s = 0.0;
+    size_t i;
+
+    for (i = 0; i < in->n_test; i++) {
+	struct GeogPt pt;
+
+	pt.lon = in->lon_r[i];
+	pt.lat = in->lat_r[i];
+	s += GeogContainPt(pt, in->poly, in->n_poly);
+    }
+    return s;
+}
+
+static double fwd_k(const struct inputs *in)
+{
+    double s = 0.0, x, y;
+    size_t i;
+
+    for (i = 0; i < in->n; i++) {
+	if ( GeogProjLonLatToXY(in->lon_r[i], in->lat_r[i], &x, &y,
+		    in->proj) ) {
+	    s += x + y;
+	}
+    }
+    return s;
+}
+
+static double inv_k(const struct inputs *in)
+{
+    double s = 0.0, lon, lat;
+    size_t i;
+
+    for (i = 0; i < in->n; i++) {
+	if ( GeogProjXYToLonLat(in->x[i], in->y[i], &lon, &lat,
+		    in->proj) ) {
+	    s += lon + lat;
+	}
+    }
+    return s;
+}
+
+/*
+   Sum the batch results at in->u, in->v for which in->ok is set. Batch and
+   inline kernels return this, so that their results can be compared.
+ */
+
+static double sum_ok(const struct inputs *in)
+{
+    double s = 0.0;
+    size_t i;
+
+    for (i = 0; i < in->n; i++) {
+	if ( in->ok[i] ) {
+	    s += in->u[i] + in->v[i];
+	}
+    }
+    return s;
+}
+
+static double fwd_n_k(const struct inputs *in)
+{
+    GeogProjLonLatToXYN(in->lon_r, in->lat_r, in->u, in->v, in->ok, in->n,
+	    in->proj);
+    return sum_ok(in);
+}
+
+static double inv_n_k(const struct inputs *in)
+{
+    GeogProjXYToLonLatN(in->x, in->y, in->u, in->v, in->ok, in->n, in->proj);
+    return sum_ok(in);
+}
+
+static double fwd_inline_k(const struct inputs *in)
+{
+    const struct GeogProj *proj = in->proj;
+    const double *lon = in->lon_r, *lat = in->lat_r;
+    double *x = in->u, *y = in->v;
+    unsigned char *ok = in->ok;
+    size_t i, n = in->n;
+
+    switch (proj->type) {
+	case CylEqDist:
+	    for (i = 0; i < n; i++) {
+		ok[i] = GeogProjCylEqDistFwd(proj, lon[i], lat[i], x + i, y + i);
+	    }
+	    break;
+	case CylEqArea:
+	    for (i = 0; i < n; i++) {
+		ok[i] = GeogProjCylEqAreaFwd(proj, lon[i], lat[i], x + i, y + i);
+	    }
+	    break;
+	case Mercator:
+	    for (i = 0; i < n; i++) {
+		ok[i] = GeogProjMercatorFwd(proj, lon[i], lat[i], x + i, y + i);
+	    }
+	    break;
+	case LambertConfConic:
+	    for (i = 0; i < n; i++) {
+		ok[i] = GeogProjLambertConfConicFwd(proj, lon[i], lat[i],
+			x + i, y + i);
+	    }
+	    break;
+	case LambertEqArea:
+	    for (i = 0; i < n; i++) {
+		ok[i] = GeogProjLambertEqAreaFwd(proj, lon[i], lat[i],
+			x + i, y + i);
+	    }
+	    break;
+	case Orthographic:
+	    for (i = 0; i < n; i++) {
+		ok[i] = GeogProjOrthographicFwd(proj, lon[i], lat[i],
+			x + i, y + i);
+	    }
+	    break;
+	case Stereographic:
+	    for (i = 0; i < n; i++) {
+		ok[i] = GeogProjStereographicFwd(proj, lon[i], lat[i],
+			x + i, y + i);
+	    }
+	    break;
+    }
+    return sum_ok(in);
+}
+
+static double inv_inline_k(const struct inputs *in)
+{
+    const struct GeogProj *proj = in->proj;
+    const double *x = in->x, *y = in->y;
+    double *lon = in->u, *lat = in->v;
+    unsigned char *ok = in->ok;
+    size_t i, n = in->n;
+
+    switch (proj->type) {
+	case CylEqDist:
+	    for (i = 0; i < n; i++) {
+		ok[i] = GeogProjCylEqDistInv(proj, x[i], y[i], lon + i, lat + i);
+	    }
+	    break;
+	case CylEqArea:
+	    for (i = 0; i < n; i++) {
+		ok[i] = GeogProjCylEqAreaInv(proj, x[i], y[i], lon + i, lat + i);
+	    }
+	    break;
+	case Mercator:
+	    for (i = 0; i < n; i++) {
+		ok[i] = GeogProjMercatorInv(proj, x[i], y[i], lon + i, lat + i);
+	    }
+	    break;
+	case LambertConfConic:
+	    for (i = 0; i < n; i++) {
+		ok[i] = GeogProjLambertConfConicInv(proj, x[i], y[i],
+			lon + i, lat + i);
+	    }
+	    break;
+	case LambertEqArea:
+	    for (i = 0; i < n; i++) {
+		ok[i] = GeogProjLambertEqAreaInv(proj, x[i], y[i],
+			lon + i, lat + i);
+	    }
+	    break;
+	case Orthographic:
+	    for (i = 0; i < n; i++) {
+		ok[i] = GeogProjOrthographicInv(proj, x[i], y[i],
+			lon + i, lat + i);
+	    }
+	    break;
+	case Stereographic:
+	    for (i = 0; i < n; i++) {
+		ok[i] = GeogProjStereographicInv(proj, x[i], y[i],
+			lon + i, lat + i);
+	    }
+	    break;
+    }
+    return sum_ok(in);
+}
+
+/*
+   Print the largest differences between the array functions GeogDistN,
+   GeogAzN, and GeogStepN and the scalar functions for the inputs at in, as
+   a JSON list. Overwrites in->x, in->y, in->u, and in->v.
+ */
+
+static void accuracy(const struct inputs *in)
+{
+    double e_dist = 0.0, e_az = 0.0, e_step = 0.0;
+    double r_earth = GeogREarth(NULL);
+    double *lon2 = in->x, *lat2 = in->y;
+    double *dist = in->v;
+    size_t i;
+    int pass;
+
+    for (pass = 0; pass < 2; pass++) {
+	double f = pass ? 1.0e-6 : 1.0;	/* Fraction of segment length */
+
+	for (i = 0; i < in->n; i++) {
+	    lon2[i] = in->lon1[i] + f * (in->lon2[i] - in->lon1[i]);
+	    lat2[i] = in->lat1[i] + f * (in->lat2[i] - in->lat1[i]);
+	}
+	GeogDistN(in->lon1, in->lat1, lon2, lat2, dist, in->n);
+	GeogAzN(in->lon1, in->lat1, lon2, lat2, in->u, in->n);
+	for (i = 0; i < in->n; i++) {
+	    double d = GeogDist(in->lon1[i], in->lat1[i], lon2[i], lat2[i]);
+	    double az = GeogAz(in->lon1[i], in->lat1[i], lon2[i], lat2[i]);
+	    double e;
+
+	    e = fabs(dist[i] - d);
+	    e_dist = (e > e_dist) ? e : e_dist;
+	    e = fabs(GeogLonDiff(in->u[i], az)) * sin(d);
+	    e_az = (e > e_az) ? e : e_az;
+	}
+	for (i = 0; i < in->n; i++) {
+	    dist[i] = f * in->dist[i];
+	}
+	GeogStepN(in->lon1, in->lat1, in->az, dist, in->u, lat2, in->n);
+	for (i = 0; i < in->n; i++) {
+	    double lon, lat, e;
+
+	    GeogStep(in->lon1[i], in->lat1[i], in->az[i], dist[i], &lon, &lat);
+	    e = GeogDist(lon, lat, in->u[i], lat2[i]);
+	    e_step = (e > e_step) ? e : e_step;
+	}
+    }
+    printf("  \"accuracy\": [\n"
+	    "    {\"name\": \"GeogDistN\", \"max_err\": %.3g, "
+	    "\"max_err_m\": %.3g},\n"
+	    "    {\"name\": \"GeogAzN\", \"max_err\": %.3g, "
+	    "\"max_err_m\": %.3g},\n"
+	    "    {\"name\": \"GeogStepN\", \"max_err\": %.3g, "
+	    "\"max_err_m\": %.3g}\n  ]\n",
+	    e_dist, e_dist * r_earth, e_az, e_az * r_earth,
+	    e_step, e_step * r_earth);
+}
+
+/* Return a uniform pseudorandom value in [0, 1) (xorshift64*) */
+static double rand_u(void)
+{
+    rand_st ^= rand_st >> 12;
+    rand_st ^= rand_st << 25;
+    rand_st ^= rand_st >> 27;
+    return (double)((rand_st * UINT64_C(2685821657736338717)) >> 11)
+	/ 9007199254740992.0;
+}
+
+/* Return monotonic clock time in seconds */
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + 1.0e-9 * ts.tv_nsec;
+}
@@ -0,0 +1,270 @@
+/*
+   -	geog_gen.c --
+   -		This file defines a program that makes synthetic inputs for
+   -		geog and measures the time and memory used by a geog run.
+   -
+   .	Copyright (c) 2014, Gordon D. Carrie. All rights reserved.
+   .
+   .	Redistribution and use in source and binary forms, with or without
+   .	modification, are permitted provided that the following conditions
+   .	are met:
+   .
+   .	    * Redistributions of source code must retain the above copyright
+   .	    notice, this list of conditions and the following disclaimer.
+   .
+   .	    * Redistributions in binary form must reproduce the above copyright
+   .	    notice, this list of conditions and the following disclaimer in the
+   .	    documentation and/or other materials provided with the distribution.
+   .
+   .	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   .	"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   .	LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   .	A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+   .	HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+   .	SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+   .	TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   .	PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   .	LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   .	NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   .	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+   .
+   .	Please send feedback to dev0@trekix.net
+   .
+   .	$Revision: $ $Date: $
+ */
+
+#include "unix_defs.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <math.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+
+/*
+   Usage:
+	geog_gen points n [seed]
+	geog_gen heights n [seed]
+	geog_gen steps n [seed]
+	geog_gen track n [seed]
+	geog_gen polygon polar|antimeridian n [seed]
+	geog_gen run input command [argument ...]
+
+   points prints n points uniform over the globe, as "lon lat" lines.
+   heights adds a height in meters to each point. steps prints "lon lat
+   dir dist" lines for geog step. track prints a random walk of n points
+   that crosses the antimeridian. polygon prints the n vertices of an
+   irregular ring around the north pole, or centered on the antimeridian.
+   Output is in degrees. The same arguments always give the same output.
+
+   run executes command with input as standard input and standard output
+   discarded. When it finishes, run prints the size of input in bytes, the
+   wall time in seconds, the input rate in megabytes per second, and the
+   peak resident set size of command in kilobytes. It exits with the
+   status of command.
+ */
+
+#define SEED 20140101
+
+static uint64_t rand_st;		/* Generator state */
+
+static double rand_u(void);
+static double rand_lat(void);
+static double now(void);
+static int run(int, char *[]);
+
+int main(int argc, char *argv[])
+{
+    char *argv0 = argv[0];
+    char *mode, *type = NULL;
+    unsigned long n, i;
+    int a = 2;				/* Index of n in argv */
+
+    if ( argc > 3 && strcmp(argv[1], "run") == 0 ) {
+	return run(argc - 2, argv + 2);
+    }
+    if ( argc < 3 ) {
+	goto usage;
+    }
+    mode = argv[1];
+    if ( strcmp(mode, "polygon") == 0 ) {
+	type = argv[a++];
+	if ( strcmp(type, "polar") != 0
+		&& strcmp(type, "antimeridian") != 0 ) {
+	    goto usage;
+	}
+    }
+    if ( a >= argc || sscanf(argv[a], "%lu", &n) != 1 ) {
+	goto usage;
+    }
+    rand_st = (a + 1 < argc) ? strtoul(argv[a + 1], NULL, 10) : SEED;
+    rand_st = rand_st ? rand_st : SEED;
+
+    if ( strcmp(mode, "points") == 0 ) {
+	for (i = 0; i < n; i++) {
+	    double lon = 360.0 * rand_u() - 180.0;
+
+	    printf("%.6f %.6f\n", lon, rand_lat());
+	}
+    } else if ( strcmp(mode, "heights") == 0 ) {
+	for (i = 0; i < n; i++) {
+	    double lon = 360.0 * rand_u() - 180.0;
+	    double lat = rand_lat();
+
+	    printf("%.6f %.6f %.1f\n", lon, lat, 15000.0 * rand_u());
+	}
+    } else if ( strcmp(mode, "steps") == 0 ) {
+	for (i = 0; i < n; i++) {
+	    double lon = 360.0 * rand_u() - 180.0;
+	    double lat = rand_lat();
+	    double dir = 360.0 * rand_u() - 180.0;
+
+	    printf("%.6f %.6f %.6f %.6f\n", lon, lat, dir, 45.0 * rand_u());
+	}
+    } else if ( strcmp(mode, "track") == 0 ) {
+
+	/*
+	   Heading wanders slowly. Steps are about 0.05 degrees. Latitude
+	   reflects at 85 degrees, longitude wraps at the antimeridian.
+	 */
+
+	double lon = 170.0, lat = 30.0 * rand_u(), hdg = 90.0;
+
+	for (i = 0; i < n; i++) {
+	    double d = 0.05 * (0.5 + rand_u());
+
+	    printf("%.6f %.6f\n", lon, lat);
+	    hdg += 10.0 * (rand_u() - 0.5);
+	    lat += d * cos(hdg * M_PI / 180.0);
+	    lon += d * sin(hdg * M_PI / 180.0) / cos(lat * M_PI / 180.0);
+	    if ( lat > 85.0 || lat < -85.0 ) {
+		lat = (lat > 0.0) ? 170.0 - lat : -170.0 - lat;
+		hdg = 180.0 - hdg;
+	    }
+	    lon = (lon >= 180.0) ? lon - 360.0 : (lon < -180.0) ? lon + 360.0
+		: lon;
+	}
+    } else if ( strcmp(mode, "polygon") == 0 && n >= 3 ) {
+	for (i = 0; i < n; i++) {
+	    double az = 360.0 * i / n;
+
+	    if ( strcmp(type, "polar") == 0 ) {
+		double lon = az - 180.0;
+
+		printf("%.6f %.6f\n", lon, 70.0 + 10.0 * rand_u());
+	    } else {
+		double r = 15.0 + 10.0 * rand_u();
+		double lon = 180.0 + r * cos(az * M_PI / 180.0);
+		double lat = r * sin(az * M_PI / 180.0);
+
+		lon = (lon >= 180.0) ? lon - 360.0 : lon;
+		printf("%.6f %.6f\n", lon, lat);
+	    }
+	}
+    } else {
+	goto usage;
+    }
+    if ( fflush(stdout) != 0 ) {
+	perror(argv0);
+	return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+
+usage:
+    fprintf(stderr, "Usage:\n"
+	    "  %s points|heights|steps|track n [seed]\n"
+	    "  %s polygon polar|antimeridian n [seed]\n"
+	    "  %s run input command [argument ...]\n", argv0, argv0, argv0);
+    return EXIT_FAILURE;
+}
+
+/*
+   Run the command in argv[1] ... with input from file argv[0] and output
+   discarded. Print input size, wall time, input rate, and peak resident
+   set size. Return the exit status of the command, or EXIT_FAILURE if it
+   could not be run.
+ */
+
+static int run(int argc, char *argv[])
+{
+    struct stat sb;
+    struct rusage ru;
+    double t0, t;
+    pid_t pid;
+    int in_fd, null_fd, status;
+
+    if ( argc < 2 ) {
+	return EXIT_FAILURE;
+    }
+    if ( (in_fd = open(argv[0], O_RDONLY)) == -1
+	    || fstat(in_fd, &sb) == -1 ) {
+	perror(argv[0]);
+	return EXIT_FAILURE;
+    }
+    if ( (null_fd = open("/dev/null", O_WRONLY)) == -1 ) {
+	perror("/dev/null");
+	return EXIT_FAILURE;
+    }
+    t0 = now();
+    switch (pid = fork()) {
+	case -1:
+	    perror("fork");
+	    return EXIT_FAILURE;
+	case 0:
+	    if ( dup2(in_fd, STDIN_FILENO) == -1
+		    || dup2(null_fd, STDOUT_FILENO) == -1 ) {
+		perror("dup2");
+		_exit(127);
+	    }
+	    close(in_fd);
+	    close(null_fd);
+	    execvp(argv[1], argv + 1);
+	    perror(argv[1]);
+	    _exit(127);
+    }
+    close(in_fd);
+    close(null_fd);
+    if ( waitpid(pid, &status, 0) == -1 ) {
+	perror("waitpid");
+	return EXIT_FAILURE;
+    }
+    t = now() - t0;
+
+    /* The command is this process's only child, so this is its usage */
+    if ( getrusage(RUSAGE_CHILDREN, &ru) == -1 ) {
+	perror("getrusage");
+	return EXIT_FAILURE;
+    }
+    printf("%lu %.3f %.2f %ld\n", (unsigned long)sb.st_size, t,
+	    sb.st_size / 1.0e6 / t, (long)ru.ru_maxrss);
+    return WIFEXITED(status) ? WEXITSTATUS(status) : EXIT_FAILURE;
+}
+
+/* Return a uniform pseudorandom value in [0, 1) (xorshift64*) */
+static double rand_u(void)
+{
+    rand_st ^= rand_st >> 12;
+    rand_st ^= rand_st << 25;
+    rand_st ^= rand_st >> 27;
+    return (double)((rand_st * UINT64_C(2685821657736338717)) >> 11)
+	/ 9007199254740992.0;
+}
+
+/* Return a latitude in degrees for a point uniform in area */
+static double rand_lat(void)
+{
+    return asin(2.0 * rand_u() - 1.0) * 180.0 / M_PI;
+}
+
+/* Return monotonic clock time in seconds */
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + 1.0e-9 * ts.tv_nsec;
+}
@@ -0,0 +1,799 @@
+/*
+   -	geog_index.c --
+   -		This file defines spatial indexes for the geog
+   -		application.  See geog_index (3).
+   -
+   .	Copyright (c) 2014, Gordon D. Carrie. All rights reserved.
+   .
+   .	Redistribution and use in source and binary forms, with or without
+   .	modification, are permitted provided that the following conditions
+   .	are met:
+   .
+   .	    * Redistributions of source code must retain the above copyright
+   .	    notice, this list of conditions and the following disclaimer.
+   .
+   .	    * Redistributions in binary form must reproduce the above copyright
+   .	    notice, this list of conditions and the following disclaimer in the
+   .	    documentation and/or other materials provided with the distribution.
+   .
+   .	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   .	"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   .	LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   .	A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+   .	HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+   .	SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+   .	TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   .	PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   .	LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   .	NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   .	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+   .
+   .	Please send feedback to dev0@trekix.net
+   .
+   .	$Revision: $ $Date: $
+ */
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "alloc.h"
+#include "geog_lib.h"
+#include "geog_index.h"
+
+/*
+   Margin, in radians, added to polygon bounding boxes to cover rounding in
+   GeogContainPt.
+ */
+
+#define BOX_MARGIN 1.0e-9
+
+/* Maximum number of children of an R-tree node */
+#define RT_FAN 16
+
+/* Size of stack for R-tree traversal. Enough for RT_FAN children at each
+   level of a tree over any number of items that fits in a size_t. */
+#define RT_STK (RT_FAN * 8 * sizeof(size_t))
+
+static int cmp_x(const void *, const void *);
+static int cmp_y(const void *, const void *);
+static int in_box(const struct GeogBox *, double, double);
+
+/*
+   Compute bounding boxes for the polygon with n_pts points at pts, such
+   that GeogContainPt returns false for any point outside the boxes. Put
+   the boxes at box, which must have space for two boxes. Return the number
+   of boxes, 2 if the polygon crosses the antimeridian, or 0 if n_pts is 0.
+   Polygons that encircle a pole, or have an edge that GeogContainPt could
+   take either way around the globe, get a box that covers the whole globe.
+ */
+
+int GeogPolygonBox(const struct GeogPt *pts, size_t n_pts, struct GeogBox *box)
+{
+    const struct GeogPt *p0, *p1;
+    double lon0;			/* Longitude of pts[0] in [-M_PI, M_PI) */
+    double c, c_min, c_max;		/* Longitude change from lon0 */
+    double s, n;			/* Latitude limits */
+    double d;
+    int full;				/* If true, polygon needs full globe */
+    size_t i;
+
+    if ( n_pts == 0 ) {
+	return 0;
+    }
+    lon0 = GeogLonR(pts[0].lon, 0.0);
+    c = c_min = c_max = 0.0;
+    s = n = pts[0].lat;
+    full = isnan(lon0) || isnan(s);
+    for (i = 1; i <= n_pts && !full; i++) {
+	p0 = pts + i - 1;
+	p1 = pts + i % n_pts;
+	d = GeogLonDiff(p1->lon, p0->lon);
+	if ( !(fabs(d) < M_PI - 1.0e-6) || isnan(p1->lat) ) {
+	    full = 1;
+	}
+	c += d;
+	c_min = (c < c_min) ? c : c_min;
+	c_max = (c > c_max) ? c : c_max;
+	s = (p1->lat < s) ? p1->lat : s;
+	n = (p1->lat > n) ? p1->lat : n;
+    }
+    if ( full || fabs(c) > M_PI || c_max - c_min >= 2.0 * M_PI ) {
+	box[0].w = -M_PI;
+	box[0].e = M_PI;
+	box[0].s = -M_PI_2;
+	box[0].n = M_PI_2;
+	return 1;
+    }
+    box[0].w = GeogLonR(lon0 + c_min - BOX_MARGIN, 0.0);
+    box[0].e = box[0].w + (c_max - c_min) + 2.0 * BOX_MARGIN;
+    box[0].s = s - BOX_MARGIN;
+    box[0].n = n + BOX_MARGIN;
+    if ( box[0].e <= M_PI ) {
+	return 1;
+    }
+    box[1] = box[0];
+    box[1].w = -M_PI;
+    box[1].e = box[0].e - 2.0 * M_PI;
+    box[0].e = M_PI;
+    return 2;
+}
+
+/*
+   Initialize rt with n boxes at boxes. If ids is not NULL, it gives an id
+   for each box, which GeogRTreeQuery passes to its callback. Otherwise the
+   id is the index in boxes. Several boxes may have the same id. Return
+   true on success, false if memory runs out.
+ */
+
+int GeogRTreeInit(struct GeogRTree *rt, const struct GeogBox *boxes,
+	const size_t *ids, size_t n)
+{
+    size_t n_tot;			/* Number of items and nodes */
+    size_t lvl;				/* Index of first node at level */
+    size_t n_lvl;			/* Number of nodes at level */
+    size_t n_par;			/* Number of parents of level */
+    size_t slice_sz;			/* Nodes per vertical slice */
+    size_t i, j, k, m;
+
+    for (m = n, n_tot = n; m > 1; ) {
+	m = (m + RT_FAN - 1) / RT_FAN;
+	n_tot += m;
+    }
+    rt->node = NULL;
+    rt->n_item = n;
+    rt->n_node = 0;
+    if ( n == 0 ) {
+	return 1;
+    }
+    if ( !(rt->node = MALLOC(n_tot * sizeof(struct GeogRNode))) ) {
+	return 0;
+    }
+    for (i = 0; i < n; i++) {
+	rt->node[i].box = boxes[i];
+	rt->node[i].lo = ids ? ids[i] : i;
+	rt->node[i].hi = 0;
+    }
+
+    /*
+       Sort each level into vertical slices by longitude, then sort each
+       slice by latitude, then make a parent for each run of RT_FAN nodes.
+     */
+
+    for (lvl = 0, n_lvl = n; n_lvl > 1; lvl += n_lvl, n_lvl = n_par) {
+	struct GeogRNode *l = rt->node + lvl, *par = l + n_lvl;
+
+	n_par = (n_lvl + RT_FAN - 1) / RT_FAN;
+	m = (size_t)ceil(sqrt((double)n_par));
+	slice_sz = (n_par + m - 1) / m * RT_FAN;
+	qsort(l, n_lvl, sizeof(struct GeogRNode), cmp_x);
+	for (i = 0; i < n_lvl; i += slice_sz) {
+	    qsort(l + i, (n_lvl - i < slice_sz) ? n_lvl - i : slice_sz,
+		    sizeof(struct GeogRNode), cmp_y);
+	}
+	for (j = 0; j < n_par; j++) {
+	    par[j].lo = lvl + j * RT_FAN;
+	    par[j].hi = lvl + ((j + 1) * RT_FAN < n_lvl
+		    ? (j + 1) * RT_FAN : n_lvl);
+	    par[j].box = rt->node[par[j].lo].box;
+	    for (k = par[j].lo + 1; k < par[j].hi; k++) {
+		const struct GeogBox *b = &rt->node[k].box;
+
+		par[j].box.w = (b->w < par[j].box.w) ? b->w : par[j].box.w;
+		par[j].box.e = (b->e > par[j].box.e) ? b->e : par[j].box.e;
+		par[j].box.s = (b->s < par[j].box.s) ? b->s : par[j].box.s;
+		par[j].box.n = (b->n > par[j].box.n) ? b->n : par[j].box.n;
+	    }
+	}
+    }
+    rt->n_node = lvl + n_lvl;
+    return 1;
+}
+
+/*
+   Call fn with client data arg for the id of each item in rt whose box
+   contains pt. Items are visited in no particular order.
+ */
+
+void GeogRTreeQuery(const struct GeogRTree *rt, struct GeogPt pt,
+	GeogRTreeFn *fn, void *arg)
+{
+    size_t stk[RT_STK];			/* Nodes to visit */
+    size_t n_stk;
+    size_t c;
+    const struct GeogRNode *nd;
+    double lon = GeogLonR(pt.lon, 0.0);
+
+    if ( rt->n_node == 0 || !in_box(&rt->node[rt->n_node - 1].box,
+		lon, pt.lat) ) {
+	return;
+    }
+    if ( rt->n_node == 1 ) {
+	fn(rt->node[0].lo, arg);
+	return;
+    }
+    stk[0] = rt->n_node - 1;
+    for (n_stk = 1; n_stk > 0; ) {
+	nd = rt->node + stk[--n_stk];
+	for (c = nd->lo; c < nd->hi; c++) {
+	    if ( in_box(&rt->node[c].box, lon, pt.lat) ) {
+		if ( c < rt->n_item ) {
+		    fn(rt->node[c].lo, arg);
+		} else {
+		    stk[n_stk++] = c;
+		}
+	    }
+	}
+    }
+}
+
+void GeogRTreeFree(struct GeogRTree *rt)
+{
+    FREE(rt->node);
+    rt->node = NULL;
+    rt->n_item = rt->n_node = 0;
+}
+
+/* Compare nodes by longitude or latitude of box center, for qsort */
+static int cmp_x(const void *a, const void *b)
+{
+    const struct GeogBox *b1 = &((const struct GeogRNode *)a)->box;
+    const struct GeogBox *b2 = &((const struct GeogRNode *)b)->box;
+    double x1 = b1->w + b1->e, x2 = b2->w + b2->e;
+
+    return (x1 < x2) ? -1 : (x1 > x2) ? 1 : 0;
+}
+
+static int cmp_y(const void *a, const void *b)
+{
+    const struct GeogBox *b1 = &((const struct GeogRNode *)a)->box;
+    const struct GeogBox *b2 = &((const struct GeogRNode *)b)->box;
+    double y1 = b1->s + b1->n, y2 = b2->s + b2->n;
+
+    return (y1 < y2) ? -1 : (y1 > y2) ? 1 : 0;
+}
+
+/* Return true if box contains longitude lon, latitude lat */
+static int in_box(const struct GeogBox *box, double lon, double lat)
+{
+    return box->w <= lon && lon <= box->e && box->s <= lat && lat <= box->n;
+}
+
+/*
+   Subtrees of a k nearest neighbor index with this many sites or fewer are
+   searched linearly.
+ */
+
+#define KNN_LEAF 8
+
+/* Coordinate a of site at position i in a k nearest neighbor index */
+#define KNN_X(kx, i, a) ((kx)->xyz[3 * (i) + (a)])
+
+/* State of a k nearest neighbor query */
+struct knn_query {
+    double q[3];			/* Query point */
+    size_t k;				/* Number of neighbors wanted */
+    size_t n;				/* Number found so far */
+    size_t *id;				/* Heap of site ids */
+    double *d2;				/* Squared chord distances for id.
+					   Largest is at d2[0]. */
+};
+
+static void knn_build(struct GeogKnnIndex *, size_t, size_t);
+static void knn_select(struct GeogKnnIndex *, size_t, size_t, size_t, int);
+static void knn_swap(struct GeogKnnIndex *, size_t, size_t);
+static void knn_search(const struct GeogKnnIndex *, size_t, size_t,
+	struct knn_query *);
+static void knn_visit(const struct GeogKnnIndex *, size_t,
+	struct knn_query *);
+static int knn_after(double, size_t, double, size_t);
+static void knn_sift(struct knn_query *, size_t, size_t);
+
+/*
+   Initialize kx with n_pts sites at pts. Sites with coordinates that are
+   not finite are skipped. pts may be freed afterward. Return true on
+   success, false if memory runs out.
+ */
+
+int GeogKnnInit(struct GeogKnnIndex *kx, const struct GeogPt *pts,
+	size_t n_pts)
+{
+    size_t i, n;
+
+    kx->xyz = MALLOC((3 * n_pts + 1) * sizeof(double));
+    kx->id = MALLOC((n_pts + 1) * sizeof(size_t));
+    kx->axis = MALLOC(n_pts + 1);
+    if ( !kx->xyz || !kx->id || !kx->axis ) {
+	GeogKnnFree(kx);
+	return 0;
+    }
+    for (i = n = 0; i < n_pts; i++) {
+	double cos_lat = cos(pts[i].lat);
+
+	if ( !isfinite(pts[i].lon) || !isfinite(pts[i].lat) ) {
+	    continue;
+	}
+	KNN_X(kx, n, 0) = cos_lat * cos(pts[i].lon);
+	KNN_X(kx, n, 1) = cos_lat * sin(pts[i].lon);
+	KNN_X(kx, n, 2) = sin(pts[i].lat);
+	kx->id[n] = i;
+	n++;
+    }
+    kx->n = n;
+    knn_build(kx, 0, n);
+    return 1;
+}
+
+/*
+   Arrange positions [lo, hi) of kx into a subtree. The site at the middle
+   position has the median value along the axis where the sites are most
+   spread out. Sites before it are not greater, and sites after it are not
+   less, along that axis.
+ */
+
+static void knn_build(struct GeogKnnIndex *kx, size_t lo, size_t hi)
+{
+    while ( hi - lo > KNN_LEAF ) {
+	double min[3], max[3];
+	size_t i, mid = lo + (hi - lo) / 2;
+	int a, ax;
+
+	for (a = 0; a < 3; a++) {
+	    min[a] = max[a] = KNN_X(kx, lo, a);
+	}
+	for (i = lo + 1; i < hi; i++) {
+	    for (a = 0; a < 3; a++) {
+		double x = KNN_X(kx, i, a);
+
+		min[a] = (x < min[a]) ? x : min[a];
+		max[a] = (x > max[a]) ? x : max[a];
+	    }
+	}
+	for (ax = 0, a = 1; a < 3; a++) {
+	    if ( max[a] - min[a] > max[ax] - min[ax] ) {
+		ax = a;
+	    }
+	}
+	knn_select(kx, lo, hi, mid, ax);
+	kx->axis[mid] = ax;
+	knn_build(kx, lo, mid);
+	lo = mid + 1;
+    }
+}
+
+/*
+   Partially sort positions [lo, hi) of kx along axis a so that position k
+   has the site that would be there if they were fully sorted (Hoare's
+   selection algorithm).
+ */
+
+static void knn_select(struct GeogKnnIndex *kx, size_t lo, size_t hi,
+	size_t k, int a)
+{
+    ptrdiff_t l = lo, r = hi - 1, i, j;
+    double x;
+
+    while ( l < r ) {
+	x = KNN_X(kx, k, a);
+	i = l;
+	j = r;
+	do {
+	    while ( KNN_X(kx, i, a) < x ) {
+		i++;
+	    }
+	    while ( x < KNN_X(kx, j, a) ) {
+		j--;
+	    }
+	    if ( i <= j ) {
+		knn_swap(kx, i, j);
+		i++;
+		j--;
+	    }
+	} while ( i <= j );
+	if ( j < (ptrdiff_t)k ) {
+	    l = i;
+	}
+	if ( (ptrdiff_t)k < i ) {
+	    r = j;
+	}
+    }
+}
+
+static void knn_swap(struct GeogKnnIndex *kx, size_t i, size_t j)
+{
+    double t[3];
+    size_t id;
+
+    memcpy(t, kx->xyz + 3 * i, sizeof(t));
+    memcpy(kx->xyz + 3 * i, kx->xyz + 3 * j, sizeof(t));
+    memcpy(kx->xyz + 3 * j, t, sizeof(t));
+    id = kx->id[i];
+    kx->id[i] = kx->id[j];
+    kx->id[j] = id;
+}
+
+/*
+   Find the k sites in kx nearest to pt. Put their ids, which are indexes
+   in the array given to GeogKnnInit, at id, and their great circle
+   distances from pt, in radians, at dist. Results are sorted nearest
+   first. Sites at equal distance are ordered by id. Return the number of
+   sites found, which is k unless kx has fewer sites.
+ */
+
+size_t GeogKnnQuery(const struct GeogKnnIndex *kx, struct GeogPt pt,
+	size_t k, size_t *id, double *dist)
+{
+    struct knn_query q;
+    double cos_lat = cos(pt.lat);
+    size_t n, t;
+    double d2;
+
+    q.q[0] = cos_lat * cos(pt.lon);
+    q.q[1] = cos_lat * sin(pt.lon);
+    q.q[2] = sin(pt.lat);
+    q.k = k;
+    q.n = 0;
+    q.id = id;
+    q.d2 = dist;
+    if ( k == 0 || !isfinite(pt.lon) || !isfinite(pt.lat) ) {
+	return 0;
+    }
+    knn_search(kx, 0, kx->n, &q);
+
+    /*
+       Sort the heap, nearest first, and convert chords to arcs.
+     */
+
+    for (n = q.n; n > 1; n--) {
+	d2 = q.d2[0];
+	q.d2[0] = q.d2[n - 1];
+	q.d2[n - 1] = d2;
+	t = q.id[0];
+	q.id[0] = q.id[n - 1];
+	q.id[n - 1] = t;
+	knn_sift(&q, 0, n - 1);
+    }
+    for (n = 0; n < q.n; n++) {
+	double c = 0.5 * sqrt(dist[n]);
+
+	dist[n] = 2.0 * asin(c > 1.0 ? 1.0 : c);
+    }
+    return q.n;
+}
+
+/* Search subtree over positions [lo, hi) of kx for neighbors of q */
+static void knn_search(const struct GeogKnnIndex *kx, size_t lo, size_t hi,
+	struct knn_query *q)
+{
+    while ( hi - lo > KNN_LEAF ) {
+	size_t mid = lo + (hi - lo) / 2;
+	int a = kx->axis[mid];
+	double diff = q->q[a] - KNN_X(kx, mid, a);
+
+	knn_visit(kx, mid, q);
+	if ( diff < 0.0 ) {
+	    knn_search(kx, lo, mid, q);
+	    lo = mid + 1;
+	} else {
+	    knn_search(kx, mid + 1, hi, q);
+	    hi = mid;
+	}
+
+	/* Sites on far side are at least diff away */
+	if ( q->n == q->k && diff * diff > q->d2[0] ) {
+	    return;
+	}
+    }
+    for ( ; lo < hi; lo++) {
+	knn_visit(kx, lo, q);
+    }
+}
+
+/* Add site at position i of kx to q if it is one of the nearest so far */
+static void knn_visit(const struct GeogKnnIndex *kx, size_t i,
+	struct knn_query *q)
+{
+    double dx = q->q[0] - KNN_X(kx, i, 0);
+    double dy = q->q[1] - KNN_X(kx, i, 1);
+    double dz = q->q[2] - KNN_X(kx, i, 2);
+    double d2 = dx * dx + dy * dy + dz * dz;
+    size_t id = kx->id[i], c, p;
+
+    if ( q->n < q->k ) {
+
+	/* Append and sift up */
+	for (c = q->n++; c > 0; c = p) {
+	    p = (c - 1) / 2;
+	    if ( !knn_after(d2, id, q->d2[p], q->id[p]) ) {
+		break;
+	    }
+	    q->d2[c] = q->d2[p];
+	    q->id[c] = q->id[p];
+	}
+	q->d2[c] = d2;
+	q->id[c] = id;
+    } else if ( knn_after(q->d2[0], q->id[0], d2, id) ) {
+	q->d2[0] = d2;
+	q->id[0] = id;
+	knn_sift(q, 0, q->n);
+    }
+}
+
+/* Return true if neighbor id1 at d2_1 ranks after id2 at d2_2 */
+static int knn_after(double d2_1, size_t id1, double d2_2, size_t id2)
+{
+    return d2_1 > d2_2 || (d2_1 == d2_2 && id1 > id2);
+}
+
+/* Restore heap order in the first n elements of q below element c */
+static void knn_sift(struct knn_query *q, size_t c, size_t n)
+{
+    double d2 = q->d2[c];
+    size_t id = q->id[c], m;
+
+    for ( ; (m = 2 * c + 1) < n; c = m) {
+	if ( m + 1 < n && knn_after(q->d2[m + 1], q->id[m + 1],
+		    q->d2[m], q->id[m]) ) {
+	    m++;
+	}
+	if ( !knn_after(q->d2[m], q->id[m], d2, id) ) {
+	    break;
+	}
+	q->d2[c] = q->d2[m];
+	q->id[c] = q->id[m];
+    }
+    q->d2[c] = d2;
+    q->id[c] = id;
+}
+
+void GeogKnnFree(struct GeogKnnIndex *kx)
+{
+    FREE(kx->xyz);
+    FREE(kx->id);
+    FREE(kx->axis);
+    kx->xyz = NULL;
+    kx->id = NULL;
+    kx->axis = NULL;
+    kx->n = 0;
+}
+
+/* Target number of points in a cell of a radius index */
+#define RX_PER_CELL 8
+
+/*
+   Margin, in radians, added to query caps to cover rounding in cell
+   selection.
+ */
+
+#define RX_MARGIN 1.0e-9
+
+static size_t rx_band(size_t, double);
+static size_t rx_cell(size_t, double);
+
+/*
+   Initialize rx with n_pts points at pts. r is the radius, in radians, of
+   typical queries, or 0.0 if unknown. Cells are sized for about
+   RX_PER_CELL points, or made larger if r is large, so that a query does
+   not visit many nearly empty cells. Points with coordinates that are not
+   finite are skipped. pts may be freed afterward. Return true on success,
+   false if memory runs out.
+ */
+
+int GeogRadiusInit(struct GeogRadiusIndex *rx, const struct GeogPt *pts,
+	size_t n_pts, double r)
+{
+    double n_cell;			/* Target number of cells */
+    size_t n_band, n_lon;
+    size_t *pt_cell = NULL;		/* Cell of each point in pts */
+    size_t n, b, c, i;
+
+    rx->pt = NULL;
+    rx->id = NULL;
+    rx->cell = NULL;
+    rx->band = NULL;
+    rx->band_lat = NULL;
+    rx->n_band = rx->n = 0;
+    for (i = n = 0; i < n_pts; i++) {
+	if ( isfinite(pts[i].lon) && isfinite(pts[i].lat) ) {
+	    n++;
+	}
+    }
+
+    /*
+       Cells near the equator are about 2 / n_band radians on a side, so
+       there are about M_PI * n_band * n_band of them.
+     */
+
+    n_cell = (double)n / RX_PER_CELL;
+    if ( r > 0.0 && n_cell > 16.0 * M_PI / (r * r) ) {
+	n_cell = 16.0 * M_PI / (r * r);
+    }
+    n_band = (size_t)sqrt(n_cell / M_PI);
+    n_band = (n_band < 1) ? 1 : n_band;
+    rx->band = MALLOC((n_band + 1) * sizeof(size_t));
+    rx->band_lat = MALLOC((n_band + 1) * sizeof(double));
+    if ( !rx->band || !rx->band_lat ) {
+	GeogRadiusFree(rx);
+	return 0;
+    }
+    rx->n_band = n_band;
+    rx->band_lat[0] = -M_PI_2;
+    for (b = 1; b < n_band; b++) {
+	rx->band_lat[b] = asin(-1.0 + 2.0 * b / n_band);
+    }
+    rx->band_lat[n_band] = M_PI_2;
+    for (b = c = 0; b < n_band; b++) {
+	double h = rx->band_lat[b + 1] - rx->band_lat[b];
+	double lat = asin(-1.0 + (2.0 * b + 1.0) / n_band);
+
+	rx->band[b] = c;
+	n_lon = (size_t)(2.0 * M_PI * cos(lat) / h + 0.5);
+	c += (n_lon < 1) ? 1 : n_lon;
+    }
+    rx->band[n_band] = c;
+
+    /*
+       Sort points by cell with a counting sort.
+     */
+
+    rx->pt = MALLOC((n + 1) * sizeof(struct GeogPt));
+    rx->id = MALLOC((n + 1) * sizeof(size_t));
+    rx->cell = CALLOC(c + 1, sizeof(size_t));
+    pt_cell = MALLOC((n_pts + 1) * sizeof(size_t));
+    if ( !rx->pt || !rx->id || !rx->cell || !pt_cell ) {
+	FREE(pt_cell);
+	GeogRadiusFree(rx);
+	return 0;
+    }
+    for (i = 0; i < n_pts; i++) {
+	if ( isfinite(pts[i].lon) && isfinite(pts[i].lat) ) {
+	    b = rx_band(n_band, sin(pts[i].lat));
+	    n_lon = rx->band[b + 1] - rx->band[b];
+	    c = rx->band[b] + rx_cell(n_lon, GeogLonR(pts[i].lon, 0.0));
+	    pt_cell[i] = c;
+	    rx->cell[c + 1]++;
+	}
+    }
+    for (c = 0; c < rx->band[n_band]; c++) {
+	rx->cell[c + 1] += rx->cell[c];
+    }
+    for (i = 0; i < n_pts; i++) {
+	if ( isfinite(pts[i].lon) && isfinite(pts[i].lat) ) {
+	    size_t j = rx->cell[pt_cell[i]]++;
+
+	    rx->pt[j].lon = GeogLonR(pts[i].lon, 0.0);
+	    rx->pt[j].lat = pts[i].lat;
+	    rx->id[j] = i;
+	}
+    }
+
+    /* Placement advanced each cell start to the next cell. Shift back. */
+    for (c = rx->band[n_band]; c > 0; c--) {
+	rx->cell[c] = rx->cell[c - 1];
+    }
+    rx->cell[0] = 0;
+    rx->n = n;
+    FREE(pt_cell);
+    return 1;
+}
+
+/*
+   Call fn with client data arg for each point in rx within great circle
+   distance r, in radians, of pt. The callback receives the point id, which
+   is its index in the array given to GeogRadiusInit, and its distance from
+   pt. Only cells that intersect the cap around pt are searched. Points are
+   visited in no particular order. Return the number of points found.
+ */
+
+size_t GeogRadiusQuery(const struct GeogRadiusIndex *rx, struct GeogPt pt,
+	double r, GeogRadiusFn *fn, void *arg)
+{
+    double lon, lat;			/* Query point */
+    double rm;				/* r with margin */
+    double s, n;			/* Latitude limits of cap */
+    double cos_rm, sin_lat, cos_lat;
+    double sin_lat_t;			/* Sine of latitude where cap is
+					   widest */
+    int pole;				/* If true, cap contains a pole */
+    size_t b, b0, b1, n_found = 0;
+
+    if ( rx->n == 0 || !isfinite(pt.lon) || !isfinite(pt.lat)
+	    || !(r >= 0.0) ) {
+	return 0;
+    }
+    lon = GeogLonR(pt.lon, 0.0);
+    lat = pt.lat;
+    rm = r + RX_MARGIN;
+    s = lat - rm;
+    n = lat + rm;
+    pole = s <= -M_PI_2 || n >= M_PI_2;
+    b0 = (s <= -M_PI_2) ? 0 : rx_band(rx->n_band, sin(s));
+    b1 = (n >= M_PI_2) ? rx->n_band - 1 : rx_band(rx->n_band, sin(n));
+    cos_rm = cos(rm);
+    sin_lat = sin(lat);
+    cos_lat = cos(lat);
+    sin_lat_t = pole ? 0.0 : sin_lat / cos_rm;
+    for (b = b0; b <= b1; b++) {
+	size_t n_lon = rx->band[b + 1] - rx->band[b];
+	double w = 2.0 * M_PI / n_lon;	/* Cell width */
+	double dlon = M_PI;		/* Longitude half width of cap in
+					   band */
+	ptrdiff_t i, i0 = 0, i1 = n_lon - 1;
+
+	if ( !pole ) {
+
+	    /*
+	       The cap is widest at the latitude in the band nearest the
+	       latitude where the cap is widest overall.
+	     */
+
+	    double lat_lo = rx->band_lat[b] - RX_MARGIN;
+	    double lat_hi = rx->band_lat[b + 1] + RX_MARGIN;
+	    double lat_w = asin(sin_lat_t);
+	    double cos_dlon;
+
+	    lat_lo = (lat_lo < s) ? s : lat_lo;
+	    lat_hi = (lat_hi > n) ? n : lat_hi;
+	    lat_w = (lat_w < lat_lo) ? lat_lo : (lat_w > lat_hi) ? lat_hi
+		: lat_w;
+	    cos_dlon = (cos_rm - sin(lat_w) * sin_lat)
+		/ (cos(lat_w) * cos_lat);
+	    if ( cos_dlon > -1.0 ) {
+		dlon = (cos_dlon < 1.0 ? acos(cos_dlon) : 0.0) + RX_MARGIN;
+	    }
+	}
+	if ( 2.0 * dlon + w < 2.0 * M_PI ) {
+	    i0 = (ptrdiff_t)floor((lon - dlon + M_PI) / w);
+	    i1 = (ptrdiff_t)floor((lon + dlon + M_PI) / w);
+	    if ( i1 - i0 >= (ptrdiff_t)n_lon ) {
+		i0 = 0;
+		i1 = n_lon - 1;
+	    }
+	}
+	for (i = i0; i <= i1; i++) {
+	    size_t c = rx->band[b] + (i + n_lon) % n_lon;
+	    size_t j;
+
+	    for (j = rx->cell[c]; j < rx->cell[c + 1]; j++) {
+		double d = GeogDist(lon, lat, rx->pt[j].lon, rx->pt[j].lat);
+
+		if ( d <= r ) {
+		    fn(rx->id[j], d, arg);
+		    n_found++;
+		}
+	    }
+	}
+    }
+    return n_found;
+}
+
+/* Return the band with sine of latitude z in a radius index with n bands */
+static size_t rx_band(size_t n, double z)
+{
+    double b = floor((z + 1.0) * 0.5 * n);
+
+    return (b < 0.0) ? 0 : (b >= n) ? n - 1 : (size_t)b;
+}
+
+/* Return the cell with longitude lon in [-M_PI, M_PI) in a band of n cells */
+static size_t rx_cell(size_t n, double lon)
+{
+    double c = floor((lon + M_PI) / (2.0 * M_PI / n));
+
+    return (c < 0.0) ? 0 : (c >= n) ? n - 1 : (size_t)c;
+}
+
+void GeogRadiusFree(struct GeogRadiusIndex *rx)
+{
+    FREE(rx->pt);
+    FREE(rx->id);
+    FREE(rx->cell);
+    FREE(rx->band);
+    FREE(rx->band_lat);
+    rx->pt = NULL;
+    rx->id = NULL;
+    rx->cell = NULL;
+    rx->band = NULL;
+    rx->band_lat = NULL;
+    rx->n_band = rx->n = 0;
+}
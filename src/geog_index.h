@@ -0,0 +1,138 @@
+/*
+   -	geog_index.h --
+   -		Declarations of spatial indexes for the geog
+   -		application.  See geog_index (3).
+   -
+   .	Copyright (c) 2014, Gordon D. Carrie. All rights reserved.
+   .
+   .	Redistribution and use in source and binary forms, with or without
+   .	modification, are permitted provided that the following conditions
+   .	are met:
+   .
+   .	    * Redistributions of source code must retain the above copyright
+   .	    notice, this list of conditions and the following disclaimer.
+   .
+   .	    * Redistributions in binary form must reproduce the above copyright
+   .	    notice, this list of conditions and the following disclaimer in the
+   .	    documentation and/or other materials provided with the distribution.
+   .
+   .	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   .	"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   .	LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   .	A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+   .	HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+   .	SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+   .	TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   .	PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   .	LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   .	NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   .	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+   .
+   .	Please send feedback to dev0@trekix.net
+   .
+   .	$Revision: $ $Date: $
+ */
+
+#ifndef GEOG_INDEX_H_
+#define GEOG_INDEX_H_
+
+#include <stddef.h>
+#include "geog_lib.h"
+
+/*
+   A longitude latitude box, in radians. West and east bounds are in
+   [-M_PI, M_PI] with w <= e, so boxes that cross the antimeridian must be
+   split.
+ */
+
+struct GeogBox {
+    double w, e;			/* West and east bounds */
+    double s, n;			/* South and north bounds */
+};
+
+/*
+   R-tree over boxes, packed by the Sort-Tile-Recursive method. Clients
+   should not refer to members directly.
+ */
+
+struct GeogRNode {
+    struct GeogBox box;
+    size_t lo, hi;			/* Children are node[lo] to node[hi - 1].
+					   For an item, lo is the client id */
+};
+
+struct GeogRTree {
+    struct GeogRNode *node;		/* Items, then nodes. Root is last */
+    size_t n_item;			/* Number of items */
+    size_t n_node;			/* Number of items and nodes */
+};
+
+/*
+   Function called for each item found by GeogRTreeQuery. The arguments are
+   the item id and client data.
+ */
+
+typedef void (GeogRTreeFn)(size_t, void *);
+
+/*
+   Index for k nearest neighbor searches. Sites are unit vectors in a k-d
+   tree with an implicit layout: the root of the subtree over positions
+   [lo, hi) is at position (lo + hi) / 2. Clients should not refer to
+   members directly.
+ */
+
+struct GeogKnnIndex {
+    double *xyz;			/* Unit vectors, three values per site,
+					   in tree order */
+    size_t *id;				/* Index of each site in the array
+					   given to GeogKnnInit */
+    unsigned char *axis;		/* Split axis of subtree at each
+					   position */
+    size_t n;				/* Number of sites */
+};
+
+/*
+   Index for finding points within a distance of a point. Points are
+   bucketed into cells. Latitude bands have equal area. Each band is
+   divided into longitude cells about as wide as the band is tall. Clients
+   should not refer to members directly.
+ */
+
+struct GeogRadiusIndex {
+    struct GeogPt *pt;			/* Points, sorted by cell */
+    size_t *id;				/* Index of each point in the array
+					   given to GeogRadiusInit */
+    size_t *cell;			/* Points in cell c are pt[cell[c]] to
+					   pt[cell[c + 1] - 1] */
+    size_t *band;			/* Cells in band b are band[b] to
+					   band[b + 1] - 1 */
+    double *band_lat;			/* Latitude limits of bands */
+    size_t n_band;			/* Number of bands */
+    size_t n;				/* Number of points */
+};
+
+/*
+   Function called for each point found by GeogRadiusQuery. The arguments
+   are the point id, its distance from the query point in radians, and
+   client data.
+ */
+
+typedef void (GeogRadiusFn)(size_t, double, void *);
+
+int GeogPolygonBox(const struct GeogPt *, size_t, struct GeogBox *);
+int GeogRTreeInit(struct GeogRTree *, const struct GeogBox *, const size_t *,
+	size_t);
+void GeogRTreeQuery(const struct GeogRTree *, struct GeogPt, GeogRTreeFn *,
+	void *);
+void GeogRTreeFree(struct GeogRTree *);
+int GeogKnnInit(struct GeogKnnIndex *, const struct GeogPt *, size_t);
+size_t GeogKnnQuery(const struct GeogKnnIndex *, struct GeogPt, size_t,
+	size_t *, double *);
+void GeogKnnFree(struct GeogKnnIndex *);
+int GeogRadiusInit(struct GeogRadiusIndex *, const struct GeogPt *, size_t,
+	double);
+size_t GeogRadiusQuery(const struct GeogRadiusIndex *, struct GeogPt, double,
+	GeogRadiusFn *, void *);
+void GeogRadiusFree(struct GeogRadiusIndex *);
+
+#endif
@@ -0,0 +1,702 @@
+/*
+   -	geog_io.c --
+   -		This file defines functions that read and write numbers
+   -		for the geog application.  See geog_io (3).
+   -
+   .	Copyright (c) 2014, Gordon D. Carrie. All rights reserved.
+   .
+   .	Redistribution and use in source and binary forms, with or without
+   .	modification, are permitted provided that the following conditions
+   .	are met:
+   .
+   .	    * Redistributions of source code must retain the above copyright
+   .	    notice, this list of conditions and the following disclaimer.
+   .
+   .	    * Redistributions in binary form must reproduce the above copyright
+   .	    notice, this list of conditions and the following disclaimer in the
+   .	    documentation and/or other materials provided with the distribution.
+   .
+   .	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   .	"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   .	LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   .	A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+   .	HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+   .	SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+   .	TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   .	PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   .	LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   .	NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   .	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+   .
+   .	Please send feedback to dev0@trekix.net
+   .
+   .	$Revision: $ $Date: $
+   .
+   .	Reference
+   .	Clinger, W. D., "How to Read Floating Point Numbers Accurately",
+   .	Proceedings of the ACM SIGPLAN '90 Conference on Programming
+   .	Language Design and Implementation, 1990, p. 92-101.
+ */
+
+#include "unix_defs.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <float.h>
+#include <math.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include "alloc.h"
+#include "geog_io.h"
+
+/* Size of input and output buffers */
+#define BUF_SZ (1 << 18)
+
+/* Tokens longer than this are copied to the heap for strtod */
+#define TOK_MAX 512
+
+/* Space for most numbers formatted with snprintf */
+#define FIX_MAX (DBL_MAX_10_EXP + 64)
+
+/* White space in the C locale */
+#define IS_SPACE(c) ((c) == ' ' || (c) == '\n' || (c) == '\t' \
+	|| (c) == '\r' || (c) == '\f' || (c) == '\v')
+
+#define IS_DIGIT(c) ((c) >= '0' && (c) <= '9')
+
+/* Powers of ten that can be represented exactly as doubles */
+static const double p10[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+static int fill(struct GeogIn *);
+static int reserve(struct GeogOut *, size_t);
+static int write_all(struct GeogOut *, const char *, size_t);
+
+/* Initialize in to read from file descriptor fd. */
+int GeogInInit(struct GeogIn *in, int fd)
+{
+    in->fd = fd;
+    in->own_fd = 0;
+    in->sz = BUF_SZ;
+    if ( !(in->buf = MALLOC(in->sz)) ) {
+	return 0;
+    }
+    in->p = in->e = in->buf;
+    in->eof = 0;
+    in->map = NULL;
+    in->map_sz = 0;
+    in->n_rd = 0;
+    return 1;
+}
+
+/* Initialize in to read n bytes at m. m must persist while in is used. */
+void GeogInInitMem(struct GeogIn *in, const char *m, size_t n)
+{
+    in->fd = -1;
+    in->own_fd = 0;
+    in->buf = NULL;
+    in->sz = 0;
+    in->p = m;
+    in->e = m + n;
+    in->eof = 1;
+    in->map = NULL;
+    in->map_sz = 0;
+    in->n_rd = 0;
+}
+
+/*
+   Initialize in to read file fnm, which is mapped into memory if it is a
+   regular file. Other files, such as pipes, are read with GeogInInit, and
+   GeogInFree closes them. Print a message and return false on failure.
+ */
+
+int GeogInMapFile(struct GeogIn *in, const char *fnm)
+{
+    int fd;
+    struct stat sbuf;
+    void *m = NULL;
+
+    if ( (fd = open(fnm, O_RDONLY)) == -1 ) {
+	fprintf(stderr, "Could not open %s.\n", fnm);
+	perror(NULL);
+	return 0;
+    }
+    if ( fstat(fd, &sbuf) == -1 ) {
+	fprintf(stderr, "Could not get size of %s.\n", fnm);
+	perror(NULL);
+	close(fd);
+	return 0;
+    }
+    if ( !S_ISREG(sbuf.st_mode) ) {
+	if ( !GeogInInit(in, fd) ) {
+	    fprintf(stderr, "Could not allocate input buffer for %s.\n", fnm);
+	    close(fd);
+	    return 0;
+	}
+	in->own_fd = 1;
+	return 1;
+    }
+    if ( sbuf.st_size > 0 ) {
+	m = mmap(NULL, sbuf.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if ( m == MAP_FAILED ) {
+	    fprintf(stderr, "Could not map %s into memory.\n", fnm);
+	    perror(NULL);
+	    close(fd);
+	    return 0;
+	}
+	posix_madvise(m, sbuf.st_size, POSIX_MADV_SEQUENTIAL);
+    }
+    close(fd);
+    GeogInInitMem(in, m, sbuf.st_size);
+    in->map = m;
+    in->map_sz = sbuf.st_size;
+    return 1;
+}
+
+void GeogInFree(struct GeogIn *in)
+{
+    FREE(in->buf);
+    in->buf = NULL;
+    if ( in->map ) {
+	munmap(in->map, in->map_sz);
+	in->map = NULL;
+    }
+    if ( in->own_fd ) {
+	close(in->fd);
+	in->fd = -1;
+	in->own_fd = 0;
+    }
+}
+
+/*
+   Move unread input to start of buffer and read more. Return true if more
+   data were added, false at end of input or error.
+ */
+
+static int fill(struct GeogIn *in)
+{
+    size_t n;
+    ssize_t r;
+
+    if ( in->eof ) {
+	return 0;
+    }
+    n = in->e - in->p;
+    if ( n == in->sz ) {
+	char *buf;
+
+	if ( !(buf = REALLOC(in->buf, 2 * in->sz)) ) {
+	    in->eof = 1;
+	    return 0;
+	}
+	in->buf = buf;
+	in->sz *= 2;
+    } else if ( in->p != in->buf ) {
+	memmove(in->buf, in->p, n);
+    }
+    in->p = in->buf;
+    in->e = in->buf + n;
+    do {
+	r = read(in->fd, in->buf + n, in->sz - n);
+    } while ( r == -1 && errno == EINTR );
+    if ( r <= 0 ) {
+	if ( r == -1 ) {
+	    perror("Could not read input");
+	}
+	in->eof = 1;
+	return 0;
+    }
+    in->e += r;
+    in->n_rd += r;
+    return 1;
+}
+
+/*
+   Read the next white space separated number from in into v, like scanf
+   " %lf". Return true on success, false at end of input or if the next
+   token is not a number.
+ */
+
+int GeogInDbl(struct GeogIn *in, double *v)
+{
+    const char *p;
+
+    for (;;) {
+	while ( in->p < in->e && IS_SPACE(*in->p) ) {
+	    in->p++;
+	}
+	if ( in->p == in->e ) {
+	    if ( !fill(in) ) {
+		return 0;
+	    }
+	    continue;
+	}
+
+	/* Make sure the whole token is in the buffer */
+	for (p = in->p; p < in->e && !IS_SPACE(*p); p++) {
+	}
+	if ( p == in->e && fill(in) ) {
+	    continue;
+	}
+	break;
+    }
+    return GeogIOParseDbl(&in->p, in->e, v);
+}
+
+/*
+   Set *ln to the next line of input, including newline if present, and *n
+   to its length. The line remains valid until the next read from in. Return
+   false at end of input.
+ */
+
+int GeogInLine(struct GeogIn *in, const char **ln, size_t *n)
+{
+    const char *p;
+    size_t skip = 0;			/* Bytes already searched */
+
+    for (;;) {
+	p = memchr(in->p + skip, '\n', in->e - in->p - skip);
+	if ( p ) {
+	    p++;
+	    break;
+	}
+	skip = in->e - in->p;
+	if ( !fill(in) ) {
+	    if ( in->p == in->e ) {
+		return 0;
+	    }
+	    p = in->e;
+	    break;
+	}
+    }
+    *ln = in->p;
+    *n = p - in->p;
+    in->p = p;
+    return 1;
+}
+
+/*
+   Read a record of n values from in into v. If fmt is GeogIOText, values are
+   white space separated numbers. Otherwise, they are packed binary values.
+   Return true if a complete record was read.
+ */
+
+int GeogInRec(struct GeogIn *in, enum GeogIOFmt fmt, double *v, size_t n)
+{
+    size_t i, sz;
+    const unsigned char *b;
+
+    switch (fmt) {
+	case GeogIOText:
+	    for (i = 0; i < n; i++) {
+		if ( !GeogInDbl(in, v + i) ) {
+		    return 0;
+		}
+	    }
+	    return 1;
+	case GeogIOF64:
+	    sz = n * 8;
+	    break;
+	case GeogIOF32:
+	    sz = n * 4;
+	    break;
+	default:
+	    return 0;
+    }
+    while ( (size_t)(in->e - in->p) < sz ) {
+	if ( !fill(in) ) {
+	    return 0;
+	}
+    }
+    b = (const unsigned char *)in->p;
+    if ( fmt == GeogIOF64 ) {
+	for (i = 0; i < n; i++, b += 8) {
+	    uint64_t u;
+
+	    u = (uint64_t)b[0] | (uint64_t)b[1] << 8 | (uint64_t)b[2] << 16
+		| (uint64_t)b[3] << 24 | (uint64_t)b[4] << 32
+		| (uint64_t)b[5] << 40 | (uint64_t)b[6] << 48
+		| (uint64_t)b[7] << 56;
+	    memcpy(v + i, &u, 8);
+	}
+    } else {
+	for (i = 0; i < n; i++, b += 4) {
+	    uint32_t u;
+	    float f;
+
+	    u = (uint32_t)b[0] | (uint32_t)b[1] << 8 | (uint32_t)b[2] << 16
+		| (uint32_t)b[3] << 24;
+	    memcpy(&f, &u, 4);
+	    v[i] = f;
+	}
+    }
+    in->p += sz;
+    return 1;
+}
+
+/*
+   Parse a number from the characters at *pp, not going beyond e. Leading
+   white space is skipped. If successful, put the value at v, point *pp
+   after the number and return true. Otherwise, return false. Decimal
+   numbers with at most 19 significant digits and a modest exponent are
+   converted directly. Others go to strtod. Either way the result is
+   correctly rounded.
+ */
+
+int GeogIOParseDbl(const char **pp, const char *e, double *v)
+{
+    const char *p = *pp, *s;
+    int neg = 0;			/* If true, number is negative */
+    uint64_t w = 0;			/* Significant digits */
+    int nd = 0;				/* Number of digits in w */
+    int e10 = 0;			/* Decimal exponent */
+    int any = 0;			/* If true, mantissa had digits */
+    int trunc = 0;			/* If true, digits were dropped */
+
+    while ( p < e && IS_SPACE(*p) ) {
+	p++;
+    }
+    s = p;
+    if ( p < e && (*p == '-' || *p == '+') ) {
+	neg = (*p == '-');
+	p++;
+    }
+    for ( ; p < e && IS_DIGIT(*p); p++) {
+	any = 1;
+	if ( w == 0 && *p == '0' ) {
+	    continue;
+	} else if ( nd < 19 ) {
+	    w = 10 * w + (*p - '0');
+	    nd++;
+	} else {
+	    e10++;
+	    trunc = 1;
+	}
+    }
+    if ( p < e && *p == '.' ) {
+	for (p++; p < e && IS_DIGIT(*p); p++) {
+	    any = 1;
+	    if ( w == 0 && *p == '0' ) {
+		e10--;
+	    } else if ( nd < 19 ) {
+		w = 10 * w + (*p - '0');
+		nd++;
+		e10--;
+	    } else {
+		trunc = 1;
+	    }
+	}
+    }
+    if ( any && p < e && (*p == 'e' || *p == 'E') ) {
+	const char *q = p + 1;
+	int eneg = 0, x = 0;
+
+	if ( q < e && (*q == '-' || *q == '+') ) {
+	    eneg = (*q == '-');
+	    q++;
+	}
+	if ( q < e && IS_DIGIT(*q) ) {
+	    for ( ; q < e && IS_DIGIT(*q); q++) {
+		if ( x < 100000 ) {
+		    x = 10 * x + (*q - '0');
+		}
+	    }
+	    e10 += eneg ? -x : x;
+	    p = q;
+	}
+    }
+    if ( any && !trunc && w <= ((uint64_t)1 << 53) && e10 >= -22 && e10 <= 22
+	    && !(p < e && (*p == 'x' || *p == 'X')) ) {
+	double d = (double)w;
+
+	d = (e10 < 0) ? d / p10[-e10] : d * p10[e10];
+	*v = neg ? -d : d;
+	*pp = p;
+	return 1;
+    } else {
+	char buf[TOK_MAX];		/* Copy of short token for strtod */
+	char *tok, *end;
+	size_t n;
+	double d;
+
+	for (p = s; p < e && !IS_SPACE(*p); p++) {
+	}
+	n = p - s;
+	if ( n < TOK_MAX ) {
+	    tok = buf;
+	} else if ( !(tok = MALLOC(n + 1)) ) {
+	    fprintf(stderr, "Could not allocate %lu bytes for token.\n",
+		    (unsigned long)(n + 1));
+	    return 0;
+	}
+	memcpy(tok, s, n);
+	tok[n] = '\0';
+	d = strtod(tok, &end);
+	n = end - tok;
+	if ( tok != buf ) {
+	    FREE(tok);
+	}
+	if ( n == 0 ) {
+	    return 0;
+	}
+	*v = d;
+	*pp = s + n;
+	return 1;
+    }
+}
+
+/* Initialize out to write to file descriptor fd, or to memory if fd is -1 */
+int GeogOutInit(struct GeogOut *out, int fd)
+{
+    out->fd = fd;
+    out->len = 0;
+    out->sz = BUF_SZ;
+    out->err = 0;
+    out->n_wr = 0;
+    if ( !(out->buf = MALLOC(out->sz)) ) {
+	return 0;
+    }
+    return 1;
+}
+
+/* Make room for n more bytes at out->buf. Return false on failure. */
+static int reserve(struct GeogOut *out, size_t n)
+{
+    if ( out->len + n <= out->sz ) {
+	return 1;
+    }
+    if ( out->fd != -1 && !GeogOutFlush(out) ) {
+	return 0;
+    }
+    if ( out->len + n > out->sz ) {
+	size_t sz = 2 * out->sz;
+	char *buf;
+
+	if ( sz < out->len + n ) {
+	    sz = out->len + n;
+	}
+	if ( !(buf = REALLOC(out->buf, sz)) ) {
+	    out->err = 1;
+	    return 0;
+	}
+	out->buf = buf;
+	out->sz = sz;
+    }
+    return 1;
+}
+
+int GeogOutMem(struct GeogOut *out, const char *m, size_t n)
+{
+    if ( out->fd != -1 && n > out->sz ) {
+	return GeogOutFlush(out) && write_all(out, m, n);
+    }
+    if ( !reserve(out, n) ) {
+	return 0;
+    }
+    memcpy(out->buf + out->len, m, n);
+    out->len += n;
+    return 1;
+}
+
+int GeogOutStr(struct GeogOut *out, const char *s)
+{
+    return GeogOutMem(out, s, strlen(s));
+}
+
+/*
+   Append v with prec digits after the decimal point, exactly as printf
+   "%.*f" would. Values that can be scaled to an integer below 2^52 and
+   are not close to a rounding tie are formatted here. Others go to
+   snprintf.
+ */
+
+int GeogOutFix(struct GeogOut *out, double v, int prec)
+{
+    if ( isfinite(v) && prec >= 0 && prec <= 9 ) {
+	double scale = p10[prec];
+	double a = fabs(v), t, r, f;
+
+	t = a * scale;
+	if ( t < 4503599627370496.0 ) {		/* 2^52 */
+	    r = floor(t);
+	    f = t - r;
+
+	    /*
+	       t differs from the exact product by at most half a unit in
+	       the last place. Leave anything that close to a tie to snprintf.
+	     */
+
+	    if ( fabs(f - 0.5) > t * 8.8817841970012523e-16 ) {	/* 2^-50 */
+		uint64_t q = (uint64_t)r + (f > 0.5);
+		uint64_t ip = q / (uint64_t)scale;
+		uint64_t fp = q % (uint64_t)scale;
+		char digits[32], *d;
+		char *b;
+		int i;
+
+		if ( !reserve(out, 32) ) {
+		    return 0;
+		}
+		b = out->buf + out->len;
+		if ( signbit(v) ) {
+		    *b++ = '-';
+		}
+		d = digits;
+		do {
+		    *d++ = '0' + (char)(ip % 10);
+		    ip /= 10;
+		} while ( ip > 0 );
+		while ( d > digits ) {
+		    *b++ = *--d;
+		}
+		if ( prec > 0 ) {
+		    *b++ = '.';
+		    for (i = prec - 1; i >= 0; i--) {
+			b[i] = '0' + (char)(fp % 10);
+			fp /= 10;
+		    }
+		    b += prec;
+		}
+		out->len = b - out->buf;
+		return 1;
+	    }
+	}
+    }
+    {
+	char buf[FIX_MAX], *b = buf;	/* Output from snprintf */
+	int n, rslt;
+
+	n = snprintf(buf, sizeof(buf), "%.*f", prec, v);
+	if ( n < 0 ) {
+	    out->err = 1;
+	    return 0;
+	}
+	if ( (size_t)n >= sizeof(buf) ) {
+	    if ( !(b = MALLOC(n + 1)) ) {
+		out->err = 1;
+		return 0;
+	    }
+	    snprintf(b, n + 1, "%.*f", prec, v);
+	}
+	rslt = GeogOutMem(out, b, n);
+	if ( b != buf ) {
+	    FREE(b);
+	}
+	return rslt;
+    }
+}
+
+/*
+   Append n values from v as packed binary values in format fmt, which must
+   be GeogIOF64 or GeogIOF32.
+ */
+
+int GeogOutRec(struct GeogOut *out, enum GeogIOFmt fmt, const double *v,
+	size_t n)
+{
+    size_t i;
+    unsigned char *b;
+
+    if ( fmt == GeogIOF64 ) {
+	if ( !reserve(out, n * 8) ) {
+	    return 0;
+	}
+	b = (unsigned char *)out->buf + out->len;
+	for (i = 0; i < n; i++) {
+	    uint64_t u;
+	    int k;
+
+	    memcpy(&u, v + i, 8);
+	    for (k = 0; k < 8; k++, u >>= 8) {
+		*b++ = (unsigned char)(u & 0xff);
+	    }
+	}
+    } else if ( fmt == GeogIOF32 ) {
+	if ( !reserve(out, n * 4) ) {
+	    return 0;
+	}
+	b = (unsigned char *)out->buf + out->len;
+	for (i = 0; i < n; i++) {
+	    float f = (float)v[i];
+	    uint32_t u;
+	    int k;
+
+	    memcpy(&u, &f, 4);
+	    for (k = 0; k < 4; k++, u >>= 8) {
+		*b++ = (unsigned char)(u & 0xff);
+	    }
+	}
+    } else {
+	return 0;
+    }
+    out->len = (char *)b - out->buf;
+    return 1;
+}
+
+/*
+   Set *fmt to the format named by s, which must be "text", "f64", or "f32".
+   Return false if s is not recognized.
+ */
+
+int GeogIOFmtFmStr(const char *s, enum GeogIOFmt *fmt)
+{
+    if ( strcmp(s, "text") == 0 ) {
+	*fmt = GeogIOText;
+    } else if ( strcmp(s, "f64") == 0 ) {
+	*fmt = GeogIOF64;
+    } else if ( strcmp(s, "f32") == 0 ) {
+	*fmt = GeogIOF32;
+    } else {
+	return 0;
+    }
+    return 1;
+}
+
+/* Write buffered output to out->fd. Return false on failure. */
+int GeogOutFlush(struct GeogOut *out)
+{
+    if ( out->err ) {
+	return 0;
+    }
+    if ( out->fd == -1 ) {
+	return 1;
+    }
+    if ( !write_all(out, out->buf, out->len) ) {
+	return 0;
+    }
+    out->len = 0;
+    return 1;
+}
+
+/* Write n bytes from m to out->fd. Return false on failure. */
+static int write_all(struct GeogOut *out, const char *m, size_t n)
+{
+    const char *e = m + n;
+    ssize_t w;
+
+    while ( m < e ) {
+	w = write(out->fd, m, e - m);
+	if ( w == -1 ) {
+	    if ( errno == EINTR ) {
+		continue;
+	    }
+	    perror("Could not write output");
+	    out->err = 1;
+	    return 0;
+	}
+	m += w;
+	out->n_wr += w;
+    }
+    return 1;
+}
+
+void GeogOutFree(struct GeogOut *out)
+{
+    FREE(out->buf);
+    out->buf = NULL;
+}
@@ -0,0 +1,101 @@
+/*
+   -	geog_io.h --
+   -		Declarations of structures and functions that read and
+   -		write numbers for the geog application.  See geog_io (3).
+   -
+   .	Copyright (c) 2014, Gordon D. Carrie. All rights reserved.
+   .
+   .	Redistribution and use in source and binary forms, with or without
+   .	modification, are permitted provided that the following conditions
+   .	are met:
+   .
+   .	    * Redistributions of source code must retain the above copyright
+   .	    notice, this list of conditions and the following disclaimer.
+   .
+   .	    * Redistributions in binary form must reproduce the above copyright
+   .	    notice, this list of conditions and the following disclaimer in the
+   .	    documentation and/or other materials provided with the distribution.
+   .
+   .	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   .	"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   .	LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   .	A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+   .	HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+   .	SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+   .	TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   .	PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   .	LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   .	NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   .	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+   .
+   .	Please send feedback to dev0@trekix.net
+   .
+   .	$Revision: $ $Date: $
+ */
+
+#ifndef GEOG_IO_H_
+#define GEOG_IO_H_
+
+#include <stddef.h>
+
+/*
+   Formats for numeric data. Binary values are little-endian IEEE 754.
+ */
+
+enum GeogIOFmt {
+    GeogIOText, GeogIOF64, GeogIOF32
+};
+
+/*
+   Buffered input. Data come from a file descriptor, or from a block of
+   memory or a memory mapped file if fd is -1. Clients should not refer to
+   members directly, except to read n_rd.
+ */
+
+struct GeogIn {
+    int fd;				/* File descriptor or -1 */
+    int own_fd;				/* If true, GeogInFree closes fd */
+    char *buf;				/* Buffer for data read from fd */
+    size_t sz;				/* Allocation at buf */
+    const char *p;			/* Next unread character */
+    const char *e;			/* End of available data */
+    int eof;				/* If true, no more data after e */
+    void *map;				/* Memory mapped file, or NULL */
+    size_t map_sz;			/* Size of mapping at map */
+    size_t n_rd;			/* Bytes read from fd */
+};
+
+/*
+   Buffered output. Data go to a file descriptor, or accumulate in memory
+   if fd is -1. Clients should not refer to members directly, except
+   to read n_wr.
+ */
+
+struct GeogOut {
+    int fd;				/* File descriptor or -1 */
+    char *buf;				/* Output not yet written to fd */
+    size_t len;				/* Number of bytes at buf */
+    size_t sz;				/* Allocation at buf */
+    int err;				/* If true, a write or allocation
+					   failed */
+    size_t n_wr;			/* Bytes written to fd */
+};
+
+int GeogInInit(struct GeogIn *, int);
+void GeogInInitMem(struct GeogIn *, const char *, size_t);
+int GeogInMapFile(struct GeogIn *, const char *);
+void GeogInFree(struct GeogIn *);
+int GeogInDbl(struct GeogIn *, double *);
+int GeogInLine(struct GeogIn *, const char **, size_t *);
+int GeogInRec(struct GeogIn *, enum GeogIOFmt, double *, size_t);
+int GeogIOParseDbl(const char **, const char *, double *);
+int GeogOutInit(struct GeogOut *, int);
+int GeogOutMem(struct GeogOut *, const char *, size_t);
+int GeogOutStr(struct GeogOut *, const char *);
+int GeogOutFix(struct GeogOut *, double, int);
+int GeogOutRec(struct GeogOut *, enum GeogIOFmt, const double *, size_t);
+int GeogOutFlush(struct GeogOut *);
+void GeogOutFree(struct GeogOut *);
+int GeogIOFmtFmStr(const char *, enum GeogIOFmt *);
+
+#endif
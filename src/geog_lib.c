@@ -46,6 +46,10 @@
 #include <float.h>
 #include <math.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "alloc.h"
 #include "geog_lib.h"
 
 #ifndef M_PI
@@ -87,7 +91,10 @@ void GeogDMS(double ddeg, double *deg, double *min, double *sec, char *fmt)
     }
 }
 
-/* Get or set Earth radius */
+/*
+   Get or set default Earth radius. This is global to the process. Threads
+   that need different radii should use their own GeogCtx.
+ */
 double GeogREarth(const double *r)
 {
     static double rearth = 6366707.019;		/* 1' = 1852 m */
@@ -96,6 +103,24 @@ double GeogREarth(const double *r)
     }
     return rearth;
 }
+
+/* Initialize a context with the default Earth radius */
+void GeogCtxInit(struct GeogCtx *ctx)
+{
+    ctx->r_earth = GeogREarth(NULL);
+}
+
+/* Set Earth radius for a context */
+void GeogCtxSetREarth(struct GeogCtx *ctx, double r)
+{
+    ctx->r_earth = r;
+}
+
+/* Get Earth radius from a context */
+double GeogCtxREarth(const struct GeogCtx *ctx)
+{
+    return ctx->r_earth;
+}
 
 /* Put l into [r - M_PI, r + M_PI) */
 double GeogLonR(const double l, const double r)
@@ -165,6 +190,790 @@ void GeogStep(const double o1, const double a1, const double d, const double s,
     *o2 = GeogLonR(o1 + dlon, 0.0);
 }
 
+/*
+   Array versions of GeogDist, GeogAz, and GeogStep. Point i of each array
+   argument is used for the i'th computation. Output arrays may be the same
+   as input arrays.
+
+   On x86 with GCC or Clang, points are processed VEC_W at a time with
+   vector arithmetic. Sines and cosines come from the fdlibm kernel
+   polynomials after Cody-Waite reduction by pi/2, arcsines from the fdlibm
+   rational approximation, and arc tangents from the Cephes rational
+   approximation. The same code is compiled for SSE2, AVX2, and AVX-512,
+   and vec_init picks the widest instruction set the processor supports.
+   Floating point contraction is off in standard C mode, so every
+   instruction set gives the same results. geog_bench reports the largest
+   difference from the scalar functions, which use libm. Blocks with an
+   argument that is not finite or whose magnitude exceeds VEC_MAX, or
+   for GeogStepN a starting longitude outside [-2 pi, 2 pi], go to the
+   scalar functions.
+ */
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+
+#define VEC_W 8				/* Points per vector */
+#define VEC_MAX 65536.0			/* Largest argument for reduction */
+#define VEC_INLINE static inline __attribute__((always_inline))
+
+/*
+   Helpers are always inlined, so wide vector arguments never cross an ABI
+   boundary. GCC still notes the vector ABI change for them. The note is not
+   a warning and ignores diagnostic pragmas, so the Makefile gives GCC
+   -Wno-psabi for this file.
+ */
+
+typedef double vd __attribute__((vector_size(8 * VEC_W)));
+typedef long long vl __attribute__((vector_size(8 * VEC_W)));
+
+/* Instruction sets for the vector kernels */
+enum VecIsa {VecOff, VecSSE2, VecAVX2, VecAVX512};
+
+static enum VecIsa vec_isa;
+static pthread_once_t vec_once = PTHREAD_ONCE_INIT;
+
+/*
+   Choose the instruction set for vector kernels. Environment variable
+   GEOG_VEC, if set to off, sse2, avx2, or avx512, lowers the choice.
+ */
+
+static void vec_init(void)
+{
+    char *s;
+
+    __builtin_cpu_init();
+    vec_isa = __builtin_cpu_supports("avx512f") ? VecAVX512
+	: __builtin_cpu_supports("avx2") ? VecAVX2
+	: __builtin_cpu_supports("sse2") ? VecSSE2 : VecOff;
+    if ( (s = getenv("GEOG_VEC")) ) {
+	enum VecIsa isa = (strcmp(s, "sse2") == 0) ? VecSSE2
+	    : (strcmp(s, "avx2") == 0) ? VecAVX2
+	    : (strcmp(s, "avx512") == 0) ? VecAVX512 : VecOff;
+
+	vec_isa = (isa < vec_isa) ? isa : vec_isa;
+    }
+}
+
+/* Return a vector with all elements set to c */
+VEC_INLINE vd vdup(double c)
+{
+    vd v;
+    int i;
+
+    for (i = 0; i < VEC_W; i++) {
+	v[i] = c;
+    }
+    return v;
+}
+
+/* Return elements of a where mask m is set, otherwise elements of b */
+VEC_INLINE vd vsel(vl m, vd a, vd b)
+{
+    return (vd)((m & (vl)a) | (~m & (vl)b));
+}
+
+/* Return the sign bits of x */
+VEC_INLINE vl vsign(vd x)
+{
+    return (vl)x & (vl)vdup(-0.0);
+}
+
+VEC_INLINE vd vabs(vd x)
+{
+    return (vd)((vl)x & ~(vl)vdup(-0.0));
+}
+
+/* Return true if every element of mask m is set */
+VEC_INLINE int vall(vl m)
+{
+    int i;
+
+    for (i = 0; i < VEC_W; i++) {
+	if ( !m[i] ) {
+	    return 0;
+	}
+    }
+    return 1;
+}
+
+/* Square root of each element. There is no generic vector square root. */
+VEC_INLINE vd vsqrt(vd x)
+{
+    vd r;
+    int i;
+
+    for (i = 0; i < VEC_W; i++) {
+	r[i] = sqrt(x[i]);
+    }
+    return r;
+}
+
+/*
+   Load m <= VEC_W elements from p into a vector. Missing elements are
+   zero.
+ */
+
+VEC_INLINE vd vload(const double *p, size_t m)
+{
+    vd v = {0.0};
+
+    memcpy(&v, p, m * sizeof(double));
+    return v;
+}
+
+VEC_INLINE void vstore(double *p, vd v, size_t m)
+{
+    memcpy(p, &v, m * sizeof(double));
+}
+
+/* Set *s and *c to the sine and cosine of each element of x */
+VEC_INLINE void vsincos(vd x, vd *s, vd *c)
+{
+    const double two_pi = 6.36619772367581382433e-01;	/* 2 / pi */
+    const double rnd = 0x1.8p52;	/* Adding this rounds to integer */
+    const double pio2_1 = 1.57079632673412561417e+00;	/* pi / 2 in */
+    const double pio2_2 = 6.07710050630396597660e-11;	/* three parts */
+    const double pio2_3 = 2.02226624871116645580e-21;
+    const double s1 = -1.66666666666666324348e-01;	/* Sine */
+    const double s2 = 8.33333333332248946124e-03;
+    const double s3 = -1.98412698298579493134e-04;
+    const double s4 = 2.75573137070700676789e-06;
+    const double s5 = -2.50507602534068634195e-08;
+    const double s6 = 1.58969099521155010221e-10;
+    const double c1 = 4.16666666666666019037e-02;	/* Cosine */
+    const double c2 = -1.38888888888741095749e-03;
+    const double c3 = 2.48015872894767294178e-05;
+    const double c4 = -2.75573143513906633035e-07;
+    const double c5 = 2.08757232129817482790e-09;
+    const double c6 = -1.13596475577881948265e-11;
+    vd t, q, r, z, sr, cr, hz, w;
+    vl k, swap;
+
+    /* x = q pi / 2 + r, |r| <= pi / 4. Low bits of t give q mod 4. */
+    t = x * two_pi + rnd;
+    q = t - rnd;
+    k = (vl)t;
+    r = ((x - q * pio2_1) - q * pio2_2) - q * pio2_3;
+
+    z = r * r;
+    sr = r + z * r * (s1 + z * (s2 + z * (s3 + z * (s4 + z * (s5
+				    + z * s6)))));
+    hz = 0.5 * z;
+    w = 1.0 - hz;
+    cr = w + (((1.0 - w) - hz) + z * z * (c1 + z * (c2 + z * (c3 + z * (c4
+			    + z * (c5 + z * c6))))));
+
+    /* Quadrants 1 and 3 swap sine and cosine. 2 and 3 negate sine, 1 and 2
+       negate cosine. */
+    swap = -(k & 1);
+    *s = (vd)((vl)vsel(swap, cr, sr) ^ (-((k >> 1) & 1) & (vl)vdup(-0.0)));
+    *c = (vd)((vl)vsel(swap, sr, cr)
+	    ^ (-(((k + 1) >> 1) & 1) & (vl)vdup(-0.0)));
+}
+
+/* Arcsine of each element of x, which must be in [-1, 1] */
+VEC_INLINE vd vasin(vd x)
+{
+    const double pio2_hi = 1.57079632679489655800e+00;
+    const double pio2_lo = 6.12323399573676603587e-17;
+    const double ps0 = 1.66666666666666657415e-01;
+    const double ps1 = -3.25565818622400915405e-01;
+    const double ps2 = 2.01212532134862925881e-01;
+    const double ps3 = -4.00555345006794114027e-02;
+    const double ps4 = 7.91534994289814532176e-04;
+    const double ps5 = 3.47933107596021167570e-05;
+    const double qs1 = -2.40339491173441421878e+00;
+    const double qs2 = 2.02094576023350569471e+00;
+    const double qs3 = -6.88283971605453293030e-01;
+    const double qs4 = 7.70381505559019352791e-02;
+    vd ax, z, u, p, q, v;
+    vl small;
+
+    /* asin(x) = pi / 2 - 2 asin(sqrt((1 - x) / 2)) for x >= 1 / 2 */
+    ax = vabs(x);
+    small = (ax < 0.5);
+    z = vsel(small, ax * ax, 0.5 * (1.0 - ax));
+    u = vsel(small, ax, vsqrt(z));
+    p = z * (ps0 + z * (ps1 + z * (ps2 + z * (ps3 + z * (ps4 + z * ps5)))));
+    q = 1.0 + z * (qs1 + z * (qs2 + z * (qs3 + z * qs4)));
+    v = u + u * (p / q);
+    v = vsel(small, v, pio2_hi - (2.0 * v - pio2_lo));
+    return (vd)((vl)v | vsign(x));
+}
+
+/* Arc tangent of y / x for each element, in the quadrant of (x, y) */
+VEC_INLINE vd vatan2(vd y, vd x)
+{
+    const double pio4_hi = 7.85398163397448278999e-01;
+    const double pio4_lo = 3.06161699786838301793e-17;
+    const double pio2_hi = 1.57079632679489655800e+00;
+    const double pio2_lo = 6.12323399573676603587e-17;
+    const double pi_hi = 3.14159265358979311600e+00;
+    const double pi_lo = 1.22464679914735317720e-16;
+    const double p0 = -8.750608600031904122785e-01;
+    const double p1 = -1.615753718733365076637e+01;
+    const double p2 = -7.500855792314704667340e+01;
+    const double p3 = -1.228866684490136173410e+02;
+    const double p4 = -6.485021904942025371773e+01;
+    const double q0 = 2.485846490142306297962e+01;
+    const double q1 = 1.650270098316988542046e+02;
+    const double q2 = 4.328810604912902668951e+02;
+    const double q3 = 4.853903996359136964868e+02;
+    const double q4 = 1.945506571482613964425e+02;
+    vd ax, ay, mn, mx, u, z, r, c_hi, c_lo, b_hi, b_lo;
+    vl swap, neg, big, flip;
+
+    /*
+       Reduce to atan(u), |u| <= 0.66, with atan(t) = pi / 4
+       + atan((t - 1) / (t + 1)) for t = mn / mx > 0.66. Result is
+       c + (b + atan(u)) or c - (b + atan(u)), where c is 0, pi / 2, or pi.
+     */
+
+    ax = vabs(x);
+    ay = vabs(y);
+    swap = (ay > ax);
+    neg = ((vl)x >> 63);
+    mn = vsel(swap, ax, ay);
+    mx = vsel(swap, ay, ax);
+    mx = vsel(mx == 0.0, vdup(1.0), mx);
+    big = (mn > 0.66 * mx);
+    u = vsel(big, mn - mx, mn) / vsel(big, mn + mx, mx);
+    z = u * u;
+    r = u + u * z * ((((p0 * z + p1) * z + p2) * z + p3) * z + p4)
+	/ (((((z + q0) * z + q1) * z + q2) * z + q3) * z + q4);
+    b_hi = vsel(big, vdup(pio4_hi), vdup(0.0));
+    b_lo = vsel(big, vdup(pio4_lo), vdup(0.0));
+    c_hi = vsel(swap, vdup(pio2_hi), vsel(neg, vdup(pi_hi), vdup(0.0)));
+    c_lo = vsel(swap, vdup(pio2_lo), vsel(neg, vdup(pi_lo), vdup(0.0)));
+    flip = (swap ^ neg) & (vl)vdup(-0.0);
+    r = (c_hi + (vd)((vl)b_hi ^ flip))
+	+ (c_lo + (vd)((vl)(b_lo + r) ^ flip));
+    return (vd)((vl)r ^ vsign(y));
+}
+
+/* True for each element of x that vsincos can reduce */
+VEC_INLINE vl vok(vd x)
+{
+    return (vabs(x) <= VEC_MAX);
+}
+
+VEC_INLINE void dist_vec(const double *o1, const double *a1,
+	const double *o2, const double *a2, double *d, size_t n)
+{
+    size_t i, m;
+
+    for (i = 0; i < n; i += m) {
+	vd vo1, va1, vo2, va2, so, sa, c1, c2, t, h;
+
+	m = (n - i < VEC_W) ? n - i : VEC_W;
+	vo1 = vload(o1 + i, m);
+	va1 = vload(a1 + i, m);
+	vo2 = vload(o2 + i, m);
+	va2 = vload(a2 + i, m);
+	if ( !vall(vok(vo1) & vok(va1) & vok(vo2) & vok(va2)) ) {
+	    size_t j;
+
+	    for (j = i; j < i + m; j++) {
+		d[j] = GeogDist(o1[j], a1[j], o2[j], a2[j]);
+	    }
+	    continue;
+	}
+	vsincos(0.5 * (vo2 - vo1), &so, &t);
+	vsincos(0.5 * (va2 - va1), &sa, &t);
+	vsincos(va1, &t, &c1);
+	vsincos(va2, &t, &c2);
+	h = vsqrt(sa * sa + c1 * c2 * so * so);
+	t = vsel(h > 1.0, vdup(M_PI), 2.0 * vasin(vsel(h > 1.0, vdup(1.0), h)));
+	vstore(d + i, t, m);
+    }
+}
+
+VEC_INLINE void az_vec(const double *o1, const double *a1,
+	const double *o2, const double *a2, double *az, size_t n)
+{
+    size_t i, m;
+
+    for (i = 0; i < n; i += m) {
+	vd vo1, va1, vo2, va2, sin_da, sin_sa, cos_a2, sin_do, cos_do, x, y, t;
+
+	m = (n - i < VEC_W) ? n - i : VEC_W;
+	vo1 = vload(o1 + i, m);
+	va1 = vload(a1 + i, m);
+	vo2 = vload(o2 + i, m);
+	va2 = vload(a2 + i, m);
+	if ( !vall(vok(vo1) & vok(va1) & vok(vo2) & vok(va2)) ) {
+	    size_t j;
+
+	    for (j = i; j < i + m; j++) {
+		az[j] = GeogAz(o1[j], a1[j], o2[j], a2[j]);
+	    }
+	    continue;
+	}
+	vsincos(va1 - va2, &sin_da, &t);
+	vsincos(va2 + va1, &sin_sa, &t);
+	vsincos(va2, &t, &cos_a2);
+	vsincos(vo2 - vo1, &sin_do, &cos_do);
+	y = cos_a2 * sin_do;
+	x = 0.5 * (sin_sa - sin_da - (sin_sa + sin_da) * cos_do);
+	vstore(az + i, vatan2(y, x), m);
+    }
+}
+
+VEC_INLINE void step_vec(const double *o1, const double *a1,
+	const double *d, const double *s, double *o2, double *a2, size_t n)
+{
+    const double two_pi = 2.0 * M_PI;
+    size_t i, m;
+
+    for (i = 0; i < n; i += m) {
+	vd vo1, va1, vdir, vdist;
+	vd sin_s, sin_d, cos_d, sin_p, cos_p, sin_m, cos_m, a, x, y, l, t;
+
+	m = (n - i < VEC_W) ? n - i : VEC_W;
+	vo1 = vload(o1 + i, m);
+	va1 = vload(a1 + i, m);
+	vdir = vload(d + i, m);
+	vdist = vload(s + i, m);
+	if ( !vall((vabs(vo1) <= two_pi) & vok(va1) & vok(vdir) & vok(vdist)
+		    & vok(va1 + vdist) & vok(va1 - vdist)) ) {
+	    size_t j;
+
+	    for (j = i; j < i + m; j++) {
+		GeogStep(o1[j], a1[j], d[j], s[j], o2 + j, a2 + j);
+	    }
+	    continue;
+	}
+	vsincos(vdist, &sin_s, &t);
+	vsincos(vdir, &sin_d, &cos_d);
+	vsincos(va1 + vdist, &sin_p, &cos_p);
+	vsincos(va1 - vdist, &sin_m, &cos_m);
+	a = 0.5 * (sin_p * (1.0 + cos_d) + sin_m * (1.0 - cos_d));
+	y = sin_s * sin_d;
+	x = 0.5 * (cos_p * (1 + cos_d) + cos_m * (1 - cos_d));
+	a = vsel(a > 1.0, vdup(1.0), vsel(a < -1.0, vdup(-1.0), a));
+
+	/* Same as GeogLonR(o1 + dlon, 0.0) for |o1 + dlon| < 4 pi */
+	l = vo1 + vatan2(y, x);
+	l = vsel(l >= two_pi, l - two_pi, vsel(l <= -two_pi, l + two_pi, l));
+	l = vsel(l < -M_PI, l + two_pi, vsel(l >= M_PI, l - two_pi, l));
+	vstore(o2 + i, l + 0.0, m);
+	vstore(a2 + i, vasin(a), m);
+    }
+}
+
+/*
+   Compile the kernels for each instruction set. Functions inlined into
+   these are compiled with the caller's instruction set.
+ */
+
+static void dist_sse2(const double *o1, const double *a1, const double *o2,
+	const double *a2, double *d, size_t n)
+{
+    dist_vec(o1, a1, o2, a2, d, n);
+}
+
+__attribute__((target("avx2")))
+static void dist_avx2(const double *o1, const double *a1, const double *o2,
+	const double *a2, double *d, size_t n)
+{
+    dist_vec(o1, a1, o2, a2, d, n);
+}
+
+__attribute__((target("avx512f")))
+static void dist_avx512(const double *o1, const double *a1, const double *o2,
+	const double *a2, double *d, size_t n)
+{
+    dist_vec(o1, a1, o2, a2, d, n);
+}
+
+static void az_sse2(const double *o1, const double *a1, const double *o2,
+	const double *a2, double *az, size_t n)
+{
+    az_vec(o1, a1, o2, a2, az, n);
+}
+
+__attribute__((target("avx2")))
+static void az_avx2(const double *o1, const double *a1, const double *o2,
+	const double *a2, double *az, size_t n)
+{
+    az_vec(o1, a1, o2, a2, az, n);
+}
+
+__attribute__((target("avx512f")))
+static void az_avx512(const double *o1, const double *a1, const double *o2,
+	const double *a2, double *az, size_t n)
+{
+    az_vec(o1, a1, o2, a2, az, n);
+}
+
+static void step_sse2(const double *o1, const double *a1, const double *d,
+	const double *s, double *o2, double *a2, size_t n)
+{
+    step_vec(o1, a1, d, s, o2, a2, n);
+}
+
+__attribute__((target("avx2")))
+static void step_avx2(const double *o1, const double *a1, const double *d,
+	const double *s, double *o2, double *a2, size_t n)
+{
+    step_vec(o1, a1, d, s, o2, a2, n);
+}
+
+__attribute__((target("avx512f")))
+static void step_avx512(const double *o1, const double *a1, const double *d,
+	const double *s, double *o2, double *a2, size_t n)
+{
+    step_vec(o1, a1, d, s, o2, a2, n);
+}
+
+#endif
+
+void GeogDistN(const double *o1, const double *a1, const double *o2,
+	const double *a2, double *d, const size_t n)
+{
+    size_t i;
+
+#ifdef VEC_W
+    pthread_once(&vec_once, vec_init);
+    switch (vec_isa) {
+	case VecAVX512:
+	    dist_avx512(o1, a1, o2, a2, d, n);
+	    return;
+	case VecAVX2:
+	    dist_avx2(o1, a1, o2, a2, d, n);
+	    return;
+	case VecSSE2:
+	    dist_sse2(o1, a1, o2, a2, d, n);
+	    return;
+	case VecOff:
+	    break;
+    }
+#endif
+    for (i = 0; i < n; i++) {
+	d[i] = GeogDist(o1[i], a1[i], o2[i], a2[i]);
+    }
+}
+
+void GeogAzN(const double *o1, const double *a1, const double *o2,
+	const double *a2, double *az, const size_t n)
+{
+    size_t i;
+
+#ifdef VEC_W
+    pthread_once(&vec_once, vec_init);
+    switch (vec_isa) {
+	case VecAVX512:
+	    az_avx512(o1, a1, o2, a2, az, n);
+	    return;
+	case VecAVX2:
+	    az_avx2(o1, a1, o2, a2, az, n);
+	    return;
+	case VecSSE2:
+	    az_sse2(o1, a1, o2, a2, az, n);
+	    return;
+	case VecOff:
+	    break;
+    }
+#endif
+    for (i = 0; i < n; i++) {
+	az[i] = GeogAz(o1[i], a1[i], o2[i], a2[i]);
+    }
+}
+
+void GeogStepN(const double *o1, const double *a1, const double *d,
+	const double *s, double *o2, double *a2, const size_t n)
+{
+    size_t i;
+
+#ifdef VEC_W
+    pthread_once(&vec_once, vec_init);
+    switch (vec_isa) {
+	case VecAVX512:
+	    step_avx512(o1, a1, d, s, o2, a2, n);
+	    return;
+	case VecAVX2:
+	    step_avx2(o1, a1, d, s, o2, a2, n);
+	    return;
+	case VecSSE2:
+	    step_sse2(o1, a1, d, s, o2, a2, n);
+	    return;
+	case VecOff:
+	    break;
+    }
+#endif
+    for (i = 0; i < n; i++) {
+	GeogStep(o1[i], a1[i], d[i], s[i], o2 + i, a2 + i);
+    }
+}
+
+/*
+   Store trigonometric functions of the coordinates of the n points at pts
+   in tpts.
+ */
+
+void GeogTrigPtInit(const struct GeogPt *pts, struct GeogTrigPt *tpts,
+	size_t n)
+{
+    size_t i;
+
+    /* Full angle values come from the double angle identities */
+    for (i = 0; i < n; i++) {
+	double c_hlat = cos(0.5 * pts[i].lat), s_hlat = sin(0.5 * pts[i].lat);
+	double c_hlon = cos(0.5 * pts[i].lon), s_hlon = sin(0.5 * pts[i].lon);
+
+	tpts[i].cos_hlat = c_hlat;
+	tpts[i].sin_hlat = s_hlat;
+	tpts[i].cos_hlon = c_hlon;
+	tpts[i].sin_hlon = s_hlon;
+	tpts[i].cos_lat = 1.0 - 2.0 * s_hlat * s_hlat;
+	tpts[i].sin_lat = 2.0 * s_hlat * c_hlat;
+	tpts[i].cos_lon = 1.0 - 2.0 * s_hlon * s_hlon;
+	tpts[i].sin_lon = 2.0 * s_hlon * c_hlon;
+    }
+}
+
+/*
+   Distance matrix. Columns are processed in tiles of DM_TILE points, which
+   stay in cache while every row passes over them.
+ */
+
+#define DM_TILE 512
+
+/*
+   Compute great circle distances from each of the n points at a to each of
+   the m points at b. Distance from a[i] to b[j] goes to dist[i * m + j]. If
+   az is not NULL, azimuth from a[i] to b[j] goes to az[i * m + j]. Half
+   angle differences come from the angle difference identities, so the only
+   functions evaluated for each pair are sqrt, asin, and, for azimuths, atan2.
+ */
+
+void GeogDistMatrix(const struct GeogTrigPt *a, size_t n,
+	const struct GeogTrigPt *b, size_t m, double *dist, double *az)
+{
+    size_t i, j, j0, j1;
+
+    for (j0 = 0; j0 < m; j0 = j1) {
+	j1 = (m - j0 < DM_TILE) ? m : j0 + DM_TILE;
+	for (i = 0; i < n; i++) {
+	    const struct GeogTrigPt *a_i = a + i;
+	    double *d_i = dist + i * m;
+
+	    for (j = j0; j < j1; j++) {
+		const struct GeogTrigPt *b_j = b + j;
+		double s_dlat, s_dlon, h;	/* sin((lat2 - lat1) / 2),
+						   sin((lon2 - lon1) / 2),
+						   haversine term */
+
+		s_dlat = b_j->sin_hlat * a_i->cos_hlat
+		    - b_j->cos_hlat * a_i->sin_hlat;
+		s_dlon = b_j->sin_hlon * a_i->cos_hlon
+		    - b_j->cos_hlon * a_i->sin_hlon;
+		h = sqrt(s_dlat * s_dlat
+			+ a_i->cos_lat * b_j->cos_lat * s_dlon * s_dlon);
+		d_i[j] = (h > 1.0 ? M_PI : 2.0 * asin(h));
+	    }
+	    if ( az ) {
+		double *az_i = az + i * m;
+
+		for (j = j0; j < j1; j++) {
+		    const struct GeogTrigPt *b_j = b + j;
+		    double sin_dlon, cos_dlon, x, y;
+
+		    sin_dlon = b_j->sin_lon * a_i->cos_lon
+			- b_j->cos_lon * a_i->sin_lon;
+		    cos_dlon = b_j->cos_lon * a_i->cos_lon
+			+ b_j->sin_lon * a_i->sin_lon;
+		    y = b_j->cos_lat * sin_dlon;
+		    x = a_i->cos_lat * b_j->sin_lat
+			- a_i->sin_lat * b_j->cos_lat * cos_dlon;
+		    az_i[j] = atan2(y, x);
+		}
+	    }
+	}
+    }
+}
+
+/*
+   Track segments. Trigonometric functions of a block of TRACK_BLK points are
+   computed once and shared by the segments on either side of each point.
+ */
+
+#define TRACK_BLK 256
+
+/*
+   Compute the great circle distance and initial azimuth of each of the
+   n_pts - 1 segments of the track with n_pts points at pts. Distance of
+   segment i, from pts[i] to pts[i + 1], goes to dist[i]. If az is not NULL,
+   azimuth goes to az[i]. If t and speed are not NULL, t has a time for each
+   point, and dist[i] / (t[i + 1] - t[i]) goes to speed[i]. Results agree
+   with GeogDist and GeogAz to within rounding error.
+ */
+
+void GeogTrackSegments(const struct GeogPt *pts, const double *t,
+	size_t n_pts, double *dist, double *az, double *speed)
+{
+    struct GeogTrigPt tp[TRACK_BLK + 1];	/* Points i0 to i1 */
+    size_t i0, i1, i;
+
+    if ( n_pts < 2 ) {
+	return;
+    }
+    GeogTrigPtInit(pts, tp, 1);
+    for (i0 = 0; i0 + 1 < n_pts; i0 = i1) {
+	size_t n_seg = (n_pts - 1 - i0 < TRACK_BLK) ? n_pts - 1 - i0
+	    : TRACK_BLK;
+
+	i1 = i0 + n_seg;
+	GeogTrigPtInit(pts + i0 + 1, tp + 1, n_seg);
+	for (i = 0; i < n_seg; i++) {
+	    const struct GeogTrigPt *p1 = tp + i, *p2 = tp + i + 1;
+	    double s_dlat, s_dlon, h;
+
+	    s_dlat = p2->sin_hlat * p1->cos_hlat - p2->cos_hlat * p1->sin_hlat;
+	    s_dlon = p2->sin_hlon * p1->cos_hlon - p2->cos_hlon * p1->sin_hlon;
+	    h = sqrt(s_dlat * s_dlat + p1->cos_lat * p2->cos_lat
+		    * s_dlon * s_dlon);
+	    dist[i0 + i] = (h > 1.0 ? M_PI : 2.0 * asin(h));
+	}
+	if ( az ) {
+	    for (i = 0; i < n_seg; i++) {
+		const struct GeogTrigPt *p1 = tp + i, *p2 = tp + i + 1;
+		double sin_dlon, cos_dlon, x, y;
+
+		sin_dlon = p2->sin_lon * p1->cos_lon
+		    - p2->cos_lon * p1->sin_lon;
+		cos_dlon = p2->cos_lon * p1->cos_lon
+		    + p2->sin_lon * p1->sin_lon;
+		y = p2->cos_lat * sin_dlon;
+		x = p1->cos_lat * p2->sin_lat - p1->sin_lat * p2->cos_lat
+		    * cos_dlon;
+		az[i0 + i] = atan2(y, x);
+	    }
+	}
+	if ( t && speed ) {
+	    for (i = i0; i < i1; i++) {
+		double dt = t[i + 1] - t[i];
+
+		speed[i] = (dt > 0.0) ? dist[i] / dt : NAN;
+	    }
+	}
+	tp[0] = tp[n_seg];
+    }
+}
+
+/*
+   Densification. Points along a segment come from rotating a unit vector
+   by a fixed angle, which drifts slowly from unit length. It is normalized
+   every DENSIFY_RENORM steps.
+ */
+
+#define DENSIFY_RENORM 32
+
+static void densify_seg(const struct GeogPt, const struct GeogPt, size_t,
+	struct GeogPt *);
+
+/*
+   Copy the polyline with n_pts points at pts to out, inserting points evenly
+   along each great circle segment so that no segment is longer than
+   max_step radians. Input points are copied unchanged. At most n_out points
+   are stored. Return value is the number of points in the densified
+   polyline, which may exceed n_out.
+ */
+
+size_t GeogDensify(const struct GeogPt *pts, size_t n_pts, double max_step,
+	struct GeogPt *out, size_t n_out)
+{
+    size_t i, k;			/* Index in pts, out */
+    size_t n_seg;			/* Number of pieces for a segment */
+
+    for (i = 0, k = 0; i + 1 < n_pts; i++) {
+	double d = GeogDist(pts[i].lon, pts[i].lat,
+		pts[i + 1].lon, pts[i + 1].lat);
+
+	n_seg = (max_step > 0.0 && d > max_step) ? ceil(d / max_step) : 1;
+	if ( k + n_seg <= n_out ) {
+	    out[k] = pts[i];
+	    if ( n_seg > 1 ) {
+		densify_seg(pts[i], pts[i + 1], n_seg, out + k + 1);
+	    }
+	}
+	k += n_seg;
+    }
+    if ( n_pts > 0 ) {
+	if ( k < n_out ) {
+	    out[k] = pts[n_pts - 1];
+	}
+	k++;
+    }
+    return k;
+}
+
+/*
+   Store n_seg - 1 points dividing the great circle from p1 to p2 into n_seg
+   equal pieces at out.
+ */
+
+static void densify_seg(const struct GeogPt p1, const struct GeogPt p2,
+	size_t n_seg, struct GeogPt *out)
+{
+    double p[3], q[3];			/* Unit vectors for p1, p2 */
+    double nrm[3];			/* Normal to the great circle */
+    double u[3];			/* Unit vector along the great circle,
+					   perpendicular to p */
+    double len, d, c, s, t[3];
+    size_t m;
+    int i;
+
+    p[0] = cos(p1.lat) * cos(p1.lon);
+    p[1] = cos(p1.lat) * sin(p1.lon);
+    p[2] = sin(p1.lat);
+    q[0] = cos(p2.lat) * cos(p2.lon);
+    q[1] = cos(p2.lat) * sin(p2.lon);
+    q[2] = sin(p2.lat);
+    nrm[0] = p[1] * q[2] - p[2] * q[1];
+    nrm[1] = p[2] * q[0] - p[0] * q[2];
+    nrm[2] = p[0] * q[1] - p[1] * q[0];
+    len = sqrt(nrm[0] * nrm[0] + nrm[1] * nrm[1] + nrm[2] * nrm[2]);
+    d = atan2(len, p[0] * q[0] + p[1] * q[1] + p[2] * q[2]);
+    if ( len > 1.0e-15 ) {
+	u[0] = (nrm[1] * p[2] - nrm[2] * p[1]) / len;
+	u[1] = (nrm[2] * p[0] - nrm[0] * p[2]) / len;
+	u[2] = (nrm[0] * p[1] - nrm[1] * p[0]) / len;
+    } else {
+
+	/* Antipodal points. Go north. */
+	u[0] = -sin(p1.lat) * cos(p1.lon);
+	u[1] = -sin(p1.lat) * sin(p1.lon);
+	u[2] = cos(p1.lat);
+    }
+    c = cos(d / n_seg);
+    s = sin(d / n_seg);
+    for (m = 1; m < n_seg; m++) {
+	for (i = 0; i < 3; i++) {
+	    t[i] = c * p[i] + s * u[i];
+	    u[i] = c * u[i] - s * p[i];
+	    p[i] = t[i];
+	}
+	if ( m % DENSIFY_RENORM == 0 ) {
+	    double pu;
+
+	    len = sqrt(p[0] * p[0] + p[1] * p[1] + p[2] * p[2]);
+	    for (i = 0; i < 3; i++) {
+		p[i] /= len;
+	    }
+	    pu = p[0] * u[0] + p[1] * u[1] + p[2] * u[2];
+	    for (i = 0; i < 3; i++) {
+		u[i] -= pu * p[i];
+	    }
+	    len = sqrt(u[0] * u[0] + u[1] * u[1] + u[2] * u[2]);
+	    for (i = 0; i < 3; i++) {
+		u[i] /= len;
+	    }
+	}
+	out[m - 1].lon = atan2(p[1], p[0]);
+	out[m - 1].lat = atan2(p[2], sqrt(p[0] * p[0] + p[1] * p[1]));
+    }
+}
+
 /*
    Height above ground after traveling distance d along a line tilt radians
    above horizontal. a0 is radius of Earth. a0 and d must have same units, which
@@ -176,6 +985,40 @@ double GeogBeamHt(double d, double tilt, double a0)
     return sqrt(a0 * a0 + 2 * a0 * d * sin(tilt) + d * d) - a0;
 }
 
+/*
+   Update meridian crossing count *mrdx and crossing parity *lnx for point
+   pt and polygon edge p0--p1, for GeogContainPt.
+ */
+
+static void edge_crossing(const struct GeogPt pt, const struct GeogPt *p0,
+	const struct GeogPt *p1, int *mrdx, int *lnx)
+{
+    double lon0, lat0;			/* p0 */
+    double lon1, lat1;			/* p1 */
+
+    /*
+       Determine if segment defined by p0--p1 straddles meridian
+       containing geoPt, or is on boundary.  Do not count segments on
+       boundary as more than one crossing
+     */
+
+    lon0 = GeogLonR(p0->lon, pt.lon);
+    lon1 = GeogLonR(p1->lon, pt.lon);
+    if ( ( fabs(lon0 - lon1) < M_PI
+		&& (   (lon0 < pt.lon && pt.lon <= lon1)
+		    || (lon1 < pt.lon && pt.lon <= lon0))) ) {
+	double xlat;			/* Latitude of segment crossing */
+
+	(*mrdx)++;
+	lat0 = p0->lat;
+	lat1 = p1->lat;
+	xlat = lat0 + (pt.lon - lon0) * (lat1 - lat0) / (lon1 - lon0);
+	if ( xlat > pt.lat ) {
+	    *lnx = !*lnx;
+	}
+    }
+}
+
 /*
    This function returns true if polygon pts contains point at longitude lon,
    latitude lat.  pts is an array of lon0, lat0, lon1, lat1, ... values for
@@ -190,8 +1033,6 @@ int GeogContainPt(const struct GeogPt pt, const struct GeogPt *pts,
     int lnx;				/* Number of times a line crosses line
 					   from (lon, lat) to North pole */
     const struct GeogPt *p0, *p1;	/* Points from pts */
-    double lon0, lat0;			/* p0 */
-    double lon1, lat1;			/* p1 */
     double z;				/* Distance along Earth's axis, from
 					   center of Earth */
 
@@ -203,29 +1044,7 @@ int GeogContainPt(const struct GeogPt pt, const struct GeogPt *pts,
 
     for (mrdx = lnx = 0, p0 = pts + n_pts - 1, p1 = pts;
 	    p1 < pts + n_pts; p0 = p1++) {
-
-	/*
-	   Determine if segment defined by p0--p1 straddles meridian
-	   containing geoPt, or is on boundary.  Do not count segments on
-	   boundary as more than one crossing
-	 */
-
-	lon0 = GeogLonR(p0->lon, pt.lon);
-	lon1 = GeogLonR(p1->lon, pt.lon);
-	if ( ( fabs(lon0 - lon1) < M_PI
-		    && (   (lon0 < pt.lon && pt.lon <= lon1)
-			|| (lon1 < pt.lon && pt.lon <= lon0))) ) {
-	    double xlat;		/* Latitude of segment crossing */
-
-	    mrdx++;
-	    lat0 = p0->lat;
-	    lat1 = p1->lat;
-	    xlat = lat0 + (pt.lon - lon0) * (lat1 - lat0) / (lon1 - lon0);
-	    if ( xlat > pt.lat ) {
-		lnx = !lnx;
-	    }
-
-	}
+	edge_crossing(pt, p0, p1, &mrdx, &lnx);
     }
 
     if ( mrdx % 2 == 1 ) {
@@ -245,3 +1064,228 @@ int GeogContainPt(const struct GeogPt pt, const struct GeogPt *pts,
     }
     return lnx;
 }
+
+/*
+   Margin, in radians, added to the longitude span of each edge when
+   assigning it to slabs. It covers rounding in GeogLonR, so that an edge
+   that GeogContainPt would count for a point is always in the point's slab.
+ */
+
+#define SLAB_MARGIN 1.0e-9
+
+/*
+   Maximum number of slabs, and maximum average number of slabs per edge.
+ */
+
+#define SLAB_MAX (1 << 20)
+#define SLAB_PER_EDGE 8
+
+/*
+   Compute the longitude span [*w, *e] of edge p0--p1, with *w in [-M_PI,
+   M_PI). *e may exceed M_PI. Return false if the edge can never cross a
+   meridian in GeogContainPt, or if its direction is ambiguous, in which
+   case the span is the whole circle.
+ */
+
+static int edge_span(const struct GeogPt *p0, const struct GeogPt *p1,
+	double *w, double *e)
+{
+    double lon0, d;
+
+    lon0 = GeogLonR(p0->lon, 0.0);
+    d = GeogLonDiff(p1->lon, lon0);
+    if ( !(fabs(d) < M_PI - 1.0e-6) ) {
+	*w = -M_PI;
+	*e = M_PI;
+	return 0;
+    }
+    *w = GeogLonR(((d < 0.0) ? lon0 + d : lon0) - SLAB_MARGIN, 0.0);
+    *e = *w + fabs(d) + 2 * SLAB_MARGIN;
+    return 1;
+}
+
+/* Return index of slab containing longitude lon in [-M_PI, M_PI) */
+static size_t slab_idx(double lon, size_t n_slab)
+{
+    double s = (lon + M_PI) / (2.0 * M_PI) * n_slab;
+
+    return (s <= 0.0) ? 0 : (s >= n_slab) ? n_slab - 1 : (size_t)s;
+}
+
+/*
+   Call fn for each slab overlapped by the longitude span of edge
+   p0--p1. Edges with zero length, which never cross a meridian, are
+   skipped.
+ */
+
+static void edge_slabs(const struct GeogPt *p0, const struct GeogPt *p1,
+	size_t n_slab, void (*fn)(size_t, void *), void *arg)
+{
+    double w, e;
+    size_t i, i0, i1;
+
+    if ( p0->lon == p1->lon || isnan(p0->lon) || isnan(p1->lon) ) {
+	return;
+    }
+    if ( !edge_span(p0, p1, &w, &e) ) {
+	for (i = 0; i < n_slab; i++) {
+	    fn(i, arg);
+	}
+	return;
+    }
+    i0 = slab_idx(w, n_slab);
+    if ( e < M_PI ) {
+	i1 = slab_idx(e, n_slab);
+	for (i = i0; i <= i1; i++) {
+	    fn(i, arg);
+	}
+    } else {
+	i1 = slab_idx(e - 2.0 * M_PI, n_slab);
+	for (i = i0; i < n_slab; i++) {
+	    fn(i, arg);
+	}
+	for (i = 0; i <= i1 && i < i0; i++) {
+	    fn(i, arg);
+	}
+    }
+}
+
+/* Callbacks for edge_slabs */
+static void count_edge(size_t i, void *arg)
+{
+    size_t *cnt = arg;
+
+    cnt[i]++;
+}
+
+struct store_edge_arg {
+    struct GeogPreparedPolygon *poly;
+    size_t *nxt;			/* Next free edge in each slab */
+    const struct GeogPt *p0, *p1;	/* Edge to store */
+};
+
+static void store_edge(size_t i, void *arg)
+{
+    struct store_edge_arg *sa = arg;
+    size_t k = sa->nxt[i]++;
+
+    sa->poly->seg[2 * k] = *sa->p0;
+    sa->poly->seg[2 * k + 1] = *sa->p1;
+}
+
+/*
+   Initialize poly for polygon pts with n_pts points, which must be
+   the same as for GeogContainPt. pts may be freed afterward. Return
+   true on success, false if memory runs out.
+ */
+
+int GeogPreparedPolygonInit(struct GeogPreparedPolygon *poly,
+	const struct GeogPt *pts, const size_t n_pts)
+{
+    const struct GeogPt *p0, *p1;
+    size_t n_slab, i, tot;
+    size_t *cnt = NULL;
+    struct store_edge_arg sa;
+    double z;
+
+    poly->slab = NULL;
+    poly->seg = NULL;
+
+    /*
+       Start with about one slab per edge. Use fewer slabs if long edges
+       would be copied into too many of them.
+     */
+
+    n_slab = (n_pts < 1) ? 1 : (n_pts > SLAB_MAX) ? SLAB_MAX : n_pts;
+    for (;;) {
+	FREE(cnt);
+	if ( !(cnt = CALLOC(n_slab + 1, sizeof(size_t))) ) {
+	    return 0;
+	}
+	for (p0 = pts + n_pts - 1, p1 = pts; p1 < pts + n_pts; p0 = p1++) {
+	    edge_slabs(p0, p1, n_slab, count_edge, cnt);
+	}
+	for (i = 0, tot = 0; i < n_slab; i++) {
+	    tot += cnt[i];
+	}
+	if ( n_slab == 1 || tot <= SLAB_PER_EDGE * n_pts ) {
+	    break;
+	}
+	n_slab /= 2;
+    }
+
+    /*
+       Convert counts to offsets, then store edges.
+     */
+
+    if ( !(poly->seg = MALLOC((2 * tot + 1) * sizeof(struct GeogPt))) ) {
+	FREE(cnt);
+	return 0;
+    }
+    for (i = 0, tot = 0; i < n_slab; i++) {
+	size_t c = cnt[i];
+
+	cnt[i] = tot;
+	tot += c;
+    }
+    cnt[n_slab] = tot;
+    poly->n_slab = n_slab;
+    poly->slab = cnt;
+    if ( !(sa.nxt = MALLOC(n_slab * sizeof(size_t))) ) {
+	GeogPreparedPolygonFree(poly);
+	return 0;
+    }
+    for (i = 0; i < n_slab; i++) {
+	sa.nxt[i] = cnt[i];
+    }
+    sa.poly = poly;
+    for (p0 = pts + n_pts - 1, p1 = pts; p1 < pts + n_pts; p0 = p1++) {
+	sa.p0 = p0;
+	sa.p1 = p1;
+	edge_slabs(p0, p1, n_slab, store_edge, &sa);
+    }
+    FREE(sa.nxt);
+
+    /*
+       Hemisphere of polygon mean, as in GeogContainPt.
+     */
+
+    for (p0 = pts, z = 0.0; p0 < pts + n_pts; p0++) {
+	z += sin(p0->lat);
+    }
+    poly->north = z > 0.0;
+    return 1;
+}
+
+/*
+   Return true if polygon poly contains point pt. The result is the same
+   as GeogContainPt for the polygon used to initialize poly.
+ */
+
+int GeogContainPtPrepared(const struct GeogPt pt,
+	const struct GeogPreparedPolygon *poly)
+{
+    int mrdx, lnx;
+    const struct GeogPt *p, *e;
+    size_t i;
+
+    i = slab_idx(GeogLonR(pt.lon, 0.0), poly->n_slab);
+    p = poly->seg + 2 * poly->slab[i];
+    e = poly->seg + 2 * poly->slab[i + 1];
+    for (mrdx = lnx = 0; p < e; p += 2) {
+	edge_crossing(pt, p, p + 1, &mrdx, &lnx);
+    }
+    if ( mrdx % 2 == 1 && poly->north ) {
+	lnx = !lnx;
+    }
+    return lnx;
+}
+
+/* Release memory allocated by GeogPreparedPolygonInit */
+void GeogPreparedPolygonFree(struct GeogPreparedPolygon *poly)
+{
+    FREE(poly->slab);
+    FREE(poly->seg);
+    poly->slab = NULL;
+    poly->seg = NULL;
+}
@@ -66,8 +66,33 @@ struct GeogPt {
     double lat;			/* Latitude, radians */
 };
 
+/*
+   A geographic point with trigonometric functions of its coordinates, for
+   GeogDistMatrix.
+ */
+
+struct GeogTrigPt {
+    double cos_lat, sin_lat;	/* Cosine, sine of latitude */
+    double cos_hlat, sin_hlat;	/* Cosine, sine of half latitude */
+    double cos_hlon, sin_hlon;	/* Cosine, sine of half longitude */
+    double cos_lon, sin_lon;	/* Cosine, sine of longitude */
+};
+
+/*
+   Context for calculations that depend on the size of the Earth. Each
+   thread or projection can have its own. Clients should not refer to
+   members directly.
+ */
+
+struct GeogCtx {
+    double r_earth;		/* Earth radius */
+};
+
 void GeogDMS(double, double *, double  *, double *, char *);
 double GeogREarth(const double *);
+void GeogCtxInit(struct GeogCtx *);
+void GeogCtxSetREarth(struct GeogCtx *, double);
+double GeogCtxREarth(const struct GeogCtx *);
 double GeogLonR(const double, const double);
 double GeogLonDiff(const double, const double);
 double GeogLatN(const double);
@@ -75,7 +100,43 @@ double GeogDist(const double, const double, const double, const double);
 double GeogAz(const double, const double, const double, const double);
 void GeogStep(const double, const double, const double, const double,
 	double *, double *);
+void GeogDistN(const double *, const double *, const double *, const double *,
+	double *, const size_t);
+void GeogAzN(const double *, const double *, const double *, const double *,
+	double *, const size_t);
+void GeogStepN(const double *, const double *, const double *, const double *,
+	double *, double *, const size_t);
+void GeogTrigPtInit(const struct GeogPt *, struct GeogTrigPt *, size_t);
+void GeogDistMatrix(const struct GeogTrigPt *, size_t,
+	const struct GeogTrigPt *, size_t, double *, double *);
+void GeogTrackSegments(const struct GeogPt *, const double *, size_t,
+	double *, double *, double *);
+size_t GeogDensify(const struct GeogPt *, size_t, double, struct GeogPt *,
+	size_t);
 double GeogBeamHt(double, double, double);
 int GeogContainPt(const struct GeogPt, const struct GeogPt *, const size_t);
 
+/*
+   A polygon prepared for many calls to GeogContainPtPrepared. Edges are
+   sorted into slabs of longitude, so that a point is only tested against
+   edges whose longitude span might include it. Clients should not refer to
+   members directly.
+ */
+
+struct GeogPreparedPolygon {
+    size_t n_slab;		/* Number of longitude slabs */
+    size_t *slab;		/* Edges in slab i are seg[2 * slab[i]] to
+				   seg[2 * slab[i + 1]], n_slab + 1 values */
+    struct GeogPt *seg;		/* End points of edges, two per edge */
+    int north;			/* If true, a polygon crossed by an odd
+				   number of meridians contains the North
+				   Pole, otherwise the South Pole */
+};
+
+int GeogPreparedPolygonInit(struct GeogPreparedPolygon *,
+	const struct GeogPt *, const size_t);
+int GeogContainPtPrepared(const struct GeogPt,
+	const struct GeogPreparedPolygon *);
+void GeogPreparedPolygonFree(struct GeogPreparedPolygon *);
+
 #endif
@@ -0,0 +1,683 @@
+/*
+   -	geog_par.c --
+   -		This file defines functions that apply a transformation
+   -		to blocks of input on several threads.  See geog_par (3).
+   -
+   .	Copyright (c) 2014, Gordon D. Carrie. All rights reserved.
+   .
+   .	Redistribution and use in source and binary forms, with or without
+   .	modification, are permitted provided that the following conditions
+   .	are met:
+   .
+   .	    * Redistributions of source code must retain the above copyright
+   .	    notice, this list of conditions and the following disclaimer.
+   .
+   .	    * Redistributions in binary form must reproduce the above copyright
+   .	    notice, this list of conditions and the following disclaimer in the
+   .	    documentation and/or other materials provided with the distribution.
+   .
+   .	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   .	"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   .	LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   .	A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+   .	HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+   .	SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+   .	TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   .	PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   .	LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   .	NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   .	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+   .
+   .	Please send feedback to dev0@trekix.net
+   .
+   .	$Revision: $ $Date: $
+ */
+
+
+#include "unix_defs.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include "alloc.h"
+#include "geog_io.h"
+#include "geog_par.h"
+
+/*
+   Approximate size of a block of input given to one call of a GeogParFn.
+   Input from a file descriptor is read in blocks of this size.
+ */
+#define BLK_SZ (1 << 22)
+
+/* Initial size of the scratch arena for each thread */
+#define SCRATCH_SZ (1 << 16)
+
+/*
+   A block of input and the output made from it. Blocks are numbered in
+   input order. Block k lives in slot k % n_slot.
+ */
+
+struct slot {
+    const char *p;			/* Input */
+    size_t n;				/* Number of bytes at p */
+    char *buf;				/* Input read from a file descriptor */
+    size_t buf_sz;			/* Allocation at buf */
+    struct GeogOut out;			/* Output for this block */
+    int done;				/* If true, out is complete */
+};
+
+/*
+   State shared by the producer, workers, and writer. Members below mtx are
+   protected by mtx. The condition is broadcast whenever any of them change.
+ */
+
+struct job {
+    GeogParFn *fn;			/* Transformation */
+    void *arg;				/* Client data for fn */
+    size_t rec_sz;			/* Record size, or 0 for lines of text */
+    const char *p, *e;			/* Unread input in memory */
+    int fd;				/* File descriptor for input, or -1 */
+    int in_eof;				/* If true, fd has no more data */
+    size_t n_rd;			/* Bytes read from fd */
+    char *carry;			/* Input from fd after the end of the
+					   last block */
+    size_t n_carry;			/* Number of bytes at carry */
+    size_t carry_sz;			/* Allocation at carry */
+    struct slot *slots;
+    size_t n_slot;			/* Number of slots */
+    pthread_mutex_t mtx;
+    pthread_cond_t cond;
+    size_t n_filled;			/* Number of blocks produced */
+    size_t n_taken;			/* Number of blocks taken by workers */
+    size_t n_written;			/* Number of blocks written */
+    int eof;				/* If true, n_filled is final */
+    int err;				/* If true, something failed */
+};
+
+static int next_blk(struct job *, struct slot *);
+static int read_blk(struct job *, struct slot *);
+static int grow(char **, size_t *, size_t);
+static void *producer(void *);
+static void *worker(void *);
+
+/*
+   State for GeogParRange. Block k covers items k * blk to (k + 1) * blk - 1,
+   and its output lives in outs[k % n_slot]. Members below mtx are protected
+   by mtx.
+ */
+
+struct range_job {
+    GeogParRangeFn *fn;			/* Function for a block of items */
+    void *arg;				/* Client data for fn */
+    size_t n;				/* Number of items */
+    size_t blk;				/* Number of items in a block */
+    size_t n_blk;			/* Number of blocks */
+    struct GeogOut *outs;		/* Output for blocks in progress */
+    int *done;				/* If done[s], outs[s] is complete */
+    size_t n_slot;			/* Number of elements in outs, done */
+    pthread_mutex_t mtx;
+    pthread_cond_t cond;
+    size_t n_taken;			/* Number of blocks taken by workers */
+    size_t n_written;			/* Number of blocks written */
+    int err;				/* If true, something failed */
+};
+
+static void *range_worker(void *);
+
+/*
+   Each thread that calls a GeogParFn or GeogParRangeFn has a scratch arena,
+   found with scratch_key. The arena is reset after each block, so its
+   blocks are reused for the rest of the run.
+ */
+
+static pthread_key_t scratch_key;
+static pthread_once_t scratch_once = PTHREAD_ONCE_INIT;
+static int scratch_ok;			/* If true, scratch_key exists */
+static void scratch_init(void);
+static struct Tkx_Arena *scratch_start(void);
+static void scratch_end(struct Tkx_Arena *);
+
+/*
+   Apply fn to all input from in, dividing the input into blocks processed by
+   n_thr threads, and write output to out in input order. Blocks end at a
+   record boundary if rec_sz is not zero, or after a newline otherwise, so a
+   text record must not span lines. If in reads a file descriptor, a reader
+   thread fills the blocks, so reading overlaps conversion and output. If
+   n_thr is less than 2, fn is simply applied to in on the calling thread.
+   Return true on success.
+ */
+
+int GeogParRun(struct GeogIn *in, size_t rec_sz, int n_thr, GeogParFn *fn,
+	void *arg, struct GeogOut *out)
+{
+    struct job job;
+    pthread_t prod, *wrks;
+    int n_wrk;				/* Number of workers started */
+    size_t k, i;
+    int prod_started = 0;
+    int ok;
+
+    if ( n_thr < 2 ) {
+	struct Tkx_Arena *scratch = scratch_start();
+
+	ok = scratch && fn(in, out, arg);
+	scratch_end(scratch);
+	return ok;
+    }
+    job.fn = fn;
+    job.arg = arg;
+    job.rec_sz = rec_sz;
+    job.p = in->p;
+    job.e = in->e;
+    job.fd = in->fd;
+    job.in_eof = in->eof;
+    job.n_rd = 0;
+    job.carry = NULL;
+    job.n_carry = job.carry_sz = 0;
+    if ( job.fd != -1 && job.e > job.p ) {
+
+	/* Start with input already in the buffer for in */
+	job.n_carry = job.e - job.p;
+	if ( !grow(&job.carry, &job.carry_sz, job.n_carry) ) {
+	    fprintf(stderr, "Could not allocate input buffer for threads.\n");
+	    return 0;
+	}
+	memcpy(job.carry, job.p, job.n_carry);
+    }
+    job.n_slot = 2 * (size_t)n_thr;
+    job.n_filled = job.n_taken = job.n_written = 0;
+    job.eof = job.err = 0;
+    if ( !(job.slots = CALLOC(job.n_slot, sizeof(struct slot))) ) {
+	fprintf(stderr, "Could not allocate blocks for threads.\n");
+	FREE(job.carry);
+	return 0;
+    }
+    if ( !(wrks = CALLOC(n_thr, sizeof(pthread_t))) ) {
+	fprintf(stderr, "Could not allocate threads.\n");
+	FREE(job.slots);
+	FREE(job.carry);
+	return 0;
+    }
+    for (i = 0; i < job.n_slot; i++) {
+	if ( !GeogOutInit(&job.slots[i].out, -1) ) {
+	    fprintf(stderr, "Could not allocate output for threads.\n");
+	    job.err = 1;
+	    job.n_slot = i;
+	    goto done;
+	}
+    }
+    pthread_mutex_init(&job.mtx, NULL);
+    pthread_cond_init(&job.cond, NULL);
+    if ( pthread_create(&prod, NULL, producer, &job) != 0 ) {
+	fprintf(stderr, "Could not start input thread.\n");
+	job.err = 1;
+    } else {
+	prod_started = 1;
+    }
+    for (n_wrk = 0; !job.err && n_wrk < n_thr; n_wrk++) {
+	if ( pthread_create(wrks + n_wrk, NULL, worker, &job) != 0 ) {
+	    fprintf(stderr, "Could not start worker thread.\n");
+	    pthread_mutex_lock(&job.mtx);
+	    job.err = 1;
+	    pthread_cond_broadcast(&job.cond);
+	    pthread_mutex_unlock(&job.mtx);
+	    break;
+	}
+    }
+
+    /*
+       Write blocks in order as they complete.
+     */
+
+    for (k = 0; ; k++) {
+	struct slot *slot = job.slots + k % job.n_slot;
+
+	pthread_mutex_lock(&job.mtx);
+	while ( !job.err && !(k < job.n_filled && slot->done)
+		&& !(job.eof && k >= job.n_filled) ) {
+	    pthread_cond_wait(&job.cond, &job.mtx);
+	}
+	if ( job.err || k >= job.n_filled ) {
+	    pthread_mutex_unlock(&job.mtx);
+	    break;
+	}
+	pthread_mutex_unlock(&job.mtx);
+	ok = !slot->out.err && GeogOutMem(out, slot->out.buf, slot->out.len);
+	slot->out.len = 0;
+	pthread_mutex_lock(&job.mtx);
+	if ( !ok ) {
+	    job.err = 1;
+	}
+	slot->done = 0;
+	job.n_written = k + 1;
+	pthread_cond_broadcast(&job.cond);
+	pthread_mutex_unlock(&job.mtx);
+    }
+    for (i = 0; i < (size_t)n_wrk; i++) {
+	pthread_join(wrks[i], NULL);
+    }
+    if ( prod_started ) {
+	pthread_join(prod, NULL);
+    }
+    pthread_cond_destroy(&job.cond);
+    pthread_mutex_destroy(&job.mtx);
+
+done:
+    for (i = 0; i < job.n_slot; i++) {
+	GeogOutFree(&job.slots[i].out);
+	FREE(job.slots[i].buf);
+    }
+    FREE(wrks);
+    FREE(job.carry);
+    FREE(job.slots);
+    in->n_rd += job.n_rd;
+    return !job.err;
+}
+
+/*
+   Point slot to the next block of input in memory. Return 1 if there is a
+   block, 0 at end of input, or -1 on failure.
+ */
+
+static int next_blk(struct job *job, struct slot *slot)
+{
+    const char *e;
+
+    if ( job->fd != -1 ) {
+	return read_blk(job, slot);
+    }
+    if ( job->p == job->e ) {
+	return 0;
+    }
+    if ( (size_t)(job->e - job->p) <= BLK_SZ ) {
+	e = job->e;
+    } else if ( job->rec_sz > 0 ) {
+	e = job->p + BLK_SZ / job->rec_sz * job->rec_sz;
+    } else {
+	e = memchr(job->p + BLK_SZ, '\n', job->e - job->p - BLK_SZ);
+	e = e ? e + 1 : job->e;
+    }
+    slot->p = job->p;
+    slot->n = e - job->p;
+    job->p = e;
+    return 1;
+}
+
+/*
+   Read the next block of input from the file descriptor into the buffer for
+   slot. The block starts with input left over from the previous block, and
+   ends at the last complete record or line. The rest is kept for the next
+   block. Return 1 if there is a block, 0 at end of input, or -1 on failure.
+ */
+
+static int read_blk(struct job *job, struct slot *slot)
+{
+    size_t len;				/* Number of bytes in slot->buf */
+    size_t n;				/* Number of bytes in block */
+    ssize_t r;
+
+    if ( !grow(&slot->buf, &slot->buf_sz, job->n_carry + BLK_SZ) ) {
+	fprintf(stderr, "Could not allocate input block.\n");
+	return -1;
+    }
+    if ( job->n_carry > 0 ) {
+	memcpy(slot->buf, job->carry, job->n_carry);
+    }
+    len = job->n_carry;
+    for (;;) {
+	while ( !job->in_eof && len < slot->buf_sz ) {
+	    r = read(job->fd, slot->buf + len, slot->buf_sz - len);
+	    if ( r == -1 ) {
+		if ( errno == EINTR ) {
+		    continue;
+		}
+		perror("Could not read input");
+		return -1;
+	    }
+	    if ( r == 0 ) {
+		job->in_eof = 1;
+	    }
+	    len += r;
+	    job->n_rd += r;
+	}
+	if ( job->in_eof ) {
+	    n = len;
+	    break;
+	}
+	if ( job->rec_sz > 0 ) {
+	    n = len / job->rec_sz * job->rec_sz;
+	} else {
+	    for (n = len; n > 0 && slot->buf[n - 1] != '\n'; n--) {
+	    }
+	}
+	if ( n > 0 ) {
+	    break;
+	}
+
+	/* Line longer than buffer. Read more. */
+	if ( !grow(&slot->buf, &slot->buf_sz, 2 * slot->buf_sz) ) {
+	    fprintf(stderr, "Could not allocate input block.\n");
+	    return -1;
+	}
+    }
+    if ( len == 0 ) {
+	return 0;
+    }
+    job->n_carry = len - n;
+    if ( job->n_carry > 0 ) {
+	if ( !grow(&job->carry, &job->carry_sz, job->n_carry) ) {
+	    fprintf(stderr, "Could not allocate input block.\n");
+	    return -1;
+	}
+	memcpy(job->carry, slot->buf + n, job->n_carry);
+    }
+    slot->p = slot->buf;
+    slot->n = n;
+    return 1;
+}
+
+/*
+   Make the allocation at *buf, currently *sz bytes, at least n bytes.
+   Return true on success.
+ */
+
+static int grow(char **buf, size_t *sz, size_t n)
+{
+    char *t;
+
+    if ( n <= *sz ) {
+	return 1;
+    }
+    if ( !(t = REALLOC(*buf, n)) ) {
+	return 0;
+    }
+    *buf = t;
+    *sz = n;
+    return 1;
+}
+
+/*
+   Divide input into blocks and put them into free slots.
+ */
+
+static void *producer(void *arg)
+{
+    struct job *job = arg;
+    size_t k;
+
+    for (k = 0; ; k++) {
+	struct slot *slot = job->slots + k % job->n_slot;
+	int r;
+
+	pthread_mutex_lock(&job->mtx);
+	while ( !job->err && k >= job->n_written + job->n_slot ) {
+	    pthread_cond_wait(&job->cond, &job->mtx);
+	}
+	if ( job->err ) {
+	    pthread_mutex_unlock(&job->mtx);
+	    break;
+	}
+	pthread_mutex_unlock(&job->mtx);
+
+	/* Slot is free, since block k - n_slot has been written */
+	if ( (r = next_blk(job, slot)) != 1 ) {
+	    pthread_mutex_lock(&job->mtx);
+	    if ( r == 0 ) {
+		job->eof = 1;
+	    } else {
+		job->err = 1;
+	    }
+	    pthread_cond_broadcast(&job->cond);
+	    pthread_mutex_unlock(&job->mtx);
+	    break;
+	}
+	pthread_mutex_lock(&job->mtx);
+	job->n_filled = k + 1;
+	pthread_cond_broadcast(&job->cond);
+	pthread_mutex_unlock(&job->mtx);
+    }
+    return NULL;
+}
+
+/*
+   Apply the transformation to blocks as they become available.
+ */
+
+static void *worker(void *arg)
+{
+    struct job *job = arg;
+    struct Tkx_Arena *scratch = scratch_start();
+
+    pthread_mutex_lock(&job->mtx);
+    if ( !scratch ) {
+	job->err = 1;
+	pthread_cond_broadcast(&job->cond);
+    }
+    for (;;) {
+	struct slot *slot;
+	struct GeogIn in;
+	int ok;
+
+	while ( !job->err && job->n_taken >= job->n_filled && !job->eof ) {
+	    pthread_cond_wait(&job->cond, &job->mtx);
+	}
+	if ( job->err || job->n_taken >= job->n_filled ) {
+	    break;
+	}
+	slot = job->slots + job->n_taken++ % job->n_slot;
+	pthread_mutex_unlock(&job->mtx);
+	GeogInInitMem(&in, slot->p, slot->n);
+	ok = job->fn(&in, &slot->out, job->arg);
+	ARENA_RESET(scratch);
+	pthread_mutex_lock(&job->mtx);
+	slot->done = 1;
+	if ( !ok ) {
+	    job->err = 1;
+	}
+	pthread_cond_broadcast(&job->cond);
+    }
+    pthread_mutex_unlock(&job->mtx);
+    scratch_end(scratch);
+    return NULL;
+}
+
+/*
+   Apply fn to items 0 to n - 1, in blocks of blk items processed by n_thr
+   threads, and write output to out in item order. If n_thr is less than 2,
+   fn is simply applied to the whole range on the calling thread. Return true
+   on success.
+ */
+
+int GeogParRange(size_t n, size_t blk, int n_thr, GeogParRangeFn *fn,
+	void *arg, struct GeogOut *out)
+{
+    struct range_job job;
+    pthread_t *wrks;
+    int n_wrk;				/* Number of workers started */
+    size_t k, i;
+    int ok;
+
+    if ( n_thr < 2 || n <= blk ) {
+	struct Tkx_Arena *scratch = scratch_start();
+
+	ok = scratch && fn(0, n, out, arg);
+	scratch_end(scratch);
+	return ok;
+    }
+    if ( blk == 0 ) {
+	blk = 1;
+    }
+    job.fn = fn;
+    job.arg = arg;
+    job.n = n;
+    job.blk = blk;
+    job.n_blk = (n + blk - 1) / blk;
+    job.n_slot = 2 * (size_t)n_thr;
+    job.n_taken = job.n_written = 0;
+    job.err = 0;
+    job.outs = CALLOC(job.n_slot, sizeof(struct GeogOut));
+    job.done = CALLOC(job.n_slot, sizeof(int));
+    wrks = CALLOC(n_thr, sizeof(pthread_t));
+    if ( !job.outs || !job.done || !wrks ) {
+	fprintf(stderr, "Could not allocate blocks for threads.\n");
+	FREE(job.outs);
+	FREE(job.done);
+	FREE(wrks);
+	return 0;
+    }
+    for (i = 0; i < job.n_slot; i++) {
+	if ( !GeogOutInit(job.outs + i, -1) ) {
+	    fprintf(stderr, "Could not allocate output for threads.\n");
+	    job.err = 1;
+	    job.n_slot = i;
+	    goto done;
+	}
+    }
+    pthread_mutex_init(&job.mtx, NULL);
+    pthread_cond_init(&job.cond, NULL);
+    for (n_wrk = 0; n_wrk < n_thr; n_wrk++) {
+	if ( pthread_create(wrks + n_wrk, NULL, range_worker, &job) != 0 ) {
+	    fprintf(stderr, "Could not start worker thread.\n");
+	    pthread_mutex_lock(&job.mtx);
+	    job.err = 1;
+	    pthread_cond_broadcast(&job.cond);
+	    pthread_mutex_unlock(&job.mtx);
+	    break;
+	}
+    }
+
+    /*
+       Write blocks in order as they complete.
+     */
+
+    for (k = 0; k < job.n_blk; k++) {
+	size_t s = k % job.n_slot;
+
+	pthread_mutex_lock(&job.mtx);
+	while ( !job.err && !job.done[s] ) {
+	    pthread_cond_wait(&job.cond, &job.mtx);
+	}
+	if ( job.err ) {
+	    pthread_mutex_unlock(&job.mtx);
+	    break;
+	}
+	pthread_mutex_unlock(&job.mtx);
+	ok = !job.outs[s].err
+	    && GeogOutMem(out, job.outs[s].buf, job.outs[s].len);
+	job.outs[s].len = 0;
+	pthread_mutex_lock(&job.mtx);
+	if ( !ok ) {
+	    job.err = 1;
+	}
+	job.done[s] = 0;
+	job.n_written = k + 1;
+	pthread_cond_broadcast(&job.cond);
+	pthread_mutex_unlock(&job.mtx);
+    }
+    for (i = 0; i < (size_t)n_wrk; i++) {
+	pthread_join(wrks[i], NULL);
+    }
+    pthread_cond_destroy(&job.cond);
+    pthread_mutex_destroy(&job.mtx);
+
+done:
+    for (i = 0; i < job.n_slot; i++) {
+	GeogOutFree(job.outs + i);
+    }
+    FREE(job.outs);
+    FREE(job.done);
+    FREE(wrks);
+    return !job.err;
+}
+
+/*
+   Apply the function for GeogParRange to blocks whose slots are free.
+ */
+
+static void *range_worker(void *arg)
+{
+    struct range_job *job = arg;
+    struct Tkx_Arena *scratch = scratch_start();
+
+    pthread_mutex_lock(&job->mtx);
+    if ( !scratch ) {
+	job->err = 1;
+	pthread_cond_broadcast(&job->cond);
+    }
+    for (;;) {
+	size_t k, i0, i1;
+	struct GeogOut *out;
+	int ok;
+
+	while ( !job->err && job->n_taken < job->n_blk
+		&& job->n_taken >= job->n_written + job->n_slot ) {
+	    pthread_cond_wait(&job->cond, &job->mtx);
+	}
+	if ( job->err || job->n_taken >= job->n_blk ) {
+	    break;
+	}
+	k = job->n_taken++;
+	pthread_mutex_unlock(&job->mtx);
+	i0 = k * job->blk;
+	i1 = (job->n - i0 < job->blk) ? job->n : i0 + job->blk;
+	out = job->outs + k % job->n_slot;
+	ok = job->fn(i0, i1, out, job->arg);
+	ARENA_RESET(scratch);
+	pthread_mutex_lock(&job->mtx);
+	job->done[k % job->n_slot] = 1;
+	if ( !ok ) {
+	    job->err = 1;
+	}
+	pthread_cond_broadcast(&job->cond);
+    }
+    pthread_mutex_unlock(&job->mtx);
+    scratch_end(scratch);
+    return NULL;
+}
+
+/*
+   Return the scratch arena for the calling thread, or NULL if it is not
+   running a GeogParFn or GeogParRangeFn. Memory from the arena is released
+   when the function returns.
+ */
+
+struct Tkx_Arena *GeogParScratch(void)
+{
+    return scratch_ok ? pthread_getspecific(scratch_key) : NULL;
+}
+
+static void scratch_init(void)
+{
+    scratch_ok = pthread_key_create(&scratch_key, NULL) == 0;
+}
+
+/*
+   Create a scratch arena for the calling thread. Print a message and return
+   NULL on failure.
+ */
+
+static struct Tkx_Arena *scratch_start(void)
+{
+    struct Tkx_Arena *scratch;
+
+    pthread_once(&scratch_once, scratch_init);
+    if ( !scratch_ok || !(scratch = ARENA_CREATE(SCRATCH_SZ)) ) {
+	fprintf(stderr, "Could not allocate scratch memory for thread.\n");
+	return NULL;
+    }
+    if ( pthread_setspecific(scratch_key, scratch) != 0 ) {
+	fprintf(stderr, "Could not set scratch memory for thread.\n");
+	ARENA_DESTROY(scratch);
+	return NULL;
+    }
+    return scratch;
+}
+
+static void scratch_end(struct Tkx_Arena *scratch)
+{
+    if ( scratch ) {
+	pthread_setspecific(scratch_key, NULL);
+	ARENA_DESTROY(scratch);
+    }
+}
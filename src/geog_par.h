@@ -0,0 +1,67 @@
+/*
+   -	geog_par.h --
+   -		Declarations of functions that apply a transformation to
+   -		blocks of input on several threads.  See geog_par (3).
+   -
+   .	Copyright (c) 2014, Gordon D. Carrie. All rights reserved.
+   .
+   .	Redistribution and use in source and binary forms, with or without
+   .	modification, are permitted provided that the following conditions
+   .	are met:
+   .
+   .	    * Redistributions of source code must retain the above copyright
+   .	    notice, this list of conditions and the following disclaimer.
+   .
+   .	    * Redistributions in binary form must reproduce the above copyright
+   .	    notice, this list of conditions and the following disclaimer in the
+   .	    documentation and/or other materials provided with the distribution.
+   .
+   .	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   .	"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   .	LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   .	A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+   .	HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+   .	SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+   .	TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   .	PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   .	LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   .	NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   .	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+   .
+   .	Please send feedback to dev0@trekix.net
+   .
+   .	$Revision: $ $Date: $
+ */
+
+#ifndef GEOG_PAR_H_
+#define GEOG_PAR_H_
+
+#include "geog_io.h"
+
+/*
+   Function that reads all records from its input, and writes results to its
+   output. The last argument is client data. It must return true on success.
+   It may be called from several threads at once. Scratch memory can come
+   from GeogParScratch().
+ */
+
+typedef int (GeogParFn)(struct GeogIn *, struct GeogOut *, void *);
+
+/*
+   Function that writes results for items i0 to i1 - 1 of a range to its
+   output. The last argument is client data. It must return true on success.
+   It may be called from several threads at once. Scratch memory can come
+   from GeogParScratch().
+ */
+
+typedef int (GeogParRangeFn)(size_t, size_t, struct GeogOut *, void *);
+
+struct Tkx_Arena;
+
+int GeogParRun(struct GeogIn *, size_t, int, GeogParFn *, void *,
+	struct GeogOut *);
+int GeogParRange(size_t, size_t, int, GeogParRangeFn *, void *,
+	struct GeogOut *);
+struct Tkx_Arena *GeogParScratch(void);
+
+#endif
@@ -46,307 +46,522 @@
 
 #include <math.h>
 #include <stdio.h>
+#include <string.h>
 #include "geog_lib.h"
 #include "geog_proj.h"
+#include "geog_proj_inline.h"
 
 static struct GeogProj setRefPtProj(double, double);
+static double lcc_rho0(const struct GeogProj *);
+static int separable(const struct GeogProj *);
+
+/* Number of grid points converted at a time by GeogProjGridToLonLat */
+#define GRID_BATCH 256
+
+/*
+   Approximate grid conversion. Cells of the mesh start with APPROX_CELL
+   intervals on a side. A cell whose corners give bilinear values within
+   tol of exact values at its center and edge midpoints is filled by
+   interpolation. Otherwise it is split in half along its longer side.
+   Cells with APPROX_EXACT points or fewer are computed exactly, since
+   testing and splitting them would cost about as much.
+ */
+
+#define APPROX_CELL 32
+#define APPROX_EXACT 256
+
+struct approx {
+    struct GeogProj proj;		/* Projection */
+    double x0, dx, y0, dy;		/* Grid origin and spacing */
+    size_t nx;				/* Number of columns */
+    size_t j0, j_last;			/* First and last row in output */
+    double tol;				/* Tolerance, meters */
+    double *lon, *lat;			/* Output */
+    double err;				/* Largest error accepted */
+};
+
+static void approx_cell(struct approx *, size_t, size_t, size_t, size_t);
 
 int GeogProjLonLatToXY(double lon, double lat, double *x_p, double *y_p,
 	struct GeogProj *projPtr)
 {
-    switch (projPtr->type) {
+    double x, y;
+    unsigned char ok;
+
+    GeogProjLonLatToXYN(&lon, &lat, &x, &y, &ok, 1, projPtr);
+    if ( ok ) {
+	*x_p = x;
+	*y_p = y;
+    }
+    return ok;
+}
+
+int GeogProjXYToLonLat(double x, double y, double *lon_p, double *lat_p,
+	struct GeogProj *projPtr)
+{
+    double lon, lat;
+    unsigned char ok;
+
+    GeogProjXYToLonLatN(&x, &y, &lon, &lat, &ok, 1, projPtr);
+    if ( ok ) {
+	*lon_p = lon;
+	*lat_p = lat;
+    }
+    return ok;
+}
+
+/*
+   Compute map coordinates x[i], y[i] for n geographic points lon[i], lat[i].
+   ok[i] is set to 1 if point i could be projected, otherwise 0. Return value
+   is the number of points projected. The projection type is examined once for
+   the whole array.
+ */
+
+size_t GeogProjLonLatToXYN(const double *lon, const double *lat,
+	double *x, double *y, unsigned char *ok, size_t n,
+	const struct GeogProj *projPtr)
+{
+    struct GeogProj proj = *projPtr;	/* Local copy for the kernels */
+    size_t i, n_ok;
+
+    switch (proj.type) {
 	case CylEqDist:
-	    {
-		double r0 = GeogREarth(NULL);
-		double lon0 = projPtr->params.RefPt.lon0;
-		double lat0 = projPtr->params.RefPt.lat0;
-		double cos_lat0 = projPtr->params.RefPt.cos_lat0;
-
-		*x_p = GeogLonDiff(lon, lon0) * cos_lat0 * r0;
-		*y_p = (lat - lat0) * r0;
+	    for (i = 0; i < n; i++) {
+		ok[i] = GeogProjCylEqDistFwd(&proj, lon[i], lat[i], x + i, y + i);
 	    }
 	    break;
 	case CylEqArea:
-	    {
-		double r0 = GeogREarth(NULL);
-		double lon0 = projPtr->params.lon0;
-
-		*x_p = r0 * GeogLonDiff(lon, lon0);
-		*y_p = r0 * sin(lat);
+	    for (i = 0; i < n; i++) {
+		ok[i] = GeogProjCylEqAreaFwd(&proj, lon[i], lat[i], x + i, y + i);
 	    }
 	    break;
 	case Mercator:
-	    {
-		double r0 = GeogREarth(NULL);
-		double lon0 = projPtr->params.lon0;
-		double limit;
-
-		limit = M_PI_2 * 8.0 / 9.0;	/* 80 degrees */
-		if ( fabs(lat) > limit ) {
-		    return 0;
-		}
-		*x_p = r0 * GeogLonDiff(lon, lon0);
-		*y_p = r0 * log(tan(M_PI_4 + 0.5 * lat));
-
+	    for (i = 0; i < n; i++) {
+		ok[i] = GeogProjMercatorFwd(&proj, lon[i], lat[i], x + i, y + i);
 	    }
 	    break;
 	case LambertConfConic:
-	    {
-		double r0 = GeogREarth(NULL);
-		double lon0 = projPtr->params.LambertConfConic.lon0;
-		double F = projPtr->params.LambertConfConic.F;
-		double n = projPtr->params.LambertConfConic.n;
-		double rho0 = projPtr->params.LambertConfConic.rho0;
-		double rho, theta;
-
-		rho = r0 * F / pow(tan(M_PI_4 + 0.5 * lat), n);
-		theta = n * GeogLonDiff(lon, lon0);
-		*x_p = rho * sin(theta);
-		*y_p = rho0 - rho * cos(theta);
+	    for (i = 0; i < n; i++) {
+		ok[i] = GeogProjLambertConfConicFwd(&proj, lon[i], lat[i], x + i, y + i);
 	    }
 	    break;
 	case LambertEqArea:
-	    {
-		double r0 = GeogREarth(NULL);
-		double lon0 = projPtr->params.RefPt.lon0;
-		double lat0 = projPtr->params.RefPt.lat0;
-		double cos_lat0 = projPtr->params.RefPt.cos_lat0;
-		double sin_lat0 = projPtr->params.RefPt.sin_lat0;
-		double k, dlon;
-		double cos_lat, sin_lat, cos_dlon;
-
-		cos_lat = cos(lat);
-		sin_lat = sin(lat);
-		lon = GeogLonR(lon, lon0);
-		dlon = lon - lon0;
-		cos_dlon = cos(dlon);
-		if ( GeogDist(lon0, lat0, lon, lat) > M_PI_2 ) {
-		    return 0;
-		}
-		k = 1.0 + sin_lat0 * sin_lat + cos_lat0 * cos_lat * cos_dlon;
-		k = sqrt(2.0 / k);
-		*x_p = r0 * k * cos_lat * sin(dlon);
-		*y_p = r0 * k
-		    * (cos_lat0 * sin_lat - sin_lat0 * cos_lat * cos_dlon);
+	    for (i = 0; i < n; i++) {
+		ok[i] = GeogProjLambertEqAreaFwd(&proj, lon[i], lat[i], x + i, y + i);
 	    }
 	    break;
 	case Orthographic:
-	    {
-		double r0 = GeogREarth(NULL);
-		double lon0 = projPtr->params.RefPt.lon0;
-		double lat0 = projPtr->params.RefPt.lat0;
-		double cos_lat0 = projPtr->params.RefPt.cos_lat0;
-		double sin_lat0 = projPtr->params.RefPt.sin_lat0;
-		double cos_lat, dlon;
-
-		if ( GeogDist(lon0, lat0, lon, lat) > M_PI_2 ) {
-		    return 0;
-		}
-		cos_lat = cos(lat);
-		dlon =  GeogLonDiff(lon, lon0);
-		*x_p = r0 * cos_lat * sin(dlon);
-		*y_p = r0 * (cos_lat0 * sin(lat)
-			- sin_lat0 * cos_lat * cos(dlon));
+	    for (i = 0; i < n; i++) {
+		ok[i] = GeogProjOrthographicFwd(&proj, lon[i], lat[i], x + i, y + i);
 	    }
 	    break;
 	case Stereographic:
-	    {
-		double r0 = GeogREarth(NULL);
-		double lon0 = projPtr->params.RefPt.lon0;
-		double lat0 = projPtr->params.RefPt.lat0;
-		double cos_lat0 = projPtr->params.RefPt.cos_lat0;
-		double sin_lat0 = projPtr->params.RefPt.sin_lat0;
-		double dlon, cos_dlon, k, cos_lat, sin_lat;
-
-		/*
-		   Follow convention and treat as hemisphere projection.
-		 */
-
-		if ( GeogDist(lon0, lat0, lon, lat) > M_PI_2 ) {
-		    return 0;
-		}
-		cos_lat = cos(lat);
-		sin_lat = sin(lat);
-		dlon = GeogLonDiff(lon, lon0);
-		cos_dlon = cos(dlon);
-		k = 2.0 / (1.0 + sin_lat0 * sin_lat
-			+ cos_lat0 * cos_lat * cos_dlon);
-		*x_p = r0 * k * cos_lat * sin(dlon);
-		*y_p = r0 * k
-		    * (cos_lat0 * sin_lat - sin_lat0 * cos_lat * cos_dlon);
+	    for (i = 0; i < n; i++) {
+		ok[i] = GeogProjStereographicFwd(&proj, lon[i], lat[i], x + i, y + i);
+	    }
+	    break;
+	default:
+	    for (i = 0; i < n; i++) {
+		ok[i] = 0;
 	    }
 	    break;
     }
-    if (projPtr->rotation != 0) {
-	double x = *x_p, y = *y_p;
-	double x_;
-
-	x_ = x * projPtr->cosr + y * projPtr->sinr;
-	*y_p = y * projPtr->cosr - x * projPtr->sinr;
-	*x_p = x_;
+    if (proj.rotation != 0) {
+	for (i = 0; i < n; i++) {
+	    if ( ok[i] ) {
+		GeogProjRotFwd(&proj, x + i, y + i);
+	    }
+	}
     }
-    return 1;
+    for (i = n_ok = 0; i < n; i++) {
+	n_ok += ok[i];
+    }
+    return n_ok;
 }
 
-int GeogProjXYToLonLat(double x, double y, double *lon_p, double *lat_p,
-	struct GeogProj *projPtr)
-{
-    if (projPtr->rotation != 0) {
-	double x_;
+/*
+   Compute geographic coordinates lon[i], lat[i] for n map points x[i], y[i].
+   ok[i] is set to 1 if point i could be converted, otherwise 0. Return value
+   is the number of points converted. The projection type is examined once for
+   the whole array.
+ */
 
-	x_ =  x * projPtr->cosr - y * projPtr->sinr;
-	y = x * projPtr->sinr + y * projPtr->cosr;
-	x = x_;
+size_t GeogProjXYToLonLatN(const double *x, const double *y,
+	double *lon, double *lat, unsigned char *ok, size_t n,
+	const struct GeogProj *projPtr)
+{
+    struct GeogProj proj = *projPtr;	/* Local copy for the kernels */
+    const double *xs = x, *ys = y;	/* Unrotated map coordinates */
+    size_t i, n_ok;
+
+    /*
+       Undo rotation up front, storing the unrotated coordinates in the
+       output arrays. Each loop below reads element i before writing it.
+     */
+
+    if (proj.rotation != 0) {
+	for (i = 0; i < n; i++) {
+	    lon[i] = x[i];
+	    lat[i] = y[i];
+	    GeogProjRotInv(&proj, lon + i, lat + i);
+	}
+	xs = lon;
+	ys = lat;
     }
-    switch (projPtr->type) {
+    switch (proj.type) {
 	case CylEqDist:
-	    {
-		double r0 = GeogREarth(NULL);
-		double lon0 = projPtr->params.RefPt.lon0;
-		double cos_lat0 = projPtr->params.RefPt.cos_lat0;
-
-		*lon_p = GeogLonR(lon0 + x / (cos_lat0 * r0), lon0);
-		*lat_p = y / r0;
+	    for (i = 0; i < n; i++) {
+		ok[i] = GeogProjCylEqDistInv(&proj, xs[i], ys[i], lon + i, lat + i);
 	    }
 	    break;
 	case CylEqArea:
-	    {
-		double r0 = GeogREarth(NULL);
-		double lon0 = projPtr->params.lon0;
-		double r;
-
-		r = GeogLatN(y / r0);
-		*lat_p = asin(r);
-		*lon_p = GeogLonR(lon0 + x / r0, lon0);
+	    for (i = 0; i < n; i++) {
+		ok[i] = GeogProjCylEqAreaInv(&proj, xs[i], ys[i], lon + i, lat + i);
 	    }
 	    break;
 	case Mercator:
-	    {
-		double r0 = GeogREarth(NULL);
-		double lon0 = projPtr->params.lon0;
-
-		*lon_p = GeogLonR(lon0 + x / r0, lon0);
-		*lat_p = M_PI_2 - 2.0 * atan(exp(-y / r0));
+	    for (i = 0; i < n; i++) {
+		ok[i] = GeogProjMercatorInv(&proj, xs[i], ys[i], lon + i, lat + i);
 	    }
 	    break;
 	case LambertConfConic:
-	    {
-		double r0 = GeogREarth(NULL);
-		double lon0 = projPtr->params.LambertConfConic.lon0;
-		double F = projPtr->params.LambertConfConic.F;
-		double n = projPtr->params.LambertConfConic.n;
-		double rho0 = projPtr->params.LambertConfConic.rho0;
-		double rho, theta;
-
-		rho = hypot(x, rho0 - y);
-		rho = copysign(rho, n);
-		if ( n < 0.0 ) {
-		    x = -x;
-		    y = -y;
-		    rho0 = -rho0;
-		}
-		theta = atan2(x, rho0 - y);
-		*lon_p = GeogLonR(theta / n + lon0, lon0);
-		if ( rho != 0.0 ) {
-		    *lat_p = 2.0 * atan(pow(r0 * F / rho, 1.0 / n)) - M_PI_2;
-		} else {
-		    *lat_p = M_PI_2;
-		    *lat_p = copysign(*lat_p, n);
-		}
+	    for (i = 0; i < n; i++) {
+		ok[i] = GeogProjLambertConfConicInv(&proj, xs[i], ys[i], lon + i, lat + i);
 	    }
 	    break;
 	case LambertEqArea:
-	    {
-		double r0 = GeogREarth(NULL);
-		double lon0 = projPtr->params.RefPt.lon0;
-		double lat0 = projPtr->params.RefPt.lat0;
-		double cos_lat0 = projPtr->params.RefPt.cos_lat0;
-		double sin_lat0 = projPtr->params.RefPt.sin_lat0;
-		double rho, c, cos_c, sin_c, ord, lon, lat;
-
-		rho = hypot(x, y);
-		if (rho > 2.0 * r0) {
-		    return 0;
-		}
-		c = 2.0 * asin(rho / (2.0 * r0));
-		cos_c = cos(c);
-		sin_c = sin(c);
-		if (rho == 0.0) {
-		    lat = lat0;
-		} else {
-		    ord = cos_c * sin_lat0 + (y * sin_c * cos_lat0 / rho);
-		    if (ord > 1.0)  {
-			return 0;
-		    }
-		    lat = asin(ord);
-		}
-		*lat_p = lat;
-		lon = lon0 + atan2(x * sin_c,
-			(rho * cos_lat0 * cos_c - y * sin_lat0 * sin_c));
-		*lon_p = GeogLonR(lon, lon0);
+	    for (i = 0; i < n; i++) {
+		ok[i] = GeogProjLambertEqAreaInv(&proj, xs[i], ys[i], lon + i, lat + i);
 	    }
 	    break;
 	case Orthographic:
-	    {
-		double r0 = GeogREarth(NULL);
-		double lon0 = projPtr->params.RefPt.lon0;
-		double lat0 = projPtr->params.RefPt.lat0;
-		double cos_lat0 = projPtr->params.RefPt.cos_lat0;
-		double sin_lat0 = projPtr->params.RefPt.sin_lat0;
-		double rho, c, cos_c, sin_c, ord, lon, lat;
-
-		rho = hypot(x, y);
-		if ( rho / r0 > 1.0 ) {
-		    return 0;
-		}
-		c = asin(rho / r0);
-		cos_c = cos(c);
-		sin_c = sin(c);
-		if ( rho == 0.0 ) {
-		    lat = lat0;
-		} else {
-		    ord = cos_c * sin_lat0 + (y * sin_c * cos_lat0 / rho);
-		    if ( ord > 1.0 ) {
-			return 0;
-		    }
-		    lat = asin(ord);
-		}
-		*lat_p = lat;
-		lon = lon0 + atan2(x * sin_c,
-			(rho * cos_lat0 * cos_c - y * sin_lat0 * sin_c));
-		*lon_p = GeogLonR(lon, lon0);
+	    for (i = 0; i < n; i++) {
+		ok[i] = GeogProjOrthographicInv(&proj, xs[i], ys[i], lon + i, lat + i);
 	    }
 	    break;
 	case Stereographic:
-	    {
-		double r0 = GeogREarth(NULL);
-		double lon0 = projPtr->params.RefPt.lon0;
-		double lat0 = projPtr->params.RefPt.lat0;
-		double cos_lat0 = projPtr->params.RefPt.cos_lat0;
-		double sin_lat0 = projPtr->params.RefPt.sin_lat0;
-		double rho, c, cos_c, sin_c, ord, lon, lat;
-
-		rho = hypot(x, y);
-		c = 2.0 * atan2(rho, 2.0 * r0);
-		cos_c = cos(c);
-		sin_c = sin(c);
-		if (rho == 0.0) {
-		    lat = lat0;
-		} else {
-		    ord = cos_c * sin_lat0 + (y * sin_c * cos_lat0 / rho);
-		    if (ord > 1.0) {
-			return 0;
-		    }
-		    lat = asin(ord);
+	    for (i = 0; i < n; i++) {
+		ok[i] = GeogProjStereographicInv(&proj, xs[i], ys[i], lon + i, lat + i);
+	    }
+	    break;
+	default:
+	    for (i = 0; i < n; i++) {
+		ok[i] = 0;
+	    }
+	    break;
+    }
+    for (i = n_ok = 0; i < n; i++) {
+	n_ok += ok[i];
+    }
+    return n_ok;
+}
+
+/*
+   Compute geographic coordinates for rows j0 to j1 - 1 of a grid of map
+   points. Point (i, j) is at x0 + i * dx, y0 + j * dy, for i from 0 to
+   nx - 1. Results for point (i, j) go to lon[k], lat[k], where
+   k = (j - j0) * nx + i. Points that cannot be converted get NaN. Return
+   value is the number of points converted. Results are the same as from
+   GeogProjXYToLonLatN, and do not depend on j0, so a grid can be divided
+   among threads by rows.
+ */
+
+size_t GeogProjGridToLonLat(double x0, double dx, size_t nx,
+	double y0, double dy, size_t j0, size_t j1, double *lon, double *lat,
+	const struct GeogProj *projPtr)
+{
+    struct GeogProj proj = *projPtr;	/* Local copy for the kernels */
+    size_t i, j, k, n_ok;
+
+    if ( j1 <= j0 || nx == 0 ) {
+	return 0;
+    }
+
+    /*
+       For cylindrical projections without rotation, longitude depends only
+       on x and latitude only on y. Compute longitudes for the first row,
+       then copy them to the other rows.
+     */
+
+    if ( separable(&proj) ) {
+	double lon_j, lat_j;
+
+	for (i = 0; i < nx; i++) {
+	    double x_i = x0 + i * dx;
+
+	    switch (proj.type) {
+		case CylEqDist:
+		    GeogProjCylEqDistInv(&proj, x_i, y0, lon + i, &lat_j);
+		    break;
+		case CylEqArea:
+		    GeogProjCylEqAreaInv(&proj, x_i, y0, lon + i, &lat_j);
+		    break;
+		default:
+		    GeogProjMercatorInv(&proj, x_i, y0, lon + i, &lat_j);
+		    break;
+	    }
+	}
+	for (j = j0, k = 0; j < j1; j++) {
+	    double y_j = y0 + j * dy;
+
+	    switch (proj.type) {
+		case CylEqDist:
+		    GeogProjCylEqDistInv(&proj, x0, y_j, &lon_j, &lat_j);
+		    break;
+		case CylEqArea:
+		    GeogProjCylEqAreaInv(&proj, x0, y_j, &lon_j, &lat_j);
+		    break;
+		default:
+		    GeogProjMercatorInv(&proj, x0, y_j, &lon_j, &lat_j);
+		    break;
+	    }
+	    if ( k > 0 ) {
+		memcpy(lon + k, lon, nx * sizeof(double));
+	    }
+	    for (i = 0; i < nx; i++, k++) {
+		lat[k] = lat_j;
+	    }
+	}
+	return k;
+    }
+
+    /*
+       Otherwise, convert each row in batches.
+     */
+
+    for (j = j0, k = 0, n_ok = 0; j < j1; j++) {
+	double y_j = y0 + j * dy;
+	double xb[GRID_BATCH], yb[GRID_BATCH];
+	unsigned char ok[GRID_BATCH];
+	size_t i0, n, m;
+
+	for (m = 0; m < GRID_BATCH; m++) {
+	    yb[m] = y_j;
+	}
+	for (i0 = 0; i0 < nx; i0 += n) {
+	    n = (nx - i0 < GRID_BATCH) ? nx - i0 : GRID_BATCH;
+	    for (m = 0; m < n; m++) {
+		xb[m] = x0 + (i0 + m) * dx;
+	    }
+	    n_ok += GeogProjXYToLonLatN(xb, yb, lon + k, lat + k, ok, n, &proj);
+	    for (m = 0; m < n; m++, k++) {
+		if ( !ok[m] ) {
+		    lon[k] = lat[k] = NAN;
+		}
+	    }
+	}
+    }
+    return n_ok;
+}
+
+/*
+   Like GeogProjGridToLonLat, but compute exact values only at the nodes of a
+   mesh, and interpolate bilinearly between them. Mesh cells are subdivided
+   until interpolated values at test points in each cell are within tol
+   meters of exact values. The largest such error is stored at err. Return
+   value is the number of points with geographic coordinates.
+ */
+
+size_t GeogProjGridToLonLatApprox(double x0, double dx, size_t nx,
+	double y0, double dy, size_t j0, size_t j1, double tol,
+	double *lon, double *lat, double *err, const struct GeogProj *projPtr)
+{
+    struct approx ap;
+    size_t ia, ib, ja, jb, k, n_ok;
+
+    *err = 0.0;
+    if ( j1 <= j0 || nx == 0 ) {
+	return 0;
+    }
+    if ( separable(projPtr) ) {
+
+	/* Exact values are cheaper than interpolation */
+	return GeogProjGridToLonLat(x0, dx, nx, y0, dy, j0, j1, lon, lat,
+		projPtr);
+    }
+    ap.proj = *projPtr;
+    ap.x0 = x0;
+    ap.dx = dx;
+    ap.y0 = y0;
+    ap.dy = dy;
+    ap.nx = nx;
+    ap.j0 = j0;
+    ap.j_last = j1 - 1;
+    ap.tol = tol;
+    ap.lon = lon;
+    ap.lat = lat;
+    ap.err = 0.0;
+
+    /*
+       Initial cells are aligned to multiples of APPROX_CELL in the whole
+       grid, so results do not depend on j0 except at the edges of the range.
+     */
+
+    ja = j0;
+    do {
+	jb = (ja / APPROX_CELL + 1) * APPROX_CELL;
+	if ( jb > j1 - 1 ) {
+	    jb = j1 - 1;
+	}
+	ia = 0;
+	do {
+	    ib = (ia / APPROX_CELL + 1) * APPROX_CELL;
+	    if ( ib > nx - 1 ) {
+		ib = nx - 1;
+	    }
+	    approx_cell(&ap, ia, ib, ja, jb);
+	    ia = ib;
+	} while ( ib < nx - 1 );
+	ja = jb;
+    } while ( jb < j1 - 1 );
+    for (k = 0, n_ok = 0; k < (j1 - j0) * nx; k++) {
+	if ( !isnan(lon[k]) ) {
+	    n_ok++;
+	}
+    }
+    *err = ap.err;
+    return n_ok;
+}
+
+/*
+   Return true if longitude depends only on x and latitude only on y.
+ */
+
+static int separable(const struct GeogProj *projPtr)
+{
+    return projPtr->rotation == 0
+	&& (projPtr->type == CylEqDist || projPtr->type == CylEqArea
+		|| projPtr->type == Mercator);
+}
+
+/*
+   Fill the cell with corners at columns ia, ib and rows ja, jb.
+ */
+
+static void approx_cell(struct approx *ap, size_t ia, size_t ib,
+	size_t ja, size_t jb)
+{
+    size_t im = (ia + ib) / 2, jm = (ja + jb) / 2;
+    size_t ci[9], cj[9];		/* Columns and rows of mesh nodes */
+    double x[9], y[9], lon[9], lat[9];	/* Map and geographic coordinates
+					   of nodes */
+    unsigned char ok[9];
+    double lon0 = ap->proj.params.lon0;
+    double r0 = ap->proj.ctx.r_earth;
+    double l00, l10, l01, l11;		/* Corner longitudes */
+    double err, e;
+    size_t m, i, j, k;
+
+    if ( (ib - ia + 1) * (jb - ja + 1) <= APPROX_EXACT ) {
+	size_t i_e, j_e;		/* End of exact columns and rows */
+
+	/*
+	   Leave the last row and column for the neighboring cell, unless
+	   they are at the edge of the output.
+	 */
+
+	i_e = (ib == ap->nx - 1 || ib == ia) ? ib + 1 : ib;
+	j_e = (jb == ap->j_last || jb == ja) ? jb + 1 : jb;
+	for (j = ja; j < j_e; j++) {
+	    double xe[APPROX_EXACT], ye[APPROX_EXACT];
+	    unsigned char oke[APPROX_EXACT];
+
+	    for (i = ia, m = 0; i < i_e; i++, m++) {
+		xe[m] = ap->x0 + i * ap->dx;
+		ye[m] = ap->y0 + j * ap->dy;
+	    }
+	    k = (j - ap->j0) * ap->nx + ia;
+	    GeogProjXYToLonLatN(xe, ye, ap->lon + k, ap->lat + k, oke, m,
+		    &ap->proj);
+	    for (i = 0; i < m; i++, k++) {
+		if ( !oke[i] ) {
+		    ap->lon[k] = ap->lat[k] = NAN;
 		}
-		*lat_p = lat;
-		lon = lon0 + atan2(x * sin_c,
-			rho * cos_lat0 * cos_c - y * sin_lat0 * sin_c);
-		*lon_p = GeogLonR(lon, lon0);
 	    }
+	}
+	return;
+    }
+
+    /*
+       Nodes 0 to 3 are corners. 4 is the center, 5 to 8 are edge midpoints.
+     */
+
+    ci[0] = ia; cj[0] = ja;
+    ci[1] = ib; cj[1] = ja;
+    ci[2] = ia; cj[2] = jb;
+    ci[3] = ib; cj[3] = jb;
+    ci[4] = im; cj[4] = jm;
+    ci[5] = im; cj[5] = ja;
+    ci[6] = im; cj[6] = jb;
+    ci[7] = ia; cj[7] = jm;
+    ci[8] = ib; cj[8] = jm;
+    for (m = 0; m < 9; m++) {
+	x[m] = ap->x0 + ci[m] * ap->dx;
+	y[m] = ap->y0 + cj[m] * ap->dy;
+    }
+    GeogProjXYToLonLatN(x, y, lon, lat, ok, 9, &ap->proj);
+
+    /*
+       Interpolate longitudes relative to the first corner, so the cell does
+       not wrap around the Earth.
+     */
+
+    l00 = lon[0];
+    l10 = GeogLonR(lon[1], l00);
+    l01 = GeogLonR(lon[2], l00);
+    l11 = GeogLonR(lon[3], l00);
+    for (m = 0, err = 0.0; m < 9; m++) {
+	double s, t, lon_i, lat_i;
+
+	if ( !ok[m] ) {
+	    err = NAN;
 	    break;
+	}
+	s = (ib > ia) ? (double)(ci[m] - ia) / (ib - ia) : 0.0;
+	t = (jb > ja) ? (double)(cj[m] - ja) / (jb - ja) : 0.0;
+	lon_i = (1 - t) * ((1 - s) * l00 + s * l10)
+	    + t * ((1 - s) * l01 + s * l11);
+	lat_i = (1 - t) * ((1 - s) * lat[0] + s * lat[1])
+	    + t * ((1 - s) * lat[2] + s * lat[3]);
+	e = r0 * GeogDist(lon_i, lat_i, lon[m], lat[m]);
+	if ( e > err ) {
+	    err = e;
+	}
+    }
+    if ( isnan(err) || err > ap->tol ) {
+	if ( ib - ia >= jb - ja ) {
+	    approx_cell(ap, ia, im, ja, jb);
+	    approx_cell(ap, im, ib, ja, jb);
+	} else {
+	    approx_cell(ap, ia, ib, ja, jm);
+	    approx_cell(ap, ia, ib, jm, jb);
+	}
+	return;
+    }
+    if ( err > ap->err ) {
+	ap->err = err;
+    }
+    for (j = ja; j <= jb; j++) {
+	double t = (jb > ja) ? (double)(j - ja) / (jb - ja) : 0.0;
+	double lon_a = (1 - t) * l00 + t * l01, lon_b = (1 - t) * l10 + t * l11;
+	double lat_a = (1 - t) * lat[0] + t * lat[2];
+	double lat_b = (1 - t) * lat[1] + t * lat[3];
+
+	k = (j - ap->j0) * ap->nx + ia;
+	for (i = ia; i <= ib; i++, k++) {
+	    double s = (ib > ia) ? (double)(i - ia) / (ib - ia) : 0.0;
+
+	    ap->lon[k] = GeogLonR((1 - s) * lon_a + s * lon_b, lon0);
+	    ap->lat[k] = (1 - s) * lat_a + s * lat_b;
+	}
+    }
+
+    /* Keep exact values at the nodes */
+    for (m = 0; m < 9; m++) {
+	k = (cj[m] - ap->j0) * ap->nx + ci[m];
+	ap->lon[k] = lon[m];
+	ap->lat[k] = lat[m];
     }
-    return 1;
 }
 
 void GeogProjSetRotation(struct GeogProj *projPtr, double angle)
@@ -356,6 +571,34 @@ void GeogProjSetRotation(struct GeogProj *projPtr, double angle)
     projPtr->sinr = sin(angle);
 }
 
+/*
+   Use Earth radius from ctx for projection. Projection setters use the
+   default radius from GeogREarth at the time they are called.
+ */
+
+void GeogProjSetCtx(struct GeogProj *projPtr, const struct GeogCtx *ctx)
+{
+    projPtr->ctx = *ctx;
+    if ( projPtr->type == LambertConfConic ) {
+	projPtr->params.LambertConfConic.rho0 = lcc_rho0(projPtr);
+    }
+}
+
+/*
+   Compute rho0 (Snyder, p. 105) for a Lambert Conformal Conic projection
+   from its other parameters.
+ */
+
+static double lcc_rho0(const struct GeogProj *projPtr)
+{
+    double r0 = projPtr->ctx.r_earth;
+    double lat0 = projPtr->params.LambertConfConic.lat0;
+    double n = projPtr->params.LambertConfConic.n;
+    double F = projPtr->params.LambertConfConic.F;
+
+    return r0 * F / pow(tan(M_PI_4 + lat0 / 2.0), n);
+}
+
 int GeogProjSetFmStr(char *l, struct GeogProj *projPtr)
 {
     double lon0, lat0, lat1, lat2;
@@ -398,6 +641,7 @@ int GeogProjSetMercator(double lon0, struct GeogProj *projPtr)
 
     proj.type = Mercator;
     proj.params.lon0 = GeogLonR(lon0, 0.0);
+    GeogCtxInit(&proj.ctx);
     proj.rotation = 0.0;
     proj.cosr = 1.0;
     proj.sinr = 0.0;
@@ -411,6 +655,7 @@ int GeogProjSetCylEqArea(double lon0, struct GeogProj *projPtr)
 
     proj.type = CylEqArea;
     proj.params.lon0 = GeogLonR(lon0, 0.0);
+    GeogCtxInit(&proj.ctx);
     proj.rotation = 0.0;
     proj.cosr = 1.0;
     proj.sinr = 0.0;
@@ -422,10 +667,10 @@ int GeogProjSetLambertConfConic(double lon0, double lat0,
 	double lat1, double lat2, struct GeogProj *proj_p)
 {
     struct GeogProj proj;
-    double n, F, rho0;
-    double r0 = GeogREarth(NULL);
+    double n, F;
 
     proj.type = LambertConfConic;
+    GeogCtxInit(&proj.ctx);
     lat0 = GeogLatN(lat0);
     proj.params.LambertConfConic.lat0 = lat0;
     if ( proj.params.LambertConfConic.lat0 == 0.0 ) {
@@ -447,10 +692,9 @@ int GeogProjSetLambertConfConic(double lon0, double lat0,
 	fprintf(stderr, "  Lambert Conformal Conic F parameter not finite.\n");
 	return 0;
     }
-    rho0 = r0 * F / pow(tan(M_PI_4 + lat0 / 2.0), n);
     proj.params.LambertConfConic.n = n;
     proj.params.LambertConfConic.F = F;
-    proj.params.LambertConfConic.rho0 = rho0;
+    proj.params.LambertConfConic.rho0 = lcc_rho0(&proj);
     proj.rotation = 0.0;
     proj.cosr = 1.0;
     proj.sinr = 0.0;
@@ -501,6 +745,7 @@ static struct GeogProj setRefPtProj(double lon0, double lat0)
     proj.params.RefPt.cos_lat0 = cos(lat0);
     proj.params.RefPt.sin_lat0 = sin(lat0);
     proj.params.RefPt.lon0 = GeogLonR(lon0, 0.0);
+    GeogCtxInit(&proj.ctx);
     proj.rotation = 0.0;
     proj.cosr = 1.0;
     proj.sinr = 0.0;
@@ -47,6 +47,9 @@
 #ifndef _GEOGPROJ_H_
 #define _GEOGPROJ_H_
 
+#include <stddef.h>
+#include "geog_lib.h"
+
 /*
    The following constant identifies the currently recognized projection types.
  */
@@ -88,6 +91,7 @@ struct GeogProj {
 					   orientation of the surface onto which
 					   the Earth's surface is projected */
     double cosr, sinr;			/* Cosine and sine of rotation */
+    struct GeogCtx ctx;			/* Earth radius */
 };
 
 /*
@@ -96,6 +100,15 @@ struct GeogProj {
 
 int GeogProjXYToLonLat(double, double, double *, double *, struct GeogProj *);
 int GeogProjLonLatToXY(double, double, double *, double *, struct GeogProj *);
+size_t GeogProjLonLatToXYN(const double *, const double *, double *, double *,
+	unsigned char *, size_t, const struct GeogProj *);
+size_t GeogProjXYToLonLatN(const double *, const double *, double *, double *,
+	unsigned char *, size_t, const struct GeogProj *);
+size_t GeogProjGridToLonLat(double, double, size_t, double, double, size_t,
+	size_t, double *, double *, const struct GeogProj *);
+size_t GeogProjGridToLonLatApprox(double, double, size_t, double, double,
+	size_t, size_t, double, double *, double *, double *,
+	const struct GeogProj *);
 int GeogProjSetCylEqDist(double, double, struct GeogProj *);
 int GeogProjSetCylEqArea(double, struct GeogProj *);
 int GeogProjSetMercator(double, struct GeogProj *);
@@ -105,6 +118,7 @@ int GeogProjSetLambertEqArea(double, double, struct GeogProj *);
 int GeogProjSetStereographic(double, double, struct GeogProj *);
 int GeogProjSetOrthographic(double, double, struct GeogProj *);
 void GeogProjSetRotation(struct GeogProj *, double);
+void GeogProjSetCtx(struct GeogProj *, const struct GeogCtx *);
 int GeogProjSetFmStr(char *, struct GeogProj *);
 
 #endif
@@ -0,0 +1,364 @@
+/*
+   -	geog_proj_inline.h --
+   -		Inline functions that convert single points between
+   -		geographic and map coordinates.  See geog_proj (3).
+   -
+   .	Copyright (c) 2014, Gordon D. Carrie. All rights reserved.
+   .
+   .	Redistribution and use in source and binary forms, with or without
+   .	modification, are permitted provided that the following conditions
+   .	are met:
+   .
+   .	    * Redistributions of source code must retain the above copyright
+   .	    notice, this list of conditions and the following disclaimer.
+   .
+   .	    * Redistributions in binary form must reproduce the above copyright
+   .	    notice, this list of conditions and the following disclaimer in the
+   .	    documentation and/or other materials provided with the distribution.
+   .
+   .	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   .	"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   .	LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   .	A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+   .	HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+   .	SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+   .	TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   .	PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   .	LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   .	NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   .	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+   .
+   .	Please send feedback to dev0@trekix.net
+   .
+   .	$Revision: $ $Date: $
+ */
+
+/*
+   This header defines one forward and one inverse kernel for each
+   projection type, plus the rotation steps. GeogProjLonLatToXYN and
+   GeogProjXYToLonLatN are built from the same kernels, so results are
+   identical. Clients that know the projection type in advance can call a
+   kernel directly in their own loops, where the compiler can inline it,
+   and skip the rotation step for unrotated maps. The header may be
+   included from C++.
+
+   Forward kernels compute unrotated map coordinates *x, *y for lon, lat
+   and return 1, or return 0 if the point cannot be projected. Inverse
+   kernels compute *lon, *lat for unrotated map coordinates x, y and return
+   1, or return 0 if the point cannot be converted. Outputs are not
+   modified if a kernel returns 0. proj must have been set up for the
+   kernel's projection type.
+
+   When calling kernels in a loop, pass a pointer to a local copy of the
+   projection so the compiler knows the parameters cannot change.
+ */
+
+#ifndef GEOG_PROJ_INLINE_H_
+#define GEOG_PROJ_INLINE_H_
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <math.h>
+#ifdef __cplusplus
+extern "C" {
+#endif
+#include "geog_lib.h"
+#include "geog_proj.h"
+#ifdef __cplusplus
+}
+#endif
+
+/*
+   Forward kernels
+ */
+
+static inline int GeogProjCylEqDistFwd(const struct GeogProj *proj,
+	double lon, double lat, double *x, double *y)
+{
+    double r0 = proj->ctx.r_earth;
+    double lon0 = proj->params.RefPt.lon0;
+    double lat0 = proj->params.RefPt.lat0;
+    double cos_lat0 = proj->params.RefPt.cos_lat0;
+
+    *x = GeogLonDiff(lon, lon0) * cos_lat0 * r0;
+    *y = (lat - lat0) * r0;
+    return 1;
+}
+
+static inline int GeogProjCylEqAreaFwd(const struct GeogProj *proj,
+	double lon, double lat, double *x, double *y)
+{
+    double r0 = proj->ctx.r_earth;
+    double lon0 = proj->params.lon0;
+
+    *x = r0 * GeogLonDiff(lon, lon0);
+    *y = r0 * sin(lat);
+    return 1;
+}
+
+static inline int GeogProjMercatorFwd(const struct GeogProj *proj,
+	double lon, double lat, double *x, double *y)
+{
+    double r0 = proj->ctx.r_earth;
+    double lon0 = proj->params.lon0;
+    double limit = M_PI_2 * 8.0 / 9.0;	/* 80 degrees */
+
+    if ( fabs(lat) > limit ) {
+	return 0;
+    }
+    *x = r0 * GeogLonDiff(lon, lon0);
+    *y = r0 * log(tan(M_PI_4 + 0.5 * lat));
+    return 1;
+}
+
+static inline int GeogProjLambertConfConicFwd(const struct GeogProj *proj,
+	double lon, double lat, double *x, double *y)
+{
+    double r0 = proj->ctx.r_earth;
+    double lon0 = proj->params.LambertConfConic.lon0;
+    double F = proj->params.LambertConfConic.F;
+    double n = proj->params.LambertConfConic.n;
+    double rho0 = proj->params.LambertConfConic.rho0;
+    double rho, theta;
+
+    rho = r0 * F / pow(tan(M_PI_4 + 0.5 * lat), n);
+    theta = n * GeogLonDiff(lon, lon0);
+    *x = rho * sin(theta);
+    *y = rho0 - rho * cos(theta);
+    return 1;
+}
+
+static inline int GeogProjLambertEqAreaFwd(const struct GeogProj *proj,
+	double lon, double lat, double *x, double *y)
+{
+    double r0 = proj->ctx.r_earth;
+    double lon0 = proj->params.RefPt.lon0;
+    double lat0 = proj->params.RefPt.lat0;
+    double cos_lat0 = proj->params.RefPt.cos_lat0;
+    double sin_lat0 = proj->params.RefPt.sin_lat0;
+    double k, dlon;
+    double cos_lat, sin_lat, cos_dlon;
+
+    cos_lat = cos(lat);
+    sin_lat = sin(lat);
+    lon = GeogLonR(lon, lon0);
+    dlon = lon - lon0;
+    cos_dlon = cos(dlon);
+    if ( GeogDist(lon0, lat0, lon, lat) > M_PI_2 ) {
+	return 0;
+    }
+    k = 1.0 + sin_lat0 * sin_lat + cos_lat0 * cos_lat * cos_dlon;
+    k = sqrt(2.0 / k);
+    *x = r0 * k * cos_lat * sin(dlon);
+    *y = r0 * k * (cos_lat0 * sin_lat - sin_lat0 * cos_lat * cos_dlon);
+    return 1;
+}
+
+static inline int GeogProjOrthographicFwd(const struct GeogProj *proj,
+	double lon, double lat, double *x, double *y)
+{
+    double r0 = proj->ctx.r_earth;
+    double lon0 = proj->params.RefPt.lon0;
+    double lat0 = proj->params.RefPt.lat0;
+    double cos_lat0 = proj->params.RefPt.cos_lat0;
+    double sin_lat0 = proj->params.RefPt.sin_lat0;
+    double cos_lat, dlon;
+
+    if ( GeogDist(lon0, lat0, lon, lat) > M_PI_2 ) {
+	return 0;
+    }
+    cos_lat = cos(lat);
+    dlon = GeogLonDiff(lon, lon0);
+    *x = r0 * cos_lat * sin(dlon);
+    *y = r0 * (cos_lat0 * sin(lat) - sin_lat0 * cos_lat * cos(dlon));
+    return 1;
+}
+
+static inline int GeogProjStereographicFwd(const struct GeogProj *proj,
+	double lon, double lat, double *x, double *y)
+{
+    double r0 = proj->ctx.r_earth;
+    double lon0 = proj->params.RefPt.lon0;
+    double lat0 = proj->params.RefPt.lat0;
+    double cos_lat0 = proj->params.RefPt.cos_lat0;
+    double sin_lat0 = proj->params.RefPt.sin_lat0;
+    double dlon, cos_dlon, k, cos_lat, sin_lat;
+
+    /*
+       Follow convention and treat as hemisphere projection.
+     */
+
+    if ( GeogDist(lon0, lat0, lon, lat) > M_PI_2 ) {
+	return 0;
+    }
+    cos_lat = cos(lat);
+    sin_lat = sin(lat);
+    dlon = GeogLonDiff(lon, lon0);
+    cos_dlon = cos(dlon);
+    k = 2.0 / (1.0 + sin_lat0 * sin_lat + cos_lat0 * cos_lat * cos_dlon);
+    *x = r0 * k * cos_lat * sin(dlon);
+    *y = r0 * k * (cos_lat0 * sin_lat - sin_lat0 * cos_lat * cos_dlon);
+    return 1;
+}
+
+/*
+   Inverse kernels
+ */
+
+static inline int GeogProjCylEqDistInv(const struct GeogProj *proj,
+	double x, double y, double *lon, double *lat)
+{
+    double r0 = proj->ctx.r_earth;
+    double lon0 = proj->params.RefPt.lon0;
+    double cos_lat0 = proj->params.RefPt.cos_lat0;
+
+    *lon = GeogLonR(lon0 + x / (cos_lat0 * r0), lon0);
+    *lat = y / r0;
+    return 1;
+}
+
+static inline int GeogProjCylEqAreaInv(const struct GeogProj *proj,
+	double x, double y, double *lon, double *lat)
+{
+    double r0 = proj->ctx.r_earth;
+    double lon0 = proj->params.lon0;
+    double r;
+
+    r = GeogLatN(y / r0);
+    *lat = asin(r);
+    *lon = GeogLonR(lon0 + x / r0, lon0);
+    return 1;
+}
+
+static inline int GeogProjMercatorInv(const struct GeogProj *proj,
+	double x, double y, double *lon, double *lat)
+{
+    double r0 = proj->ctx.r_earth;
+    double lon0 = proj->params.lon0;
+
+    *lon = GeogLonR(lon0 + x / r0, lon0);
+    *lat = M_PI_2 - 2.0 * atan(exp(-y / r0));
+    return 1;
+}
+
+static inline int GeogProjLambertConfConicInv(const struct GeogProj *proj,
+	double x, double y, double *lon, double *lat)
+{
+    double r0 = proj->ctx.r_earth;
+    double lon0 = proj->params.LambertConfConic.lon0;
+    double F = proj->params.LambertConfConic.F;
+    double n = proj->params.LambertConfConic.n;
+    double rho0 = proj->params.LambertConfConic.rho0;
+    double rho, theta;
+
+    rho = hypot(x, rho0 - y);
+    rho = copysign(rho, n);
+    if ( n < 0.0 ) {
+	x = -x;
+	y = -y;
+	rho0 = -rho0;
+    }
+    theta = atan2(x, rho0 - y);
+    *lon = GeogLonR(theta / n + lon0, lon0);
+    if ( rho != 0.0 ) {
+	*lat = 2.0 * atan(pow(r0 * F / rho, 1.0 / n)) - M_PI_2;
+    } else {
+	*lat = copysign(M_PI_2, n);
+    }
+    return 1;
+}
+
+/*
+   Inverse for azimuthal projections, given distance rho from the origin on
+   the map and angular distance c from the origin on the globe.
+ */
+
+static inline int GeogProjAzimuthalInv(const struct GeogProj *proj,
+	double x, double y, double rho, double c, double *lon, double *lat)
+{
+    double lon0 = proj->params.RefPt.lon0;
+    double lat0 = proj->params.RefPt.lat0;
+    double cos_lat0 = proj->params.RefPt.cos_lat0;
+    double sin_lat0 = proj->params.RefPt.sin_lat0;
+    double cos_c, sin_c, ord, lat_i;
+
+    cos_c = cos(c);
+    sin_c = sin(c);
+    if ( rho == 0.0 ) {
+	lat_i = lat0;
+    } else {
+	ord = cos_c * sin_lat0 + (y * sin_c * cos_lat0 / rho);
+	if ( ord > 1.0 ) {
+	    return 0;
+	}
+	lat_i = asin(ord);
+    }
+    *lat = lat_i;
+    *lon = GeogLonR(lon0 + atan2(x * sin_c,
+		rho * cos_lat0 * cos_c - y * sin_lat0 * sin_c), lon0);
+    return 1;
+}
+
+static inline int GeogProjLambertEqAreaInv(const struct GeogProj *proj,
+	double x, double y, double *lon, double *lat)
+{
+    double r0 = proj->ctx.r_earth;
+    double rho;
+
+    rho = hypot(x, y);
+    if ( rho > 2.0 * r0 ) {
+	return 0;
+    }
+    return GeogProjAzimuthalInv(proj, x, y, rho, 2.0 * asin(rho / (2.0 * r0)),
+	    lon, lat);
+}
+
+static inline int GeogProjOrthographicInv(const struct GeogProj *proj,
+	double x, double y, double *lon, double *lat)
+{
+    double r0 = proj->ctx.r_earth;
+    double rho;
+
+    rho = hypot(x, y);
+    if ( rho / r0 > 1.0 ) {
+	return 0;
+    }
+    return GeogProjAzimuthalInv(proj, x, y, rho, asin(rho / r0), lon, lat);
+}
+
+static inline int GeogProjStereographicInv(const struct GeogProj *proj,
+	double x, double y, double *lon, double *lat)
+{
+    double r0 = proj->ctx.r_earth;
+    double rho;
+
+    rho = hypot(x, y);
+    return GeogProjAzimuthalInv(proj, x, y, rho, 2.0 * atan2(rho, 2.0 * r0),
+	    lon, lat);
+}
+
+/*
+   Rotation. GeogProjRotFwd rotates unrotated map coordinates produced by a
+   forward kernel. GeogProjRotInv undoes rotation before an inverse kernel.
+   Neither is needed if the projection's rotation is 0.
+ */
+
+static inline void GeogProjRotFwd(const struct GeogProj *proj,
+	double *x, double *y)
+{
+    double x_i = *x, y_i = *y;
+
+    *x = x_i * proj->cosr + y_i * proj->sinr;
+    *y = y_i * proj->cosr - x_i * proj->sinr;
+}
+
+static inline void GeogProjRotInv(const struct GeogProj *proj,
+	double *x, double *y)
+{
+    double x_i = *x, y_i = *y;
+
+    *x = x_i * proj->cosr - y_i * proj->sinr;
+    *y = x_i * proj->sinr + y_i * proj->cosr;
+}
+
+#endif
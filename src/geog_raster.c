@@ -0,0 +1,394 @@
+/*
+   -	geog_raster.c --
+   -		This file defines rasters and raster warping for
+   -		the geog application.  See geog_raster (3).
+   -
+   .	Copyright (c) 2014, Gordon D. Carrie. All rights reserved.
+   .
+   .	Redistribution and use in source and binary forms, with or without
+   .	modification, are permitted provided that the following conditions
+   .	are met:
+   .
+   .	    * Redistributions of source code must retain the above copyright
+   .	    notice, this list of conditions and the following disclaimer.
+   .
+   .	    * Redistributions in binary form must reproduce the above copyright
+   .	    notice, this list of conditions and the following disclaimer in the
+   .	    documentation and/or other materials provided with the distribution.
+   .
+   .	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   .	"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   .	LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   .	A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+   .	HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+   .	SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+   .	TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   .	PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   .	LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   .	NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   .	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+   .
+   .	Please send feedback to dev0@trekix.net
+   .
+   .	$Revision: $ $Date: $
+ */
+
+#include "unix_defs.h"
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <sys/mman.h>
+#include "geog_lib.h"
+#include "geog_proj.h"
+#include "geog_io.h"
+#include "geog_raster.h"
+
+/*
+   GeogRasterWarp works on tiles of output with TILE rows and columns, so
+   that coordinates for a tile stay in cache.
+ */
+
+#define TILE 64
+
+/*
+   Longest header line
+ */
+
+#define HDR_LEN (GEOG_RASTER_PROJ_LEN + 16)
+
+static double val(const struct GeogRaster *, size_t, size_t);
+static double sample(const struct GeogRaster *, double, double,
+	enum GeogResample);
+
+/*
+   Set raster r to have projection specified by proj_str, corners (x_min,
+   y_min) and (x_max, y_max) in map coordinates, nx columns, ny rows, and
+   values in format fmt. The raster has no data. Print a message and return
+   false if any value is invalid.
+ */
+
+int GeogRasterSet(struct GeogRaster *r, const char *proj_str, double x_min,
+	double y_min, double x_max, double y_max, size_t nx, size_t ny,
+	enum GeogIOFmt fmt)
+{
+    if ( strlen(proj_str) >= GEOG_RASTER_PROJ_LEN ) {
+	fprintf(stderr, "Projection specifier %s is too long.\n", proj_str);
+	return 0;
+    }
+    strcpy(r->proj_str, proj_str);
+    if ( !GeogProjSetFmStr(r->proj_str, &r->proj) ) {
+	fprintf(stderr, "Invalid projection %s.\n", proj_str);
+	return 0;
+    }
+    if ( !(x_max > x_min) || !(y_max > y_min) ) {
+	fprintf(stderr, "Raster extent %g %g %g %g is empty.\n",
+		x_min, y_min, x_max, y_max);
+	return 0;
+    }
+    if ( nx == 0 || ny == 0 ) {
+	fprintf(stderr, "Raster must have at least one row and column.\n");
+	return 0;
+    }
+    if ( fmt != GeogIOF32 && fmt != GeogIOF64 ) {
+	fprintf(stderr, "Raster values must be f32 or f64.\n");
+	return 0;
+    }
+    r->x_min = x_min;
+    r->y_min = y_min;
+    r->x_max = x_max;
+    r->y_max = y_max;
+    r->nx = nx;
+    r->ny = ny;
+    r->fmt = fmt;
+    r->data = NULL;
+    r->in.map = NULL;
+    r->in.buf = NULL;
+    return 1;
+}
+
+/*
+   Map raster file fnm into memory and initialize r from it. The file starts
+   with text lines
+
+	geog_raster
+	proj projection
+	extent x_min y_min x_max y_max
+	size nx ny
+	type f32|f64
+	end
+
+   followed by nx * ny little-endian values, row by row from the top of the
+   map. projection must be intelligible to GeogProjSetFmStr. Print a message
+   and return false on failure.
+ */
+
+int GeogRasterOpen(struct GeogRaster *r, const char *fnm)
+{
+    struct GeogIn in;
+    const char *l;			/* Header line */
+    size_t n;				/* Length of l */
+    char ln[HDR_LEN];			/* Copy of l */
+    char proj_str[GEOG_RASTER_PROJ_LEN] = "";
+    char type[8] = "";
+    double x_min = NAN, y_min = NAN, x_max = NAN, y_max = NAN;
+    unsigned long nx = 0, ny = 0;
+    enum GeogIOFmt fmt = GeogIOText;
+    size_t val_sz;			/* Size of one value */
+    int end = 0;
+
+    if ( !GeogInMapFile(&in, fnm) ) {
+	return 0;
+    }
+    if ( in.fd != -1 ) {
+	fprintf(stderr, "Raster %s must be a regular file.\n", fnm);
+	GeogInFree(&in);
+	return 0;
+    }
+    if ( in.map ) {
+
+	/* Undo sequential advice. Warping reads rows in any order. */
+	posix_madvise(in.map, in.map_sz, POSIX_MADV_NORMAL);
+    }
+    if ( !GeogInLine(&in, &l, &n) || n != 12
+	    || strncmp(l, "geog_raster\n", 12) != 0 ) {
+	fprintf(stderr, "%s is not a geog raster.\n", fnm);
+	GeogInFree(&in);
+	return 0;
+    }
+    while ( !end && GeogInLine(&in, &l, &n) ) {
+	if ( n >= HDR_LEN ) {
+	    fprintf(stderr, "Header line in %s is too long.\n", fnm);
+	    GeogInFree(&in);
+	    return 0;
+	}
+	memcpy(ln, l, n);
+	ln[n > 0 && l[n - 1] == '\n' ? n - 1 : n] = '\0';
+	if ( strncmp(ln, "proj ", 5) == 0 ) {
+	    if ( strlen(ln + 5) >= GEOG_RASTER_PROJ_LEN ) {
+		fprintf(stderr, "Projection in %s is too long.\n", fnm);
+		GeogInFree(&in);
+		return 0;
+	    }
+	    strcpy(proj_str, ln + 5);
+	} else if ( strncmp(ln, "extent ", 7) == 0 ) {
+	    sscanf(ln + 7, "%lf %lf %lf %lf", &x_min, &y_min, &x_max, &y_max);
+	} else if ( strncmp(ln, "size ", 5) == 0 ) {
+	    sscanf(ln + 5, "%lu %lu", &nx, &ny);
+	} else if ( strncmp(ln, "type ", 5) == 0 ) {
+	    sscanf(ln + 5, "%7s", type);
+	} else if ( strcmp(ln, "end") == 0 ) {
+	    end = 1;
+	} else {
+	    fprintf(stderr, "Unknown header line %s in %s.\n", ln, fnm);
+	    GeogInFree(&in);
+	    return 0;
+	}
+    }
+    if ( !end ) {
+	fprintf(stderr, "Header in %s has no end.\n", fnm);
+	GeogInFree(&in);
+	return 0;
+    }
+    if ( !GeogIOFmtFmStr(type, &fmt)
+	    || !GeogRasterSet(r, proj_str, x_min, y_min, x_max, y_max, nx, ny,
+		fmt) ) {
+	fprintf(stderr, "Invalid header in %s.\n", fnm);
+	GeogInFree(&in);
+	return 0;
+    }
+    val_sz = (fmt == GeogIOF64) ? 8 : 4;
+    if ( (size_t)(in.e - in.p) / val_sz / r->nx < r->ny ) {
+	fprintf(stderr, "%s has fewer than %lu values.\n", fnm, nx * ny);
+	GeogInFree(&in);
+	return 0;
+    }
+    r->data = (const unsigned char *)in.p;
+    r->in = in;
+    return 1;
+}
+
+/*
+   Write a header for raster r to out. Return true on success.
+ */
+
+int GeogRasterOutHdr(struct GeogOut *out, const struct GeogRaster *r)
+{
+    char ln[HDR_LEN + 256];
+
+    snprintf(ln, sizeof(ln), "geog_raster\nproj %s\n"
+	    "extent %.17g %.17g %.17g %.17g\nsize %lu %lu\ntype %s\nend\n",
+	    r->proj_str, r->x_min, r->y_min, r->x_max, r->y_max,
+	    (unsigned long)r->nx, (unsigned long)r->ny,
+	    (r->fmt == GeogIOF64) ? "f64" : "f32");
+    return GeogOutStr(out, ln);
+}
+
+/*
+   Resample raster src at the centers of pixels in columns i0 to i1 - 1 and
+   rows j0 to j1 - 1 of raster dst. Value for pixel (i, j) goes to
+   v[(j - j0) * (i1 - i0) + (i - i0)]. Pixels whose centers are outside src
+   get NaN. If tol is positive, geographic coordinates for dst pixel centers
+   are interpolated as by GeogProjGridToLonLatApprox, and the largest
+   interpolation error is stored at err. Return value is the number of
+   pixels with values.
+ */
+
+size_t GeogRasterWarp(const struct GeogRaster *src,
+	const struct GeogRaster *dst, size_t i0, size_t i1, size_t j0,
+	size_t j1, enum GeogResample rs, double tol, double *v, double *err)
+{
+    double dx = (dst->x_max - dst->x_min) / dst->nx;
+    double dy = (dst->y_max - dst->y_min) / dst->ny;
+    double x0 = dst->x_min + 0.5 * dx;	/* Center of column 0 */
+    double y0 = dst->y_max - 0.5 * dy;	/* Center of row 0 */
+    double sdx = (src->x_max - src->x_min) / src->nx;
+    double sdy = (src->y_max - src->y_min) / src->ny;
+    size_t w = i1 - i0;			/* Row length in v */
+    size_t ti, tj, ti_e, tj_e;		/* Tile bounds */
+    size_t n_val = 0;
+
+    *err = 0.0;
+    for (tj = j0; tj < j1; tj = tj_e) {
+	tj_e = (tj / TILE + 1) * TILE;
+	if ( tj_e > j1 ) {
+	    tj_e = j1;
+	}
+	for (ti = i0; ti < i1; ti = ti_e) {
+	    double x[TILE * TILE], y[TILE * TILE];
+	    unsigned char ok[TILE * TILE];
+	    size_t tw, n, k, r, c;
+	    double e;
+
+	    ti_e = (ti / TILE + 1) * TILE;
+	    if ( ti_e > i1 ) {
+		ti_e = i1;
+	    }
+	    tw = ti_e - ti;
+	    n = tw * (tj_e - tj);
+
+	    /*
+	       Destination pixel centers to geographic coordinates, then to
+	       source map coordinates, in place.
+	     */
+
+	    if ( tol > 0.0 ) {
+		GeogProjGridToLonLatApprox(x0 + ti * dx, dx, tw, y0, -dy,
+			tj, tj_e, tol, x, y, &e, &dst->proj);
+		if ( e > *err ) {
+		    *err = e;
+		}
+	    } else {
+		GeogProjGridToLonLat(x0 + ti * dx, dx, tw, y0, -dy, tj, tj_e,
+			x, y, &dst->proj);
+	    }
+	    GeogProjLonLatToXYN(x, y, x, y, ok, n, &src->proj);
+	    for (r = 0, k = 0; r < tj_e - tj; r++) {
+		double *vr = v + (tj - j0 + r) * w + (ti - i0);
+
+		for (c = 0; c < tw; c++, k++) {
+		    double fi, fj;		/* Fractional source column, row */
+
+		    if ( !ok[k] ) {
+			vr[c] = NAN;
+			continue;
+		    }
+		    fi = (x[k] - src->x_min) / sdx - 0.5;
+		    fj = (src->y_max - y[k]) / sdy - 0.5;
+		    vr[c] = sample(src, fi, fj, rs);
+		    if ( !isnan(vr[c]) ) {
+			n_val++;
+		    }
+		}
+	    }
+	}
+    }
+    return n_val;
+}
+
+/*
+   Return the value of src at fractional column fi and row fj, where pixel
+   centers are at whole numbers. Return NaN if the point is outside src.
+ */
+
+static double sample(const struct GeogRaster *src, double fi, double fj,
+	enum GeogResample rs)
+{
+    size_t ia, ib, ja, jb;		/* Columns and rows to interpolate */
+    double s, t;			/* Weights for ib and jb */
+
+    if ( !(fi >= -0.5 && fi < src->nx - 0.5
+		&& fj >= -0.5 && fj < src->ny - 0.5) ) {
+	return NAN;
+    }
+    if ( rs == GeogNearest ) {
+	return val(src, (size_t)(fi + 0.5), (size_t)(fj + 0.5));
+    }
+
+    /*
+       Bilinear. Within half a pixel of the edge, use the edge values.
+     */
+
+    if ( fi <= 0.0 ) {
+	ia = ib = 0;
+	s = 0.0;
+    } else if ( fi >= src->nx - 1 ) {
+	ia = ib = src->nx - 1;
+	s = 0.0;
+    } else {
+	ia = (size_t)fi;
+	ib = ia + 1;
+	s = fi - ia;
+    }
+    if ( fj <= 0.0 ) {
+	ja = jb = 0;
+	t = 0.0;
+    } else if ( fj >= src->ny - 1 ) {
+	ja = jb = src->ny - 1;
+	t = 0.0;
+    } else {
+	ja = (size_t)fj;
+	jb = ja + 1;
+	t = fj - ja;
+    }
+    return (1.0 - t) * ((1.0 - s) * val(src, ia, ja) + s * val(src, ib, ja))
+	+ t * ((1.0 - s) * val(src, ia, jb) + s * val(src, ib, jb));
+}
+
+/*
+   Return the value of src in column i, row j.
+ */
+
+static double val(const struct GeogRaster *src, size_t i, size_t j)
+{
+    size_t k = j * src->nx + i;
+
+    if ( src->fmt == GeogIOF64 ) {
+	const unsigned char *b = src->data + 8 * k;
+	uint64_t u = (uint64_t)b[0] | (uint64_t)b[1] << 8
+	    | (uint64_t)b[2] << 16 | (uint64_t)b[3] << 24
+	    | (uint64_t)b[4] << 32 | (uint64_t)b[5] << 40
+	    | (uint64_t)b[6] << 48 | (uint64_t)b[7] << 56;
+	double d;
+
+	memcpy(&d, &u, 8);
+	return d;
+    } else {
+	const unsigned char *b = src->data + 4 * k;
+	uint32_t u = (uint32_t)b[0] | (uint32_t)b[1] << 8
+	    | (uint32_t)b[2] << 16 | (uint32_t)b[3] << 24;
+	float f;
+
+	memcpy(&f, &u, 4);
+	return f;
+    }
+}
+
+void GeogRasterFree(struct GeogRaster *r)
+{
+    if ( r->data ) {
+	GeogInFree(&r->in);
+	r->data = NULL;
+    }
+}
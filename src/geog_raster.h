@@ -0,0 +1,82 @@
+/*
+   -	geog_raster.h --
+   -		Declarations of rasters and raster warping for
+   -		the geog application.  See geog_raster (3).
+   -
+   .	Copyright (c) 2014, Gordon D. Carrie. All rights reserved.
+   .
+   .	Redistribution and use in source and binary forms, with or without
+   .	modification, are permitted provided that the following conditions
+   .	are met:
+   .
+   .	    * Redistributions of source code must retain the above copyright
+   .	    notice, this list of conditions and the following disclaimer.
+   .
+   .	    * Redistributions in binary form must reproduce the above copyright
+   .	    notice, this list of conditions and the following disclaimer in the
+   .	    documentation and/or other materials provided with the distribution.
+   .
+   .	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   .	"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   .	LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   .	A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+   .	HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+   .	SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+   .	TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   .	PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   .	LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   .	NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   .	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+   .
+   .	Please send feedback to dev0@trekix.net
+   .
+   .	$Revision: $ $Date: $
+ */
+
+#ifndef GEOG_RASTER_H_
+#define GEOG_RASTER_H_
+
+#include <stddef.h>
+#include "geog_proj.h"
+#include "geog_io.h"
+
+/* Maximum length of a projection specifier in a raster header */
+#define GEOG_RASTER_PROJ_LEN 256
+
+/*
+   A single band raster of floating point values in a map projection.
+   Pixel (i, j) covers x_min + i * dx to x_min + (i + 1) * dx and
+   y_max - (j + 1) * dy to y_max - j * dy, where dx = (x_max - x_min) / nx
+   and dy = (y_max - y_min) / ny, so row 0 is at the top of the map.
+   Clients should not modify members directly.
+ */
+
+struct GeogRaster {
+    char proj_str[GEOG_RASTER_PROJ_LEN];	/* Projection specifier */
+    struct GeogProj proj;		/* Projection from proj_str */
+    double x_min, y_min;		/* Lower left corner of raster */
+    double x_max, y_max;		/* Upper right corner of raster */
+    size_t nx, ny;			/* Number of columns, rows */
+    enum GeogIOFmt fmt;			/* GeogIOF32 or GeogIOF64 */
+    const unsigned char *data;		/* Pixel values, row by row, or NULL */
+    struct GeogIn in;			/* Memory mapped file with data */
+};
+
+/*
+   Resampling methods for GeogRasterWarp.
+ */
+
+enum GeogResample {
+    GeogNearest, GeogBilinear
+};
+
+int GeogRasterSet(struct GeogRaster *, const char *, double, double, double,
+	double, size_t, size_t, enum GeogIOFmt);
+int GeogRasterOpen(struct GeogRaster *, const char *);
+int GeogRasterOutHdr(struct GeogOut *, const struct GeogRaster *);
+size_t GeogRasterWarp(const struct GeogRaster *, const struct GeogRaster *,
+	size_t, size_t, size_t, size_t, enum GeogResample, double, double *,
+	double *);
+void GeogRasterFree(struct GeogRaster *);
+
+#endif
@@ -0,0 +1,518 @@
+/*
+   -	geog_serve.c --
+   -		This file defines functions that answer requests from
+   -		clients on a Unix domain socket.  See geog_serve (3).
+   -
+   .	Copyright (c) 2014, Gordon D. Carrie. All rights reserved.
+   .
+   .	Redistribution and use in source and binary forms, with or without
+   .	modification, are permitted provided that the following conditions
+   .	are met:
+   .
+   .	    * Redistributions of source code must retain the above copyright
+   .	    notice, this list of conditions and the following disclaimer.
+   .
+   .	    * Redistributions in binary form must reproduce the above copyright
+   .	    notice, this list of conditions and the following disclaimer in the
+   .	    documentation and/or other materials provided with the distribution.
+   .
+   .	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+   .	"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+   .	LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+   .	A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+   .	HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+   .	SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED
+   .	TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+   .	PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+   .	LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+   .	NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   .	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+   .
+   .	Please send feedback to dev0@trekix.net
+   .
+   .	$Revision: $ $Date: $
+ */
+
+#include "unix_defs.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "alloc.h"
+#include "geog_io.h"
+#include "geog_serve.h"
+
+/*
+   A request is a header of two unsigned 32 bit little-endian integers, the
+   size of the word area and the size of the data, followed by the words,
+   each terminated with a nul, and then the data. A reply is a header with
+   a status, 0 for success, and the size of the reply data, followed by the
+   reply data.
+ */
+
+#define HDR_SZ 8
+
+/* Largest word area and data in a request */
+#define MAX_ARG (1 << 16)
+#define MAX_DATA (1 << 28)
+
+/* Stop reading from a client while it has this much reply not yet sent */
+#define MAX_PENDING (1 << 24)
+
+/* Initial size of client input buffer */
+#define IN_SZ (1 << 16)
+
+/* A connection */
+struct client {
+    int fd;
+    char *in;				/* Input not yet handled */
+    size_t in_len, in_sz;		/* Bytes at in, allocation at in */
+    char *out;				/* Replies */
+    size_t out_off;			/* Bytes at out already sent */
+    size_t out_len, out_sz;		/* Bytes at out, allocation at out */
+    int eof;				/* If true, client sent no more */
+};
+
+/* Server state */
+struct server {
+    const char *name;			/* First word of each request */
+    GeogServeFn *fn;			/* Answers requests */
+    void *arg;				/* Client data for fn */
+    struct client *cl;			/* Connections */
+    size_t n_cl, cl_sz;			/* Number of connections, allocation */
+    struct pollfd *pfd;			/* Listening socket, then connections */
+    char **argv;			/* Words of current request */
+    size_t argv_sz;			/* Allocation at argv */
+    struct GeogOut reply;		/* Reply to current request */
+};
+
+static volatile sig_atomic_t stop;
+static void on_signal(int);
+static int listen_on(const char *);
+static int set_nonblock(int);
+static int add_client(struct server *, int);
+static void drop_client(struct server *, size_t);
+static int read_client(struct server *, struct client *);
+static int handle_reqs(struct server *, struct client *);
+static int add_reply(struct client *, unsigned, const char *, size_t);
+static int write_client(struct client *);
+static int grow(char **, size_t *, size_t);
+static unsigned long get_u32(const char *);
+static void put_u32(char *, unsigned long);
+
+/*
+   Listen on a socket at path, and answer requests from clients with fn
+   until interrupted by SIGINT or SIGTERM. name becomes the first word of
+   every request, so fn gets words like argv in main. Return false if the
+   server could not start.
+ */
+
+int GeogServe(const char *path, const char *name, GeogServeFn *fn, void *arg)
+{
+    struct server srv;
+    struct sigaction sa, sa_int, sa_term, sa_pipe;
+    int lfd;
+    size_t i;
+    int ok = 1;
+
+    if ( (lfd = listen_on(path)) == -1 ) {
+	return 0;
+    }
+    srv.name = name;
+    srv.fn = fn;
+    srv.arg = arg;
+    srv.cl = NULL;
+    srv.n_cl = srv.cl_sz = 0;
+    srv.pfd = NULL;
+    srv.argv = NULL;
+    srv.argv_sz = 0;
+    if ( !GeogOutInit(&srv.reply, -1)
+	    || !(srv.pfd = MALLOC(sizeof(struct pollfd))) ) {
+	fprintf(stderr, "Could not allocate memory for server.\n");
+	GeogOutFree(&srv.reply);
+	close(lfd);
+	unlink(path);
+	return 0;
+    }
+    memset(&sa, 0, sizeof(sa));
+    sigemptyset(&sa.sa_mask);
+    sa.sa_handler = on_signal;
+    sigaction(SIGINT, &sa, &sa_int);
+    sigaction(SIGTERM, &sa, &sa_term);
+    sa.sa_handler = SIG_IGN;
+    sigaction(SIGPIPE, &sa, &sa_pipe);
+    stop = 0;
+    while ( !stop ) {
+	srv.pfd[0].fd = lfd;
+	srv.pfd[0].events = POLLIN;
+	for (i = 0; i < srv.n_cl; i++) {
+	    struct client *c = srv.cl + i;
+	    short ev = 0;
+
+	    if ( !c->eof && c->out_len - c->out_off < MAX_PENDING ) {
+		ev |= POLLIN;
+	    }
+	    if ( c->out_off < c->out_len ) {
+		ev |= POLLOUT;
+	    }
+	    srv.pfd[i + 1].fd = c->fd;
+	    srv.pfd[i + 1].events = ev;
+	}
+	if ( poll(srv.pfd, srv.n_cl + 1, -1) == -1 ) {
+	    if ( errno == EINTR ) {
+		continue;
+	    }
+	    perror("Could not wait for clients");
+	    ok = 0;
+	    break;
+	}
+
+	/*
+	   Service connections from the end, so that dropping a client, which
+	   moves the last client into its place, does not skip anyone.
+	 */
+
+	for (i = srv.n_cl; i > 0; i--) {
+	    struct client *c = srv.cl + i - 1;
+	    short rev = srv.pfd[i].revents;
+	    int keep = 1;
+
+	    if ( rev & (POLLIN | POLLHUP) ) {
+		keep = read_client(&srv, c) && handle_reqs(&srv, c);
+	    }
+	    if ( keep && (c->out_off < c->out_len || (rev & POLLOUT)) ) {
+		keep = write_client(c);
+	    }
+	    if ( keep && (rev & (POLLERR | POLLNVAL)) ) {
+		keep = 0;
+	    }
+	    if ( keep && c->eof && c->out_off == c->out_len ) {
+		keep = 0;
+	    }
+	    if ( !keep ) {
+		drop_client(&srv, i - 1);
+	    }
+	}
+	if ( srv.pfd[0].revents & POLLIN ) {
+	    int fd;
+
+	    while ( (fd = accept(lfd, NULL, NULL)) != -1 ) {
+		if ( !add_client(&srv, fd) ) {
+		    close(fd);
+		}
+	    }
+	    if ( errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR
+		    && errno != ECONNABORTED ) {
+		perror("Could not accept connection");
+	    }
+	}
+    }
+    while ( srv.n_cl > 0 ) {
+	drop_client(&srv, srv.n_cl - 1);
+    }
+    close(lfd);
+    unlink(path);
+    sigaction(SIGINT, &sa_int, NULL);
+    sigaction(SIGTERM, &sa_term, NULL);
+    sigaction(SIGPIPE, &sa_pipe, NULL);
+    FREE(srv.cl);
+    FREE(srv.pfd);
+    FREE(srv.argv);
+    GeogOutFree(&srv.reply);
+    return ok;
+}
+
+static void on_signal(int sig)
+{
+    stop = 1;
+}
+
+/*
+   Create a socket listening at path. A stale socket at path is removed.
+   Print a message and return -1 on failure.
+ */
+
+static int listen_on(const char *path)
+{
+    struct sockaddr_un addr;
+    struct stat sbuf;
+    int fd;
+
+    if ( strlen(path) >= sizeof(addr.sun_path) ) {
+	fprintf(stderr, "Socket path %s is too long.\n", path);
+	return -1;
+    }
+    if ( lstat(path, &sbuf) == 0 && S_ISSOCK(sbuf.st_mode) ) {
+	unlink(path);
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+    if ( (fd = socket(AF_UNIX, SOCK_STREAM, 0)) == -1 ) {
+	perror("Could not create socket");
+	return -1;
+    }
+    if ( bind(fd, (struct sockaddr *)&addr, sizeof(addr)) == -1 ) {
+	fprintf(stderr, "Could not bind socket to %s.\n", path);
+	perror(NULL);
+	close(fd);
+	return -1;
+    }
+    if ( listen(fd, SOMAXCONN) == -1 || !set_nonblock(fd) ) {
+	fprintf(stderr, "Could not listen at %s.\n", path);
+	perror(NULL);
+	close(fd);
+	unlink(path);
+	return -1;
+    }
+    return fd;
+}
+
+static int set_nonblock(int fd)
+{
+    int fl = fcntl(fd, F_GETFL);
+
+    return fl != -1 && fcntl(fd, F_SETFL, fl | O_NONBLOCK) != -1;
+}
+
+/* Add a connection with file descriptor fd. Return false on failure. */
+static int add_client(struct server *srv, int fd)
+{
+    struct client *c;
+
+    if ( !set_nonblock(fd) ) {
+	perror("Could not set up connection");
+	return 0;
+    }
+    if ( srv->n_cl == srv->cl_sz ) {
+	size_t sz = 2 * srv->cl_sz + 8;
+	struct client *cl;
+	struct pollfd *pfd;
+
+	if ( !(cl = REALLOC(srv->cl, sz * sizeof(struct client))) ) {
+	    fprintf(stderr, "Could not allocate memory for connection.\n");
+	    return 0;
+	}
+	srv->cl = cl;
+	if ( !(pfd = REALLOC(srv->pfd, (sz + 1) * sizeof(struct pollfd))) ) {
+	    fprintf(stderr, "Could not allocate memory for connection.\n");
+	    return 0;
+	}
+	srv->pfd = pfd;
+	srv->cl_sz = sz;
+    }
+    c = srv->cl + srv->n_cl;
+    c->fd = fd;
+    c->in = c->out = NULL;
+    c->in_len = c->in_sz = 0;
+    c->out_off = c->out_len = c->out_sz = 0;
+    c->eof = 0;
+    if ( !grow(&c->in, &c->in_sz, IN_SZ) ) {
+	fprintf(stderr, "Could not allocate memory for connection.\n");
+	return 0;
+    }
+    srv->n_cl++;
+    return 1;
+}
+
+/* Close connection i. The last connection takes its place. */
+static void drop_client(struct server *srv, size_t i)
+{
+    struct client *c = srv->cl + i;
+
+    close(c->fd);
+    FREE(c->in);
+    FREE(c->out);
+    *c = srv->cl[--srv->n_cl];
+}
+
+/*
+   Read everything available from client c. Return false if the connection
+   failed.
+ */
+
+static int read_client(struct server *srv, struct client *c)
+{
+    ssize_t r;
+
+    for (;;) {
+	if ( c->in_len == c->in_sz
+		&& !grow(&c->in, &c->in_sz, 2 * c->in_sz) ) {
+	    fprintf(stderr, "Could not allocate memory for request.\n");
+	    return 0;
+	}
+	r = read(c->fd, c->in + c->in_len, c->in_sz - c->in_len);
+	if ( r > 0 ) {
+	    c->in_len += r;
+	} else if ( r == 0 ) {
+	    c->eof = 1;
+	    return 1;
+	} else if ( errno == EINTR ) {
+	    continue;
+	} else if ( errno == EAGAIN || errno == EWOULDBLOCK ) {
+	    return 1;
+	} else {
+	    return 0;
+	}
+    }
+}
+
+/*
+   Answer all complete requests in the input from client c, adding replies
+   to its output. Return false if the client sent a bad request, or if
+   memory ran out.
+ */
+
+static int handle_reqs(struct server *srv, struct client *c)
+{
+    size_t off;				/* Start of current request */
+
+    for (off = 0; c->in_len - off >= HDR_SZ; ) {
+	char *req = c->in + off;
+	unsigned long n_arg = get_u32(req), n_data = get_u32(req + 4);
+	char *w, *e;			/* Word, end of words */
+	size_t argc;
+	struct GeogIn in;
+	int ok;
+
+	if ( n_arg == 0 || n_arg > MAX_ARG || n_data > MAX_DATA ) {
+	    fprintf(stderr, "Bad request header from client.\n");
+	    return 0;
+	}
+	if ( c->in_len - off < HDR_SZ + n_arg + n_data ) {
+	    if ( c->in_sz < HDR_SZ + n_arg + n_data
+		    && !grow(&c->in, &c->in_sz, HDR_SZ + n_arg + n_data) ) {
+		fprintf(stderr, "Could not allocate memory for request.\n");
+		return 0;
+	    }
+	    break;
+	}
+	e = req + HDR_SZ + n_arg;
+	if ( e[-1] != '\0' ) {
+	    fprintf(stderr, "Bad request words from client.\n");
+	    return 0;
+	}
+	for (w = req + HDR_SZ, argc = 1; w < e; w += strlen(w) + 1) {
+	    if ( argc + 2 > srv->argv_sz ) {
+		size_t sz = 2 * srv->argv_sz + 16;
+		char **argv;
+
+		if ( !(argv = REALLOC(srv->argv, sz * sizeof(char *))) ) {
+		    fprintf(stderr, "Could not allocate memory for request.\n");
+		    return 0;
+		}
+		srv->argv = argv;
+		srv->argv_sz = sz;
+	    }
+	    srv->argv[argc++] = w;
+	}
+	srv->argv[0] = (char *)srv->name;
+	srv->argv[argc] = NULL;
+	GeogInInitMem(&in, e, n_data);
+	srv->reply.len = 0;
+	srv->reply.err = 0;
+	ok = srv->fn((int)argc, srv->argv, &in, &srv->reply, srv->arg)
+	    && !srv->reply.err;
+	if ( !add_reply(c, ok ? 0 : 1, srv->reply.buf,
+		    ok ? srv->reply.len : 0) ) {
+	    fprintf(stderr, "Could not allocate memory for reply.\n");
+	    return 0;
+	}
+	off += HDR_SZ + n_arg + n_data;
+    }
+    if ( off > 0 ) {
+	memmove(c->in, c->in + off, c->in_len - off);
+	c->in_len -= off;
+    }
+    return 1;
+}
+
+/* Append a reply with status st and n bytes from m to the output for c */
+static int add_reply(struct client *c, unsigned st, const char *m, size_t n)
+{
+    if ( c->out_off == c->out_len ) {
+	c->out_off = c->out_len = 0;
+    }
+    if ( !grow(&c->out, &c->out_sz, c->out_len + HDR_SZ + n) ) {
+	return 0;
+    }
+    put_u32(c->out + c->out_len, st);
+    put_u32(c->out + c->out_len + 4, n);
+    if ( n > 0 ) {
+	memcpy(c->out + c->out_len + HDR_SZ, m, n);
+    }
+    c->out_len += HDR_SZ + n;
+    return 1;
+}
+
+/*
+   Send as much pending output to c as it will take. Return false if the
+   connection failed.
+ */
+
+static int write_client(struct client *c)
+{
+    ssize_t w;
+
+    while ( c->out_off < c->out_len ) {
+	w = write(c->fd, c->out + c->out_off, c->out_len - c->out_off);
+	if ( w >= 0 ) {
+	    c->out_off += w;
+	} else if ( errno == EINTR ) {
+	    continue;
+	} else if ( errno == EAGAIN || errno == EWOULDBLOCK ) {
+	    return 1;
+	} else {
+	    return 0;
+	}
+    }
+    c->out_off = c->out_len = 0;
+    return 1;
+}
+
+/*
+   Make the allocation at *buf, currently *sz bytes, at least n bytes,
+   doubling it if that is enough. Return true on success.
+ */
+
+static int grow(char **buf, size_t *sz, size_t n)
+{
+    char *t;
+
+    if ( n <= *sz ) {
+	return 1;
+    }
+    if ( n < 2 * *sz ) {
+	n = 2 * *sz;
+    }
+    if ( !(t = REALLOC(*buf, n)) ) {
+	return 0;
+    }
+    *buf = t;
+    *sz = n;
+    return 1;
+}
+
+static unsigned long get_u32(const char *p)
+{
+    const unsigned char *u = (const unsigned char *)p;
+
+    return (unsigned long)u[0] | (unsigned long)u[1] << 8
+	| (unsigned long)u[2] << 16 | (unsigned long)u[3] << 24;
+}
+
+static void put_u32(char *p, unsigned long v)
+{
+    unsigned char *u = (unsigned char *)p;
+
+    u[0] = v & 0xff;
+    u[1] = (v >> 8) & 0xff;
+    u[2] = (v >> 16) & 0xff;
+    u[3] = (v >> 24) & 0xff;
+}